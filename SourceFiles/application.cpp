@@ -8,23 +8,41 @@
 #include "application.h"
 
 #include "knot/deviceinfo.h"
+#include "platform/platform_files.h"
 #include "platform/platform_notifications.h"
 #include "platform/platform_tray.h"
+#include "transfer/buffer_pool.h"
+#include "transfer/delta.h"
+#include "transfer/delta_sender.h"
+#include "transfer/send_manifest.h"
+#include "transfer/source_file.h"
+#include "transfer/sparse.h"
 #include "views/receivers_window.h"
 #include "views/settings_window.h"
 
 #include <future>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
 #include <gsl/gsl>
+#include <QTimer>
 #include <QThread>
+#include <QPointer>
 #include <QCoreApplication>
 #include <QDesktopServices>
 #include <QFileDialog>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QCryptographicHash>
+#include <QRandomGenerator>
 #include <QApplication>
 #include <QStyleFactory>
+#include <QStandardPaths>
 #include "flowdrop/flowdrop.hpp"
 
-std::optional<std::string> settingOr(const std::unique_ptr<Settings> &settings, Setting setting, std::optional<std::string> &second) {
-    QString first = settings->getValue(setting);
+std::optional<std::string> settingOr(const Settings &settings, Setting setting, std::optional<std::string> &second) {
+    QString first = settings.getValue(setting);
     return !first.isEmpty() ? first.toStdString() : second.has_value() ? second : std::nullopt;
 }
 
@@ -34,8 +52,67 @@ QString getDeviceName(const flowdrop::DeviceInfo &d) {
 }
 
 class EventListener : public flowdrop::IEventListener {
+    void onReceivingStart(const flowdrop::DeviceInfo &sender, std::uint64_t totalSize) override {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto &summary = _summaries[sender.id];
+        ++summary.activeSessions;
+        ++summary.generation;
+    }
+
+    void onReceivingFileProgress(const flowdrop::DeviceInfo &sender, const flowdrop::FileInfo &fileInfo, std::uint64_t receivedSize) override {
+        std::uint64_t delta;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto &lastSize = _fileProgress[sender.id + "/" + fileInfo.name];
+            delta = receivedSize - std::min(receivedSize, lastSize);
+            lastSize = receivedSize;
+        }
+        App().receiveSessions().touch(sender.id, fileInfo.name);
+        // sleeping here holds the library's read loop, so the sender is
+        // slowed down by TCP flow control
+        App().shaper().throttle(Transfer::Direction::Download, sender.id, Transfer::Priority::Interactive, qint64(delta));
+    }
+
+    void onReceivingFileEnd(const flowdrop::DeviceInfo &sender, const flowdrop::FileInfo &fileInfo) override {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _fileProgress.erase(sender.id + "/" + fileInfo.name);
+        }
+        if (!App().fileReceived(sender, QString::fromStdString(fileInfo.name))) return;
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_summaries[sender.id].receivedFiles;
+    }
+
     void onReceivingEnd(const flowdrop::DeviceInfo &sender, std::uint64_t totalSize, const std::vector<flowdrop::FileInfo> &receivedFiles) override {
-        QString text = "Received " + QString::number(receivedFiles.size()) + " file(s) from " + getDeviceName(sender);
+        App().receiveSessions().close(sender.id, receivedFiles);
+        std::uint64_t generation;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto &summary = _summaries[sender.id];
+            if (--summary.activeSessions > 0) return;
+            generation = summary.generation;
+        }
+        // Chunked sends arrive as several back-to-back sessions, wait a bit
+        // so they end up in one notification.
+        QString senderName = getDeviceName(sender);
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [this, id = sender.id, senderName, generation]() {
+            QTimer::singleShot(kNotifyDelayMs, QCoreApplication::instance(), [this, id, senderName, generation]() {
+                notify(id, senderName, generation);
+            });
+        }, Qt::QueuedConnection);
+    }
+
+    void notify(const std::string &senderId, const QString &senderName, std::uint64_t generation) {
+        std::uint64_t receivedFiles;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto it = _summaries.find(senderId);
+            if (it == _summaries.end()) return;
+            if (it->second.activeSessions > 0 || it->second.generation != generation) return;
+            receivedFiles = it->second.receivedFiles;
+            _summaries.erase(it);
+        }
+        QString text = "Received " + QString::number(receivedFiles) + " file(s) from " + senderName;
         Platform::Notifications::infoNotification(text, [](){
             QString folderPath = App().getDestDir();
             QUrl folderUrl = QUrl::fromLocalFile(folderPath);
@@ -44,19 +121,88 @@ class EventListener : public flowdrop::IEventListener {
             }
         });
     }
+
+    struct Summary {
+        int activeSessions = 0;
+        std::uint64_t generation = 0;
+        std::uint64_t receivedFiles = 0;
+    };
+
+    static constexpr int kNotifyDelayMs = 1500;
+
+    std::mutex _mutex;
+    std::unordered_map<std::string, Summary> _summaries;
+    std::unordered_map<std::string, std::uint64_t> _fileProgress;
+};
+
+class SendListener : public flowdrop::IEventListener {
+public:
+    SendListener(Transfer::Shaper &shaper, Transfer::Priority priority) : _shaper(shaper), _priority(priority) {
+    }
+
+    void onReceiverNotFound() override {
+        _failed = true;
+    }
+
+    void onReceiverDeclined() override {
+        _failed = true;
+    }
+
+    // the receiver accepted, what follows is the data; background sends
+    // yield to this one from now on, not while it waits for the answer
+    void onSendingStart() override {
+        _activity.emplace(_shaper, _priority);
+        _dataTimer.start();
+    }
+
+    [[nodiscard]] bool failed() const {
+        return _failed;
+    }
+
+    // Time since the data started to flow, 0 when it never did.
+    [[nodiscard]] qint64 dataElapsed() const {
+        return _dataTimer.isValid() ? _dataTimer.elapsed() : 0;
+    }
+
+private:
+    Transfer::Shaper &_shaper;
+    const Transfer::Priority _priority;
+    std::optional<Transfer::Shaper::Activity> _activity;
+    bool _failed = false;
+    QElapsedTimer _dataTimer;
 };
 
 Application *Instance = nullptr;
 
+namespace {
+
+    constexpr int kMaxActiveSends = 4;
+    // a second slot lets small sends pass a big one on the same link
+    constexpr int kMaxActiveSendsPerPeer = 2;
+    constexpr std::size_t kRecentCount = 5;
+    constexpr int kLookupTimeoutMs = 1500;
+    constexpr int kPingTimeoutMs = 1000;
+    constexpr std::size_t kKnownPeerCount = 16;
+    // flowdrop doesn't tell when a sender gives up, a receive without
+    // news for this long is taken as broken off
+    constexpr qint64 kReceiveIdleMs = 10 * 60 * 1000;
+    constexpr int kExpiryIntervalMs = 60 * 1000;
+
+} // namespace
+
 Application::Application()
         : QObject(),
           _tray(std::make_unique<Platform::Tray>()),
-          _settings(std::make_unique<Settings>()) {
+          _settings(std::make_unique<Settings>()),
+          _sendQueue(kMaxActiveSends, kMaxActiveSendsPerPeer) {
     Instance = this;
 }
 
 Application::~Application() {
+    // the sends use most of what is torn down below
+    _sendQueue.stop();
     _server->stop();
+    _multipathServer.reset();
 
     Instance = nullptr;
 }
@@ -66,18 +212,36 @@ void Application::run() {
     QApplication::setStyle(QStyleFactory::create("Fusion"));
 
     _settings->load();
+    flowdrop::setDebug(_settings->getValue(Setting::DebugLog) == "ON");
+    // generated once, so peers can keep what they know about us
+    if (_settings->getValue(Setting::DeviceId).isEmpty()) {
+        regenerateDeviceId();
+    }
 
-    KNDeviceInfo knDeviceInfo{};
-    KNDeviceInfoFetch(knDeviceInfo);
-    _deviceInfo.id = flowdrop::generate_md5_id();
-    _deviceInfo.name = settingOr(_settings, Setting::OverrideName, knDeviceInfo.name);
-    _deviceInfo.model = settingOr(_settings, Setting::OverrideModel, knDeviceInfo.model);
-    _deviceInfo.platform = settingOr(_settings, Setting::OverridePlatform, knDeviceInfo.platform);
-    _deviceInfo.system_version = settingOr(_settings, Setting::OverrideSystemVersion, knDeviceInfo.system_version);
+    QDir dataDir(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation));
+    dataDir.mkpath(".");
+    _receiveIndex = std::make_unique<Transfer::ReceiveIndex>(dataDir.filePath("receive_index.dat"));
+    _receiveIndex->load();
+    _peerHistory = std::make_unique<PeerHistory>(dataDir.filePath("peers.json"));
+    _peerHistory->load();
+
+    applyRateLimits();
+    Transfer::BufferPool::instance().setLimit(_settings->getValue(Setting::BufferPoolMiB).toLongLong() * 1024 * 1024);
+    _receiveAdmission.setLimits({
+        _settings->getValue(Setting::MaxIncomingSessions).toInt(),
+        _settings->getValue(Setting::MaxIncomingMiB).toLongLong() * 1024 * 1024
+    });
+    _streamReceiver.setRules(_settings->getValue(Setting::StreamRules));
+    _sendQueue.setRunner([this](const Transfer::SendJob &job) {
+        return sendTo(job);
+    });
+
+    _deviceInfo = makeDeviceInfo(*_settings);
 
     _tray->addAction("Select files and send", [this](){
         selectFilesAndSend();
     });
+    updateRecentMenu();
     _tray->addAction("Settings", [this](){
         openOrFocusSettings();
     });
@@ -85,19 +249,16 @@ void Application::run() {
         QApplication::quit();
     });
 
+    startHotFolder();
+    startMirror();
+    startPresence();
+    startMultipath();
+
     _server = new flowdrop::Server(_deviceInfo);
     _server->setDestDir(_settings->getValue(Setting::Dest).toStdString());
     _server->setEventListener(new EventListener);
     _server->setAskCallback([this](const flowdrop::SendAsk &sendAsk) {
-        if (isAutoAccept()) return true;
-        std::promise<bool> addressPromise;
-        std::future<bool> addressFuture = addressPromise.get_future();
-        QString text = getDeviceName(sendAsk.sender) + " would like to send you " + QString::number(sendAsk.files.size()) + " file(s)";
-        Platform::Notifications::askNotification(text, [&addressPromise](bool result) {
-                                                     addressPromise.set_value(result);
-                                                 });
-        addressFuture.wait();
-        return addressFuture.get();
+        return acceptIncoming(sendAsk);
     });
     _serverThread = new QThread();
     QObject::connect(_serverThread, &QThread::started, [this](){
@@ -105,14 +266,146 @@ void Application::run() {
     });
     _serverThread->start();
 
+    QObject::connect(&_expiryTimer, &QTimer::timeout, [this]() {
+        expireReceives();
+    });
+    _expiryTimer.start(kExpiryIntervalMs);
+
     QObject::connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, [this]() {
         _localServer.close();
 
+        _sendQueue.stop();
+
         _server->stop();
+        _multipathServer.reset();
         _serverThread->quit();
         _serverThread->wait();
         delete _serverThread;
         _serverThread = nullptr;
+
+        _presenceThread->quit();
+        _presenceThread->wait();
+        delete _presenceThread;
+        _presenceThread = nullptr;
+        _presence.reset();
+        _probeServer.reset();
+    });
+}
+
+void Application::expireReceives() {
+    _chunkAssembler.expire(kReceiveIdleMs);
+    _sessionAsks.expire(kReceiveIdleMs);
+    QString destDir = getDestDir();
+    for (const auto &session : _receiveSessions.expire(kReceiveIdleMs)) {
+        std::vector<std::string> fileNames(session.fileNames.begin(), session.fileNames.end());
+        _streamReceiver.abort(session.senderId, fileNames, destDir);
+    }
+}
+
+bool Application::askUser(const flowdrop::SendAsk &sendAsk, std::size_t fileCount) {
+    std::promise<bool> addressPromise;
+    std::future<bool> addressFuture = addressPromise.get_future();
+    QString text = getDeviceName(sendAsk.sender) + " would like to send you " + QString::number(fileCount) + " file(s)";
+    Platform::Notifications::askNotification(text, [&addressPromise](bool result) {
+                                                 addressPromise.set_value(result);
+                                             });
+    addressFuture.wait();
+    return addressFuture.get();
+}
+
+QString Application::sessionToken(const flowdrop::SendAsk &sendAsk) {
+    // from other clients a marker is just a file
+    if (!(peerFeatures(sendAsk.sender.id) & Transfer::kFeatureSessions)) return {};
+    return Transfer::SessionAsks::sessionOf(sendAsk);
+}
+
+bool Application::sessionFits(const flowdrop::DeviceInfo &sender, const Transfer::SendSession &session) {
+    if (Transfer::ReceiveAdmission::fitsOnDisk(qint64(session.bytes), getDestDir())) return true;
+    QString text = "Not enough space to receive " + QString::number(session.files) + " file(s) from " + getDeviceName(sender);
+    Platform::Notifications::infoNotification(text, [](){});
+    return false;
+}
+
+bool Application::acceptIncoming(const flowdrop::SendAsk &sendAsk) {
+    // the chunks of one send are asked about together, for the whole of
+    // it and before any of it takes up the disk
+    QString token = sessionToken(sendAsk);
+    auto session = Transfer::SendSession::parse(token);
+    bool accepted = _sessionAsks.ask(sendAsk.sender.id, token, [&]() {
+        if (session) {
+            std::size_t fileCount = session->files > 0 ? std::size_t(session->files) : sendAsk.files.size() - 1;
+            return sessionFits(sendAsk.sender, *session) && (isAutoAccept() || askUser(sendAsk, fileCount));
+        }
+        if (isAutoAccept()) return true;
+        if (!(peerFeatures(sendAsk.sender.id) & Transfer::kFeatureChunks)) {
+            return askUser(sendAsk, sendAsk.files.size());
+        }
+        return _chunkAssembler.ask(sendAsk, [this](const flowdrop::SendAsk &ask) {
+            return askUser(ask, ask.files.size());
+        });
+    });
+    if (!accepted) return false;
+    Transfer::ReceiveAdmission::Ticket ticket = admitIncoming(sendAsk);
+    if (!ticket) return false;
+    addAcceptedSender(sendAsk.sender.id);
+    _receiveSessions.open(sendAsk, std::move(ticket));
+    _streamReceiver.prepare(sendAsk, getDestDir());
+    return true;
+}
+
+Transfer::ReceiveAdmission::Ticket Application::admitIncoming(const flowdrop::SendAsk &sendAsk) {
+    // queued here, the sender waits for the answer to its ask
+    qint64 announcedSize = 0;
+    for (const auto &file : sendAsk.files) {
+        announcedSize += qint64(file.size);
+    }
+    Transfer::ReceiveAdmission::Ticket ticket = _receiveAdmission.admit(announcedSize, getDestDir());
+    if (!ticket) {
+        QString text = "Not enough space to receive " + QString::number(sendAsk.files.size()) + " file(s) from " + getDeviceName(sendAsk.sender);
+        Platform::Notifications::infoNotification(text, [](){});
+    }
+    return ticket;
+}
+
+bool Application::acceptMultipath(const Transfer::MultipathFile &file) {
+    flowdrop::SendAsk sendAsk;
+    sendAsk.sender.id = file.senderId.toStdString();
+    if (!file.senderName.isEmpty()) {
+        sendAsk.sender.name = file.senderName.toStdString();
+    }
+    flowdrop::FileInfo info;
+    info.name = file.relativePath.toStdString();
+    info.size = std::uint64_t(file.size);
+    sendAsk.files.push_back(info);
+    auto session = Transfer::SendSession::parse(file.sessionToken);
+    bool accepted = _sessionAsks.ask(sendAsk.sender.id, session ? file.sessionToken : QString(), [&]() {
+        if (session && !sessionFits(sendAsk.sender, *session)) return false;
+        std::size_t fileCount = session && session->files > 0 ? std::size_t(session->files) : 1;
+        return isAutoAccept() || askUser(sendAsk, fileCount);
+    });
+    if (!accepted) return false;
+    // all connections of the transfer share the one ticket
+    Transfer::ReceiveAdmission::Ticket ticket = admitIncoming(sendAsk);
+    if (!ticket) return false;
+    addAcceptedSender(sendAsk.sender.id);
+    std::lock_guard<std::mutex> lock(_multipathMutex);
+    _multipathTickets[file.transferId] = std::move(ticket);
+    return true;
+}
+
+void Application::multipathReceived(const Transfer::MultipathFile &file, const QString &filePath) {
+    {
+        std::lock_guard<std::mutex> lock(_multipathMutex);
+        _multipathTickets.erase(file.transferId);
+    }
+    QString senderName = !file.senderName.isEmpty() ? file.senderName : file.senderId;
+    if (filePath.isEmpty()) {
+        Platform::Notifications::infoNotification("Could not save " + QFileInfo(file.relativePath).fileName() + " from " + senderName, [](){});
+        return;
+    }
+    _receiveIndex->add(filePath, dedupMode());
+    Platform::Notifications::infoNotification("Received " + QFileInfo(filePath).fileName() + " from " + senderName, [](){
+        QDesktopServices::openUrl(QUrl::fromLocalFile(App().getDestDir()));
     });
 }
 
@@ -145,6 +438,272 @@ void Application::setDestDir(const QString& destDir) {
     _settings->save();
 }
 
+bool Application::isDeltaTransfer() {
+    return _settings->getValue(Setting::DeltaTransfer) == "ON";
+}
+
+void Application::setDeltaTransfer(bool enabled) {
+    _settings->setValue(Setting::DeltaTransfer, enabled ? "ON" : "OFF");
+    _settings->save();
+}
+
+bool Application::isExtendedFormats() {
+    return _settings->getValue(Setting::ExtendedFormats) == "ON";
+}
+
+void Application::setExtendedFormats(bool enabled) {
+    _settings->setValue(Setting::ExtendedFormats, enabled ? "ON" : "OFF");
+    _settings->save();
+}
+
+Transfer::DedupMode Application::dedupMode() {
+    QString mode = _settings->getValue(Setting::Dedup);
+    if (mode == "REFLINK") return Transfer::DedupMode::Reflink;
+    if (mode == "HARDLINK") return Transfer::DedupMode::HardLink;
+    return Transfer::DedupMode::Off;
+}
+
+bool Application::fileReceived(const flowdrop::DeviceInfo &sender, const QString &relativePath) {
+    QDir destDir(getDestDir());
+    if (_streamReceiver.finish(destDir.path(), relativePath)) return true;
+    QString token;
+    if (Transfer::SessionAsks::isMarker(relativePath, token) && (peerFeatures(sender.id) & Transfer::kFeatureSessions)) {
+        _sessionAsks.touch(sender.id, token);
+        QFile::remove(destDir.filePath(relativePath));
+        return false;
+    }
+    // only the device we mirror from may remove files, from anyone else
+    // a marker is just a file
+    QString mirrorSource = _settings->getValue(Setting::MirrorSource);
+    if (relativePath.endsWith(Transfer::kRemovalSuffix) && !mirrorSource.isEmpty()
+            && QString::fromStdString(sender.id) == mirrorSource) {
+        Transfer::applyReceivedRemoval(destDir.path(), relativePath);
+        return false;
+    }
+    // from other clients these are files that just happen to be named so
+    quint32 features = peerFeatures(sender.id);
+    QString filePath = destDir.filePath(relativePath);
+    bool unpacked = true;
+    if (relativePath.endsWith(Transfer::kDeltaSuffix) && (features & Transfer::kFeatureDelta)) {
+        filePath.chop(Transfer::kDeltaSuffix.size());
+        unpacked = Transfer::applyReceivedDelta(destDir.path(), relativePath);
+    } else if (relativePath.endsWith(Transfer::kSparseSuffix) && (features & Transfer::kFeatureSparse)) {
+        filePath.chop(Transfer::kSparseSuffix.size());
+        unpacked = Transfer::applyReceivedSparse(destDir.path(), relativePath);
+    } else if (relativePath.endsWith(Transfer::kChunkSuffix) && (features & Transfer::kFeatureChunks)) {
+        auto result = _chunkAssembler.add(sender.id, destDir.path(), relativePath, filePath);
+        if (result == Transfer::ChunkAssembler::Result::Pending) return false;
+        unpacked = result != Transfer::ChunkAssembler::Result::Failed;
+    }
+    if (!unpacked) {
+        Platform::Notifications::infoNotification("Could not save " + QFileInfo(filePath).fileName() + " from " + getDeviceName(sender), [](){});
+        return false;
+    }
+    _receiveIndex->add(filePath, dedupMode());
+    return true;
+}
+
+qint64 Application::rateLimit(Setting setting) {
+    return _settings->getValue(setting).toLongLong();
+}
+
+void Application::setRateLimit(Setting setting, qint64 kibPerSecond) {
+    _settings->setValue(setting, QString::number(std::max<qint64>(kibPerSecond, 0)));
+    _settings->save();
+    applyRateLimits();
+}
+
+void Application::applyRateLimits() {
+    _shaper.configure(makeShaperLimits(*_settings));
+}
+
+void Application::startHotFolder() {
+    Transfer::HotFolder::Options options;
+    options.folder = _settings->getValue(Setting::HotFolder);
+    options.receiverId = _settings->getValue(Setting::HotFolderReceiver);
+    options.quietMs = _settings->getValue(Setting::HotFolderQuietMs).toInt();
+    options.archive = _settings->getValue(Setting::HotFolderArchive);
+    if (options.folder.isEmpty() || options.receiverId.isEmpty()) return;
+
+    // auto-sends give way to what the user sends by hand
+    _hotFolder = std::make_unique<Transfer::HotFolder>(options, [this, receiverId = options.receiverId](const QStringList &paths, Fn<void(bool)> done) {
+        queueSend(receiverId, paths, Transfer::Priority::Background, std::move(done));
+    });
+    if (!_hotFolder->isValid()) {
+        qWarning() << "Cannot watch hot folder" << options.folder;
+        _hotFolder.reset();
+    }
+}
+
+void Application::startMirror() {
+    Transfer::Mirror::Options options;
+    options.folder = _settings->getValue(Setting::MirrorFolder);
+    options.receiverId = _settings->getValue(Setting::MirrorReceiver);
+    if (options.folder.isEmpty() || options.receiverId.isEmpty()) return;
+
+    QByteArray key = QCryptographicHash::hash((options.folder + '\n' + options.receiverId).toUtf8(), QCryptographicHash::Md5);
+    QDir dataDir(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation));
+    options.stateDir = dataDir.filePath("mirror/" + QString::fromLatin1(key.toHex()));
+    _mirror = std::make_unique<Transfer::Mirror>(options, [this](Transfer::SendJob job) {
+        queueSend(std::move(job));
+    });
+    if (!_mirror->isValid()) {
+        qWarning() << "Cannot watch mirror folder" << options.folder;
+        _mirror.reset();
+    }
+}
+
+void Application::startPresence() {
+    _probeServer = std::make_unique<Transfer::ProbeServer>();
+    _presence = std::make_unique<Transfer::Presence>(QString::fromStdString(_deviceInfo.id), Transfer::kProbePort);
+    // speed tests only for devices that are here now and that we sent to
+    // or took files from before, and within the rate limits
+    _probeServer->setAuthorize([this](const QHostAddress &address) {
+        auto deviceId = _presence->deviceAt(address);
+        if (!deviceId) return false;
+        if (isAcceptedSender(deviceId->toStdString())) return true;
+        auto peer = _peerHistory->find(*deviceId);
+        return peer && peer->lastUsed > 0;
+    });
+    _probeServer->setThrottle([this](const QHostAddress &address, bool upload, qint64 bytes) {
+        std::string peerId = _presence->deviceAt(address).value_or(address.toString()).toStdString();
+        auto wait = _shaper.take(upload ? Transfer::Direction::Upload : Transfer::Direction::Download, peerId, Transfer::Priority::Background, bytes);
+        return qint64(std::chrono::ceil<std::chrono::milliseconds>(wait).count());
+    });
+    _presence->setPreferredInterface(preferredInterface());
+    // probes measure the link, keep them off the UI thread
+    _presenceThread = new QThread();
+    _probeServer->moveToThread(_presenceThread);
+    _presence->moveToThread(_presenceThread);
+    QObject::connect(_presenceThread, &QThread::started, _presence.get(), [this]() {
+        _probeServer->listen();
+        _presence->start();
+    });
+    _presenceThread->start();
+}
+
+void Application::startMultipath() {
+    // large files come over several connections at once, see sendLargeFile()
+    _multipathServer = std::make_unique<Transfer::MultipathServer>(getDestDir(), Transfer::MultipathOptions());
+    _multipathServer->setAskCallback([this](const Transfer::MultipathFile &file) {
+        return acceptMultipath(file);
+    });
+    _multipathServer->setDoneCallback([this](const Transfer::MultipathFile &file, const QString &filePath) {
+        multipathReceived(file, filePath);
+    });
+    // only the sender itself, from where it beacons, and only one whose
+    // files we took before
+    _multipathServer->setVerifyAuthorize([this](const QHostAddress &peer, const Transfer::MultipathFile &file) {
+        auto deviceId = _presence->deviceAt(peer);
+        return deviceId && *deviceId == file.senderId && isAcceptedSender(file.senderId.toStdString());
+    });
+    _multipathServer->setThrottle([this](const QString &senderId, qint64 bytes) {
+        _shaper.throttle(Transfer::Direction::Download, senderId.toStdString(), Transfer::Priority::Interactive, bytes);
+    });
+    if (!_multipathServer->start()) {
+        _multipathServer.reset();
+    }
+}
+
+void Application::probePeer(const QString &deviceId, QObject *context, Fn<void(const Transfer::ProbeResult &)> done) {
+    auto address = _presence->find(deviceId);
+    if (!address) {
+        Transfer::ProbeResult result;
+        result.error = "Address not known yet";
+        done(result);
+        return;
+    }
+    auto *thread = QThread::create([this, deviceId, address = *address, context = QPointer<QObject>(context), done = std::move(done)]() {
+        Transfer::ProbeOptions options;
+        options.localAddress = address.via.address;
+        Transfer::ProbeResult result = Transfer::probePeer(address.address, address.probePort, options);
+        qInfo() << "Probe of" << deviceId << "via" << address.via.name << ":" << Transfer::formatProbeResult(result);
+        {
+            std::lock_guard<std::mutex> lock(_probesMutex);
+            _probes[deviceId] = result;
+        }
+        if (result.ok) {
+            _presence->recordThroughput(deviceId, address.via.name, result.upload);
+            _peerHistory->recordProbe(deviceId, result.upload, result.rttMs);
+            rememberAddress(deviceId);
+        }
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [context, done, result]() {
+            if (context) done(result);
+        }, Qt::QueuedConnection);
+    });
+    QObject::connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+    thread->start();
+}
+
+void Application::checkKnownPeers(QObject *context, Fn<void(const PeerHistory::Peer &)> found) {
+    std::vector<PeerHistory::Peer> peers;
+    std::vector<Transfer::PingTarget> targets;
+    for (const auto &peer : _peerHistory->recent(kKnownPeerCount)) {
+        QHostAddress address(peer.address);
+        if (address.isNull()) continue;
+        peers.push_back(peer);
+        targets.push_back({address, peer.probePort});
+    }
+    if (targets.empty()) return;
+    auto *thread = QThread::create([this, peers, targets, context = QPointer<QObject>(context), found = std::move(found)]() {
+        Transfer::pingPeers(targets, kPingTimeoutMs, [&](std::size_t index) {
+            // lets probes and quick sends find it without a beacon
+            _presence->addPath(peers[index].id, {targets[index].address, targets[index].port, QDateTime::currentMSecsSinceEpoch()});
+            QMetaObject::invokeMethod(QCoreApplication::instance(), [context, found, peer = peers[index]]() {
+                if (context) found(peer);
+            }, Qt::QueuedConnection);
+        });
+    });
+    QObject::connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+    thread->start();
+}
+
+void Application::rememberAddress(const QString &deviceId) {
+    if (auto path = _presence->find(deviceId)) {
+        _peerHistory->recordAddress(deviceId, path->address.toString(), path->probePort);
+    }
+}
+
+std::optional<Transfer::PeerAddress> Application::peerPath(const QString &deviceId) {
+    return _presence->find(deviceId);
+}
+
+QString Application::preferredInterface() {
+    return _settings->getValue(Setting::PreferredInterface);
+}
+
+void Application::setPreferredInterface(const QString &name) {
+    _settings->setValue(Setting::PreferredInterface, name);
+    _settings->save();
+    _presence->setPreferredInterface(name);
+}
+
+void Application::setDiscovering(bool discovering) {
+    _discoveringCount = std::max(_discoveringCount + (discovering ? 1 : -1), 0);
+    if (_presence) {
+        _presence->setDiscovering(_discoveringCount > 0);
+    }
+}
+
+PeerHistory &Application::peerHistory() {
+    return *_peerHistory;
+}
+
+std::optional<Transfer::ProbeResult> Application::lastProbe(const QString &deviceId) {
+    std::lock_guard<std::mutex> lock(_probesMutex);
+    auto it = _probes.find(deviceId);
+    if (it == _probes.end()) return std::nullopt;
+    return it->second;
+}
+
+Transfer::Shaper &Application::shaper() {
+    return _shaper;
+}
+
+Transfer::ReceiveSessions &Application::receiveSessions() {
+    return _receiveSessions;
+}
+
 void Application::selectFilesAndSend() {
     QStringList fileNames = QFileDialog::getOpenFileNames(nullptr, "Select Files", QDir::homePath());
     if (fileNames.isEmpty()) return;
@@ -152,6 +711,91 @@ void Application::selectFilesAndSend() {
     window->show();
 }
 
+void Application::selectFilesAndSendTo(const QString &deviceId, const QString &name) {
+    struct State {
+        std::optional<bool> reachable;
+        std::optional<QStringList> files;
+    };
+    auto state = std::make_shared<State>();
+    auto finish = [this, deviceId, name, state]() {
+        if (!state->reachable || !state->files || state->files->isEmpty()) return;
+        QStringList files = *state->files;
+        if (!*state->reachable) {
+            Platform::Notifications::infoNotification(name + " is not reachable, click to choose another device", [files]() {
+                auto *window = new ReceiversWindow(files);
+                window->show();
+            });
+            return;
+        }
+        queueSend(deviceId, files, Transfer::Priority::Interactive, [name, files](bool ok) {
+            if (ok) return;
+            QMetaObject::invokeMethod(QCoreApplication::instance(), [name, files]() {
+                Platform::Notifications::infoNotification("Failed to send to " + name, [files]() {
+                    auto *window = new ReceiversWindow(files);
+                    window->show();
+                });
+            }, Qt::QueuedConnection);
+        });
+    };
+
+    auto *thread = QThread::create([this, deviceId, state, finish]() {
+        bool reachable = isReachable(deviceId);
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [state, finish, reachable]() {
+            state->reachable = reachable;
+            finish();
+        }, Qt::QueuedConnection);
+    });
+    QObject::connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+    thread->start();
+
+    state->files = QFileDialog::getOpenFileNames(nullptr, "Select Files for " + name, QDir::homePath());
+    finish();
+}
+
+bool Application::isReachable(const QString &deviceId) {
+    auto address = _presence->find(deviceId);
+    if (!address) {
+        address = Transfer::Presence::lookup(deviceId, kLookupTimeoutMs);
+    }
+    bool reachable = address && Transfer::pingPeer(address->address, address->probePort, kPingTimeoutMs, address->via.address);
+    qInfo() << deviceId << (reachable ? "is reachable" : "is not reachable");
+    return reachable;
+}
+
+bool Application::peerHasFile(const QString &deviceId, const QString &relativePath, const QByteArray &hash) {
+    auto path = _presence->find(deviceId);
+    if (!path) return false;
+    Transfer::MultipathFile file;
+    file.relativePath = relativePath;
+    file.senderId = QString::fromStdString(deviceInfo().id);
+    return Transfer::multipathVerify({path->address, path->via.address}, file, hash, Transfer::MultipathOptions());
+}
+
+bool Application::isAcceptedSender(const std::string &deviceId) {
+    std::lock_guard<std::mutex> lock(_acceptedSendersMutex);
+    return _acceptedSenders.count(deviceId) > 0;
+}
+
+void Application::addAcceptedSender(const std::string &deviceId) {
+    std::lock_guard<std::mutex> lock(_acceptedSendersMutex);
+    _acceptedSenders.insert(deviceId);
+}
+
+quint32 Application::peerFeatures(const std::string &deviceId) {
+    return _presence ? _presence->features(QString::fromStdString(deviceId)) : 0;
+}
+
+void Application::updateRecentMenu() {
+    std::vector<Platform::Tray::Action> actions;
+    for (const auto &peer : _peerHistory->recent(kRecentCount)) {
+        QString name = !peer.name.isEmpty() ? peer.name : peer.id;
+        actions.push_back({name, [this, id = peer.id, name]() {
+            selectFilesAndSendTo(id, name);
+        }});
+    }
+    _tray->setSubmenu("Send to", std::move(actions));
+}
+
 void Application::openOrFocusSettings() {
     SettingsWindow::openOrFocus();
 }
@@ -160,17 +804,208 @@ const flowdrop::DeviceInfo &Application::deviceInfo() {
     return _deviceInfo;
 }
 
-void Application::sendTo(const QString &receiverId, const QStringList &files) {
+void Application::regenerateDeviceId() {
+    _settings->setValue(Setting::DeviceId, QString::fromStdString(flowdrop::generate_md5_id()));
+    _settings->save();
+}
+
+bool Application::sendFiles(const QString &receiverId, const std::vector<flowdrop::File *> &files, Transfer::Priority priority, qint64 *dataMs) {
+    SendListener listener(_shaper, priority);
     flowdrop::SendRequest request;
     request.setDeviceInfo(deviceInfo());
     request.setReceiverId(receiverId.toStdString());
-    std::vector<flowdrop::File *> pfiles;
-    foreach (const QString& filePathStr, files) {
-        std::filesystem::path filePath(filePathStr.toStdString());
-        pfiles.push_back(new flowdrop::NativeFile(filePath, filePath.filename().string()));
-    }
-    request.setFiles(pfiles);
+    request.setEventListener(&listener);
+    request.setFiles(files);
     request.execute();
+    if (dataMs) {
+        *dataMs += listener.dataElapsed();
+    }
+    return !listener.failed();
+}
+
+bool Application::sendLargeFile(const QString &receiverId, const QString &filePath, const QString &relativePath, const QString &sessionToken, Transfer::Priority priority, qint64 *dataMs) {
+    std::vector<Transfer::PeerAddress> peerPaths = _presence->paths(receiverId);
+    if (peerPaths.empty()) {
+        qWarning() << "No path to" << receiverId << "for" << relativePath;
+        return false;
+    }
+    int streams;
+    {
+        std::lock_guard<std::mutex> lock(_tunersMutex);
+        streams = _parallelTuners[receiverId].streams();
+    }
+    // the connections take turns over every path the receiver is seen on
+    std::vector<Transfer::MultipathPath> paths;
+    for (int i = 0; i < streams; ++i) {
+        const auto &peerPath = peerPaths[std::size_t(i) % peerPaths.size()];
+        paths.push_back({peerPath.address, peerPath.via.address});
+    }
+
+    Transfer::MultipathOptions options;
+    options.throttle = [this, peerId = receiverId.toStdString(), priority](qint64 bytes) {
+        _shaper.throttle(Transfer::Direction::Upload, peerId, priority, bytes);
+    };
+    Transfer::MultipathFile file;
+    file.relativePath = relativePath;
+    file.senderId = QString::fromStdString(deviceInfo().id);
+    file.senderName = getDeviceName(deviceInfo());
+    file.sessionToken = sessionToken;
+
+    // the receiver's answer is not the link, time and yield from when it
+    // took the transfer
+    std::mutex acceptedMutex;
+    std::optional<Transfer::Shaper::Activity> activity;
+    QElapsedTimer timer;
+    options.accepted = [&]() {
+        std::lock_guard<std::mutex> lock(acceptedMutex);
+        activity.emplace(_shaper, priority);
+        timer.start();
+    };
+    bool sent = Transfer::multipathSend(filePath, file, paths, options, [this]() {
+        return _sendQueue.stopped();
+    });
+    if (!sent) {
+        qWarning() << "Parallel send failed:" << relativePath;
+        return false;
+    }
+    qint64 elapsed = timer.elapsed();
+    if (dataMs) {
+        *dataMs += elapsed;
+    }
+
+    double rate = double(QFileInfo(filePath).size()) * 1000 / std::max<qint64>(elapsed, 1);
+    qInfo() << "Sent" << relativePath << "over" << streams << "connections at" << rate / (1024 * 1024) << "MiB/s";
+    std::lock_guard<std::mutex> lock(_tunersMutex);
+    _parallelTuners[receiverId].record(streams, rate);
+    return true;
+}
+
+void Application::queueSend(const QString &receiverId, const QStringList &files, Transfer::Priority priority, Fn<void(bool)> done) {
+    _sendQueue.enqueue(receiverId, files, priority, std::move(done));
+}
+
+void Application::queueSend(Transfer::SendJob job) {
+    _sendQueue.enqueue(std::move(job));
+}
+
+bool Application::sendTo(const Transfer::SendJob &job) {
+    constexpr qint64 kParallelMinSize = 256 * 1024 * 1024;
+
+    const QString &receiverId = job.receiverId;
+    const Transfer::Priority priority = job.priority;
+    // only while data flows, finding the receiver and its answer are
+    // not the link
+    qint64 dataMs = 0;
+    // containers only go to devices that beacon they can unpack them
+    quint32 features = peerFeatures(receiverId.toStdString());
+    bool extended = isExtendedFormats();
+    Transfer::SendManifest manifest(job.files);
+    manifest.setBaseDir(job.baseDir);
+    manifest.setSparse(extended && (features & Transfer::kFeatureSparse));
+    // one ask for the whole send, not one per chunk
+    QString sessionToken;
+    if (features & Transfer::kFeatureSessions) {
+        Transfer::SendSession session;
+        session.id = QString::number(QRandomGenerator::global()->generate64(), 16);
+        session.files = job.fileCount;
+        session.bytes = quint64(std::max<qint64>(job.size, 0));
+        sessionToken = session.token();
+    }
+    manifest.setSessionToken(sessionToken);
+    const auto throttle = [this, peerId = receiverId.toStdString(), priority](qint64 bytes) {
+        _shaper.throttle(Transfer::Direction::Upload, peerId, priority, bytes);
+    };
+    manifest.setThrottle(throttle);
+    std::unique_ptr<Transfer::DeltaSender> deltaSender;
+    if (isDeltaTransfer() && (features & Transfer::kFeatureDelta)) {
+        deltaSender = std::make_unique<Transfer::DeltaSender>(receiverId, [this, receiverId](const QString &relativePath, const QByteArray &hash) {
+            return peerHasFile(receiverId, relativePath, hash);
+        });
+    }
+    std::vector<std::pair<QString, QString>> largeFiles;
+    manifest.setEntryFilter([&](QString &filePath, QString &relativePath) {
+        if (deltaSender) {
+            deltaSender->prepare(filePath, relativePath);
+        }
+        // a delta has to go as one file to be applied
+        bool delta = relativePath.endsWith(Transfer::kDeltaSuffix);
+        std::vector<Platform::Files::Extent> extents;
+        if (extended && (features & Transfer::kFeatureParallel) && !delta
+                && QFileInfo(filePath).size() >= kParallelMinSize && !Platform::Files::dataExtents(filePath, extents)) {
+            largeFiles.emplace_back(filePath, relativePath);
+            return false;
+        }
+        return true;
+    });
+    std::vector<flowdrop::File *> chunk;
+    bool ok = true;
+    // a send in flight can't be broken off, quitting waits for it and
+    // drops the rest of the job
+    while (ok && !_sendQueue.stopped() && manifest.nextChunk(chunk)) {
+        ok = sendFiles(receiverId, chunk, priority, &dataMs);
+    }
+    for (const auto &[filePath, relativePath] : largeFiles) {
+        if (!ok || _sendQueue.stopped()) break;
+        ok = sendLargeFile(receiverId, filePath, relativePath, sessionToken, priority, &dataMs);
+    }
+    ok = ok && !_sendQueue.stopped();
+    // the large files were prepared with the rest, their deltas and
+    // signatures are only good once they got through as well
+    if (ok && deltaSender) {
+        // what the receiver couldn't patch goes again in full
+        std::vector<std::unique_ptr<Transfer::SourceFile>> resent;
+        for (const auto &[filePath, relativePath] : deltaSender->commit()) {
+            resent.push_back(std::make_unique<Transfer::SourceFile>(filePath, relativePath, false));
+            resent.back()->setThrottle(throttle);
+        }
+        if (!resent.empty()) {
+            std::vector<flowdrop::File *> files;
+            for (const auto &file : resent) {
+                files.push_back(file.get());
+            }
+            std::optional<Transfer::SessionMarker> marker;
+            if (!sessionToken.isEmpty()) {
+                files.push_back(&marker.emplace(sessionToken));
+            }
+            ok = sendFiles(receiverId, files, priority, &dataMs) && !_sendQueue.stopped();
+            if (ok) {
+                deltaSender->commit();
+            }
+        }
+    }
+    qInfo() << "Sent" << manifest.totalFiles() + largeFiles.size() << "file(s) to" << receiverId;
+    if (ok) {
+        _peerHistory->recordSend(receiverId, job.size, dataMs);
+        rememberAddress(receiverId);
+        QMetaObject::invokeMethod(this, [this]() {
+            updateRecentMenu();
+        }, Qt::QueuedConnection);
+    }
+    auto buffers = Transfer::BufferPool::instance().stats();
+    qInfo() << "I/O buffers:" << buffers.inUse / 1024 << "KiB in use," << buffers.peakInUse / 1024 << "KiB peak," << buffers.allocated / 1024 << "KiB allocated";
+    return ok;
+}
+
+Transfer::ShaperLimits makeShaperLimits(const Settings &settings) {
+    Transfer::ShaperLimits limits;
+    limits.global = settings.getValue(Setting::RateLimit).toLongLong() * 1024;
+    limits.upload = settings.getValue(Setting::RateLimitUpload).toLongLong() * 1024;
+    limits.download = settings.getValue(Setting::RateLimitDownload).toLongLong() * 1024;
+    limits.peer = settings.getValue(Setting::RateLimitPeer).toLongLong() * 1024;
+    return limits;
+}
+
+flowdrop::DeviceInfo makeDeviceInfo(const Settings &settings) {
+    KNDeviceInfo knDeviceInfo{};
+    KNDeviceInfoFetch(knDeviceInfo);
+    flowdrop::DeviceInfo deviceInfo;
+    QString id = settings.getValue(Setting::DeviceId);
+    deviceInfo.id = !id.isEmpty() ? id.toStdString() : flowdrop::generate_md5_id();
+    deviceInfo.name = settingOr(settings, Setting::OverrideName, knDeviceInfo.name);
+    deviceInfo.model = settingOr(settings, Setting::OverrideModel, knDeviceInfo.model);
+    deviceInfo.platform = settingOr(settings, Setting::OverridePlatform, knDeviceInfo.platform);
+    deviceInfo.system_version = settingOr(settings, Setting::OverrideSystemVersion, knDeviceInfo.system_version);
+    return deviceInfo;
 }
 
 Application &App() {
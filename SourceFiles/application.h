@@ -7,9 +7,29 @@
 #pragma once
 
 #include <QLocalServer>
+#include <QTimer>
 #include "QObject"
+#include "peer_history.h"
 #include "platform/platform_tray.h"
 #include "settings.h"
+#include "transfer/hot_folder.h"
+#include "transfer/mirror.h"
+#include "transfer/multipath.h"
+#include "transfer/parallel.h"
+#include "transfer/presence.h"
+#include "transfer/probe.h"
+#include "transfer/receive_admission.h"
+#include "transfer/receive_index.h"
+#include "transfer/receive_sessions.h"
+#include "transfer/send_manifest.h"
+#include "transfer/send_queue.h"
+#include "transfer/shaper.h"
+#include "transfer/stream_receiver.h"
+#include "transfer/stream_source.h"
+
+#include <map>
+#include <mutex>
+#include <set>
 
 class Application final : public QObject {
 public:
@@ -30,23 +50,178 @@ public:
 
     void setDestDir(const QString& destDir);
 
+    bool isDeltaTransfer();
+
+    void setDeltaTransfer(bool enabled);
+
+    // Sparse files and parallel streams, only used with devices that
+    // beacon they can unpack them.
+    bool isExtendedFormats();
+
+    void setExtendedFormats(bool enabled);
+
+    Transfer::DedupMode dedupMode();
+
+    bool fileReceived(const flowdrop::DeviceInfo &sender, const QString &relativePath);
+
     void selectFilesAndSend();
 
+    // Sends to a device we used before without discovering it first, its
+    // reachability is checked while the user picks the files.
+    void selectFilesAndSendTo(const QString &deviceId, const QString &name);
+
     void openOrFocusSettings();
 
-    void sendTo(const QString &receiverId, const QStringList &files);
+    // Queues the send behind the ones already running, see Transfer::SendQueue.
+    void queueSend(
+            const QString &receiverId,
+            const QStringList &files,
+            Transfer::Priority priority = Transfer::Priority::Interactive,
+            Fn<void(bool)> done = nullptr);
+
+    void queueSend(Transfer::SendJob job);
+
+    bool sendTo(const Transfer::SendJob &job);
+
+    // Limits are in KiB/s, 0 means unlimited.
+    qint64 rateLimit(Setting setting);
+
+    void setRateLimit(Setting setting, qint64 kibPerSecond);
+
+    Transfer::Shaper &shaper();
+
+    Transfer::ReceiveSessions &receiveSessions();
+
+    // Runs a speed test to the device in the background, done is called on
+    // the UI thread unless context is gone by then.
+    void probePeer(const QString &deviceId, QObject *context, Fn<void(const Transfer::ProbeResult &)> done);
+
+    std::optional<Transfer::ProbeResult> lastProbe(const QString &deviceId);
+
+    // Pings the devices we used before at their last known address, all
+    // at once. found is called on the UI thread for each one that answers,
+    // unless context is gone by then.
+    void checkKnownPeers(QObject *context, Fn<void(const PeerHistory::Peer &)> found);
+
+    // How we reach the device, known once it beaconed, see Transfer::Presence.
+    std::optional<Transfer::PeerAddress> peerPath(const QString &deviceId);
+
+    // Interface name, empty to pick the best ranked one.
+    QString preferredInterface();
+
+    void setPreferredInterface(const QString &name);
+
+    // While a device list is open, presence beacons at full rate. Calls
+    // nest, UI thread only.
+    void setDiscovering(bool discovering);
+
+    PeerHistory &peerHistory();
 
     const flowdrop::DeviceInfo &deviceInfo();
 
+    // Replaces the stored identity, other devices see this one as a new
+    // device after the next start.
+    void regenerateDeviceId();
+
 private:
+    // dataMs, when given, gets the time the data took added.
+    bool sendFiles(const QString &receiverId, const std::vector<flowdrop::File *> &files, Transfer::Priority priority, qint64 *dataMs = nullptr);
+
+    bool sendLargeFile(const QString &receiverId, const QString &filePath, const QString &relativePath, const QString &sessionToken, Transfer::Priority priority, qint64 *dataMs = nullptr);
+
+    void applyRateLimits();
+
+    void startHotFolder();
+
+    void startMirror();
+
+    void startPresence();
+
+    void startMultipath();
+
+    void updateRecentMenu();
+
+    void rememberAddress(const QString &deviceId);
+
+    bool isReachable(const QString &deviceId);
+
+    // Whether the device's copy of relativePath has the hash, see
+    // Transfer::multipathVerify().
+    bool peerHasFile(const QString &deviceId, const QString &relativePath, const QByteArray &hash);
+
+    // kFeature* flags the device beaconed, see Transfer::Presence.
+    quint32 peerFeatures(const std::string &deviceId);
+
+    // Whether we took files from the device since the start.
+    bool isAcceptedSender(const std::string &deviceId);
+
+    void addAcceptedSender(const std::string &deviceId);
+
+    // fileCount is of the whole send, sendAsk may only be its first part.
+    bool askUser(const flowdrop::SendAsk &sendAsk, std::size_t fileCount);
+
+    // The session token of sendAsk, empty when it has none or its sender
+    // doesn't beacon sessions.
+    QString sessionToken(const flowdrop::SendAsk &sendAsk);
+
+    // Whether the whole session fits on the disk, tells the user if not.
+    bool sessionFits(const flowdrop::DeviceInfo &sender, const Transfer::SendSession &session);
+
+    bool acceptIncoming(const flowdrop::SendAsk &sendAsk);
+
+    // Queues the transfer behind the ones receiving, the ticket is empty
+    // when it can't fit on the disk.
+    Transfer::ReceiveAdmission::Ticket admitIncoming(const flowdrop::SendAsk &sendAsk);
+
+    bool acceptMultipath(const Transfer::MultipathFile &file);
+
+    // filePath is empty when the transfer failed.
+    void multipathReceived(const Transfer::MultipathFile &file, const QString &filePath);
+
+    // Cleans up after receives the sender broke off, runs every minute.
+    void expireReceives();
+
     const std::unique_ptr<Platform::Tray> _tray;
     const std::unique_ptr<Settings> _settings;
+    std::unique_ptr<Transfer::ReceiveIndex> _receiveIndex;
+    std::unique_ptr<PeerHistory> _peerHistory;
+    Transfer::ChunkAssembler _chunkAssembler;
+    Transfer::SessionAsks _sessionAsks;
+    Transfer::ReceiveAdmission _receiveAdmission;
+    // declared after the admission, the tickets go first
+    Transfer::ReceiveSessions _receiveSessions;
+    std::mutex _multipathMutex;
+    std::map<quint64, Transfer::ReceiveAdmission::Ticket> _multipathTickets;
+    std::mutex _acceptedSendersMutex;
+    std::set<std::string> _acceptedSenders;
+    Transfer::StreamReceiver _streamReceiver;
+    Transfer::Shaper _shaper;
+    Transfer::SendQueue _sendQueue;
+    std::unique_ptr<Transfer::HotFolder> _hotFolder;
+    std::unique_ptr<Transfer::Mirror> _mirror;
+    std::mutex _tunersMutex;
+    std::map<QString, Transfer::ParallelTuner> _parallelTuners;
+    std::unique_ptr<Transfer::ProbeServer> _probeServer;
+    std::unique_ptr<Transfer::Presence> _presence;
+    int _discoveringCount = 0;
+    std::unique_ptr<Transfer::MultipathServer> _multipathServer;
+    QThread *_presenceThread = nullptr;
+    std::mutex _probesMutex;
+    std::map<QString, Transfer::ProbeResult> _probes;
     QString _localServerName;
     QLocalServer _localServer;
     flowdrop::DeviceInfo _deviceInfo;
     flowdrop::Server *_server;
     QThread *_serverThread = nullptr;
+    QTimer _expiryTimer;
     bool _askSupported = false;
 };
 
+// Identity announced by this instance, names can be overridden in settings.
+// The id is the one stored in settings, a fresh one when there is none.
+[[nodiscard]] flowdrop::DeviceInfo makeDeviceInfo(const Settings &settings);
+
+// Rate limits from settings, in bytes per second.
+[[nodiscard]] Transfer::ShaperLimits makeShaperLimits(const Settings &settings);
+
 [[nodiscard]] Application &App();
@@ -0,0 +1,611 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "cli.h"
+
+#include "application.h"
+#include "settings.h"
+#include "transfer/interfaces.h"
+#include "transfer/link_emulator.h"
+#include "transfer/multicast.h"
+#include "transfer/multipath.h"
+#include "transfer/presence.h"
+#include "transfer/probe.h"
+#include "transfer/send_manifest.h"
+#include "transfer/shaper.h"
+#include "transfer/stream_source.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <atomic>
+#include <optional>
+#include <thread>
+#include "flowdrop/flowdrop.hpp"
+
+namespace Cli {
+
+    namespace {
+
+        constexpr int kExitOk = 0;
+        constexpr int kExitFailed = 1;
+        constexpr int kExitUsage = 2;
+        constexpr int kLookupTimeoutMs = 1500;
+
+        const QStringList kCommands = {"send", "multicast-send", "multicast-receive", "bench", "probe", "interfaces", "multipath-send", "multipath-receive"};
+
+        class SendListener : public flowdrop::IEventListener {
+        public:
+            void onReceiverNotFound() override {
+                _failed = true;
+            }
+
+            void onReceiverDeclined() override {
+                _failed = true;
+            }
+
+            [[nodiscard]] bool failed() const {
+                return _failed;
+            }
+
+        private:
+            bool _failed = false;
+        };
+
+        QTextStream &err() {
+            static QTextStream stream(stderr);
+            return stream;
+        }
+
+        QTextStream &out() {
+            static QTextStream stream(stdout);
+            return stream;
+        }
+
+        // Accepts an id or a device name, names are looked up on the network.
+        std::optional<flowdrop::DeviceInfo> findReceiver(const QString &receiver, int timeoutMs) {
+            std::optional<flowdrop::DeviceInfo> found;
+            QElapsedTimer timer;
+            timer.start();
+            flowdrop::discover([&](const flowdrop::DeviceInfo &deviceInfo) {
+                if (found) return;
+                bool byName = deviceInfo.name.has_value() && QString::fromStdString(deviceInfo.name.value()) == receiver;
+                if (QString::fromStdString(deviceInfo.id) == receiver || byName) {
+                    found = deviceInfo;
+                }
+            }, [&]() {
+                return found.has_value() || timer.elapsed() > timeoutMs;
+            });
+            return found;
+        }
+
+        int send(const QStringList &arguments) {
+            QCommandLineParser parser;
+            parser.setApplicationDescription("Sends files, or stdin when no files are given.");
+            parser.addHelpOption();
+            parser.addPositionalArgument("command", "send");
+            parser.addPositionalArgument("files", "Files or folders to send.", "[files...]");
+            QCommandLineOption toOption("to", "Receiver id or device name.", "receiver");
+            QCommandLineOption nameOption("name", "File name for data read from stdin.", "name");
+            QCommandLineOption timeoutOption("timeout", "Seconds to look for the receiver.", "seconds", "10");
+            parser.addOptions({toOption, nameOption, timeoutOption});
+            if (!parser.parse(arguments)) {
+                err() << parser.errorText() << "\n";
+                return kExitUsage;
+            }
+            if (parser.isSet("help")) {
+                err() << parser.helpText();
+                return kExitOk;
+            }
+            QStringList files = parser.positionalArguments().mid(1);
+            if (!parser.isSet(toOption) || (files.isEmpty() && !parser.isSet(nameOption))) {
+                err() << "Usage: send --to <receiver> (--name <name> | <files...>)\n";
+                return kExitUsage;
+            }
+
+            Settings settings;
+            settings.load();
+            flowdrop::DeviceInfo deviceInfo = makeDeviceInfo(settings);
+
+            QString receiver = parser.value(toOption);
+            auto receiverInfo = findReceiver(receiver, parser.value(timeoutOption).toInt() * 1000);
+            if (!receiverInfo) {
+                err() << "Receiver not found: " << receiver << "\n";
+                return kExitFailed;
+            }
+
+            // the limits from settings hold for the command line as well
+            Transfer::Shaper shaper;
+            shaper.configure(makeShaperLimits(settings));
+            auto throttle = [&shaper, peerId = receiverInfo->id](qint64 bytes) {
+                shaper.throttle(Transfer::Direction::Upload, peerId, Transfer::Priority::Interactive, bytes);
+            };
+
+            auto sendFiles = [&](const std::vector<flowdrop::File *> &chunk) {
+                SendListener listener;
+                flowdrop::SendRequest request;
+                request.setDeviceInfo(deviceInfo);
+                request.setReceiverId(receiverInfo->id);
+                request.setEventListener(&listener);
+                request.setFiles(chunk);
+                request.execute();
+                return !listener.failed();
+            };
+
+            if (files.isEmpty()) {
+                QFile input;
+                if (!input.open(stdin, QIODevice::ReadOnly)) {
+                    err() << "Cannot read stdin\n";
+                    return kExitFailed;
+                }
+                auto peer = Transfer::Presence::lookup(QString::fromStdString(receiverInfo->id), kLookupTimeoutMs);
+                if (!peer || !(peer->features & Transfer::kFeatureChunks)) {
+                    err() << "The receiver doesn't beacon stream support, it may keep the chunks as separate files\n";
+                }
+                return Transfer::sendStream(input, parser.value(nameOption), throttle, sendFiles) ? kExitOk : kExitFailed;
+            }
+
+            Transfer::SendManifest manifest(files);
+            manifest.setThrottle(throttle);
+            if (settings.getValue(Setting::ExtendedFormats) == "ON") {
+                // only a receiver that beacons it unpacks sparse containers
+                auto peer = Transfer::Presence::lookup(QString::fromStdString(receiverInfo->id), kLookupTimeoutMs);
+                manifest.setSparse(peer && (peer->features & Transfer::kFeatureSparse));
+            }
+            std::vector<flowdrop::File *> chunk;
+            while (manifest.nextChunk(chunk)) {
+                if (!sendFiles(chunk)) {
+                    return kExitFailed;
+                }
+            }
+            return kExitOk;
+        }
+
+        // Shared by both multicast commands, returns false on a bad value.
+        bool multicastOptions(const QCommandLineParser &parser, Transfer::MulticastOptions &options) {
+            if (parser.isSet("group")) {
+                options.group = QHostAddress(parser.value("group"));
+            }
+            if (!options.group.isMulticast()) {
+                err() << "Not a multicast group: " << parser.value("group") << "\n";
+                return false;
+            }
+            if (parser.isSet("port")) {
+                options.port = quint16(parser.value("port").toUInt());
+            }
+            options.idleTimeoutMs = parser.value("timeout").toInt() * 1000;
+            options.peerRepair = !parser.isSet("no-peer-repair");
+            options.interfaceName = parser.value("interface");
+            return options.port != 0 && options.idleTimeoutMs > 0;
+        }
+
+        QList<QCommandLineOption> multicastParserOptions() {
+            return {
+                    {"group", "Multicast group address.", "address"},
+                    {"port", "UDP port.", "port"},
+                    {"timeout", "Seconds to wait for the other side.", "seconds", "30"},
+                    {"no-peer-repair", "Repair lost chunks from the sender only."},
+                    {"interface", "Network interface to use, see the interfaces command.", "name"},
+            };
+        }
+
+        int multicastSend(const QStringList &arguments) {
+            QCommandLineParser parser;
+            parser.setApplicationDescription("Sends a file to every receiver listening on a multicast group.");
+            parser.addHelpOption();
+            parser.addPositionalArgument("command", "multicast-send");
+            parser.addPositionalArgument("file", "File to send.");
+            parser.addOptions(multicastParserOptions());
+            QCommandLineOption rateOption("rate", "Highest rate in MiB/s.", "rate", "100");
+            QCommandLineOption receiversOption("receivers", "Receivers to wait for.", "count", "1");
+            parser.addOptions({rateOption, receiversOption});
+            if (!parser.parse(arguments)) {
+                err() << parser.errorText() << "\n";
+                return kExitUsage;
+            }
+            if (parser.isSet("help")) {
+                err() << parser.helpText();
+                return kExitOk;
+            }
+            Transfer::MulticastOptions options;
+            QStringList files = parser.positionalArguments().mid(1);
+            if (files.size() != 1 || !multicastOptions(parser, options)) {
+                err() << "Usage: multicast-send [--group <address>] [--port <port>] [--receivers <count>] <file>\n";
+                return kExitUsage;
+            }
+            options.maxRate = std::max<qint64>(parser.value(rateOption).toLongLong(), 1) * 1024 * 1024;
+            options.initialRate = std::min(options.initialRate, options.maxRate);
+            options.receivers = std::max(parser.value(receiversOption).toInt(), 1);
+            return Transfer::multicastSend(files.front(), options, []() { return false; }) ? kExitOk : kExitFailed;
+        }
+
+        int multicastReceive(const QStringList &arguments) {
+            QCommandLineParser parser;
+            parser.setApplicationDescription("Receives one file sent with multicast-send.");
+            parser.addHelpOption();
+            parser.addPositionalArgument("command", "multicast-receive");
+            parser.addOptions(multicastParserOptions());
+            QCommandLineOption dirOption("dir", "Folder to save the file to.", "folder", ".");
+            parser.addOption(dirOption);
+            if (!parser.parse(arguments)) {
+                err() << parser.errorText() << "\n";
+                return kExitUsage;
+            }
+            if (parser.isSet("help")) {
+                err() << parser.helpText();
+                return kExitOk;
+            }
+            Transfer::MulticastOptions options;
+            if (!multicastOptions(parser, options)) {
+                err() << "Usage: multicast-receive [--group <address>] [--port <port>] [--dir <folder>]\n";
+                return kExitUsage;
+            }
+            return Transfer::multicastReceive(parser.value(dirOption), options, []() { return false; }) ? kExitOk : kExitFailed;
+        }
+
+        bool writeRandomFile(const QString &path, qint64 size, quint32 seed) {
+            QFile file(path);
+            if (!file.open(QIODevice::WriteOnly)) {
+                return false;
+            }
+            QRandomGenerator random(seed);
+            QByteArray block(1024 * 1024, Qt::Uninitialized);
+            while (size > 0) {
+                random.fillRange(reinterpret_cast<quint32 *>(block.data()), block.size() / int(sizeof(quint32)));
+                qint64 length = std::min<qint64>(size, block.size());
+                if (file.write(block.constData(), length) != length) {
+                    return false;
+                }
+                size -= length;
+            }
+            return true;
+        }
+
+        QByteArray fileHash(const QString &path) {
+            QFile file(path);
+            QCryptographicHash hash(QCryptographicHash::Md5);
+            if (!file.open(QIODevice::ReadOnly) || !hash.addData(&file)) {
+                return {};
+            }
+            return hash.result();
+        }
+
+        // Runs a multicast transfer to several receivers over an emulated
+        // link in this process, so transport changes can be compared on
+        // the same conditions without a network or root.
+        int bench(const QStringList &arguments) {
+            QStringList profiles;
+            for (const auto &profile : Transfer::LinkProfile::presets()) {
+                profiles.push_back(profile.name);
+            }
+            QCommandLineParser parser;
+            parser.setApplicationDescription("Measures a multicast transfer over an emulated link.");
+            parser.addHelpOption();
+            parser.addPositionalArgument("command", "bench");
+            QCommandLineOption profileOption("profile", "Link: " + profiles.join(", ") + ".", "profile", "wifi24");
+            QCommandLineOption sizeOption("size", "File size in MiB.", "size", "16");
+            QCommandLineOption receiversOption("receivers", "Number of receivers.", "count", "3");
+            QCommandLineOption seedOption("seed", "Seed for the data, loss and jitter.", "seed", "1");
+            QCommandLineOption noPeerRepairOption("no-peer-repair", "Repair lost chunks from the sender only.");
+            parser.addOptions({profileOption, sizeOption, receiversOption, seedOption, noPeerRepairOption});
+            if (!parser.parse(arguments)) {
+                err() << parser.errorText() << "\n";
+                return kExitUsage;
+            }
+            if (parser.isSet("help")) {
+                err() << parser.helpText();
+                return kExitOk;
+            }
+            auto profile = Transfer::LinkProfile::find(parser.value(profileOption));
+            int receivers = parser.value(receiversOption).toInt();
+            qint64 size = parser.value(sizeOption).toLongLong() * 1024 * 1024;
+            if (!profile || receivers < 1 || size <= 0) {
+                err() << "Usage: bench [--profile <" << profiles.join("|") << ">] [--size <MiB>] [--receivers <count>]\n";
+                return kExitUsage;
+            }
+            auto seed = parser.value(seedOption).toUInt();
+
+            QTemporaryDir work;
+            QString sourcePath = work.filePath("source.bin");
+            if (!work.isValid() || !writeRandomFile(sourcePath, size, seed)) {
+                err() << "Cannot write the test file\n";
+                return kExitFailed;
+            }
+
+            Transfer::MulticastOptions options;
+            options.receivers = receivers;
+            options.peerRepair = !parser.isSet(noPeerRepairOption);
+            options.idleTimeoutMs = 10 * 1000;
+
+            Transfer::EmulatedNetwork network(*profile, seed);
+            std::vector<std::unique_ptr<Transfer::DatagramChannel>> channels;
+            std::vector<std::thread> threads;
+            std::atomic<int> received = 0;
+            for (int i = 0; i < receivers; ++i) {
+                channels.push_back(network.open(true));
+                QString destDir = work.filePath("receiver" + QString::number(i));
+                threads.emplace_back([&, destDir, channel = channels.back().get()]() {
+                    if (Transfer::multicastReceive(destDir, options, *channel, []() { return false; })) {
+                        ++received;
+                    }
+                });
+            }
+            auto senderChannel = network.open(false);
+            QElapsedTimer timer;
+            timer.start();
+            bool sent = Transfer::multicastSend(sourcePath, options, *senderChannel, []() { return false; });
+            double seconds = double(timer.nsecsElapsed()) / 1e9;
+            for (auto &thread : threads) {
+                thread.join();
+            }
+
+            QByteArray expected = fileHash(sourcePath);
+            int intact = 0;
+            for (int i = 0; i < receivers; ++i) {
+                QString path = QDir(work.filePath("receiver" + QString::number(i))).filePath("source.bin");
+                intact += fileHash(path) == expected ? 1 : 0;
+            }
+
+            Transfer::LinkStats stats = network.stats();
+            out() << "profile " << profile->name << ", " << receivers << " receivers, "
+                  << size / (1024 * 1024) << " MiB"
+                  << (options.peerRepair ? "" : ", sender-only repair") << "\n"
+                  << "time " << QString::number(seconds, 'f', 2) << " s, "
+                  << QString::number(double(size) / (1024 * 1024) / seconds, 'f', 2) << " MiB/s\n"
+                  << "datagrams " << stats.sent << " sent, " << stats.delivered << " delivered, "
+                  << stats.lost << " lost, " << stats.dropped << " dropped in queue\n"
+                  << "intact " << intact << " of " << receivers << "\n";
+            out().flush();
+            return sent && received == receivers && intact == receivers ? kExitOk : kExitFailed;
+        }
+
+        int probe(const QStringList &arguments) {
+            QCommandLineParser parser;
+            parser.setApplicationDescription("Measures RTT, jitter and throughput to a device, without touching the disk.");
+            parser.addHelpOption();
+            parser.addPositionalArgument("command", "probe");
+            QCommandLineOption toOption("to", "Receiver id or device name.", "receiver");
+            QCommandLineOption addressOption("address", "Probe this address instead of looking the device up.", "address");
+            QCommandLineOption durationOption("duration", "Seconds of throughput test per direction.", "seconds", "3");
+            QCommandLineOption timeoutOption("timeout", "Seconds to look for the receiver.", "seconds", "10");
+            QCommandLineOption interfaceOption("interface", "Network interface to probe over.", "name");
+            parser.addOptions({toOption, addressOption, durationOption, timeoutOption, interfaceOption});
+            if (!parser.parse(arguments)) {
+                err() << parser.errorText() << "\n";
+                return kExitUsage;
+            }
+            if (parser.isSet("help")) {
+                err() << parser.helpText();
+                return kExitOk;
+            }
+            if (parser.isSet(toOption) == parser.isSet(addressOption)) {
+                err() << "Usage: probe (--to <receiver> | --address <address>) [--duration <seconds>]\n";
+                return kExitUsage;
+            }
+
+            QHostAddress address(parser.value(addressOption));
+            quint16 port = Transfer::kProbePort;
+            if (parser.isSet(toOption)) {
+                int timeoutMs = parser.value(timeoutOption).toInt() * 1000;
+                QString receiver = parser.value(toOption);
+                auto receiverInfo = findReceiver(receiver, timeoutMs);
+                std::optional<Transfer::PeerAddress> peer;
+                if (receiverInfo) {
+                    peer = Transfer::Presence::lookup(QString::fromStdString(receiverInfo->id), timeoutMs);
+                }
+                if (!peer) {
+                    err() << "Receiver not found: " << receiver << "\n";
+                    return kExitFailed;
+                }
+                address = peer->address;
+                port = peer->probePort;
+            }
+            if (address.isNull()) {
+                err() << "Not an address: " << parser.value(addressOption) << "\n";
+                return kExitUsage;
+            }
+
+            Transfer::ProbeOptions options;
+            options.durationMs = std::max(parser.value(durationOption).toInt(), 1) * 1000;
+            if (parser.isSet(interfaceOption)) {
+                auto iface = Transfer::findInterface(parser.value(interfaceOption));
+                if (!iface) {
+                    err() << "No such interface, or it is down: " << parser.value(interfaceOption) << "\n";
+                    return kExitFailed;
+                }
+                options.localAddress = iface->address;
+            }
+            Transfer::ProbeResult result = Transfer::probePeer(address, port, options);
+            if (!result.ok) {
+                err() << "Probe failed: " << result.error << "\n";
+                return kExitFailed;
+            }
+            out() << "address " << address.toString()
+                  << (options.localAddress.isNull() ? QString() : " from " + options.localAddress.toString()) << "\n"
+                  << "rtt " << QString::number(result.rttMs, 'f', 2) << " ms, jitter "
+                  << QString::number(result.jitterMs, 'f', 2) << " ms, loss "
+                  << QString::number(result.loss * 100, 'f', 1) << "%\n"
+                  << "upload " << QString::number(double(result.upload) / (1024 * 1024), 'f', 2) << " MiB/s\n"
+                  << "download " << QString::number(double(result.download) / (1024 * 1024), 'f', 2) << " MiB/s\n";
+            out().flush();
+            return kExitOk;
+        }
+
+        // <address>[,from=<interface or address>][,rate=<MiB/s>], the rate
+        // caps the path so a slow link can be emulated on loopback.
+        bool parsePath(const QString &value, Transfer::MultipathPath &path) {
+            QStringList parts = value.split(',');
+            path.remote = QHostAddress(parts.takeFirst());
+            for (const QString &part : parts) {
+                QString key = part.section('=', 0, 0);
+                QString argument = part.section('=', 1);
+                if (key == "from") {
+                    auto iface = Transfer::findInterface(argument);
+                    path.local = iface ? iface->address : QHostAddress(argument);
+                    if (path.local.isNull()) {
+                        return false;
+                    }
+                } else if (key == "rate") {
+                    path.maxRate = qint64(argument.toDouble() * 1024 * 1024);
+                    if (path.maxRate <= 0) {
+                        return false;
+                    }
+                } else {
+                    return false;
+                }
+            }
+            return !path.remote.isNull();
+        }
+
+        int multipathSend(const QStringList &arguments) {
+            QCommandLineParser parser;
+            parser.setApplicationDescription("Sends a file striped over several paths to multipath-receive.");
+            parser.addHelpOption();
+            parser.addPositionalArgument("command", "multipath-send");
+            parser.addPositionalArgument("file", "File to send.");
+            QCommandLineOption pathOption("path", "Receiver address, optionally from=<interface|address> and rate=<MiB/s>, comma separated. Repeat for every path.", "path");
+            QCommandLineOption portOption("port", "TCP port of the receiver.", "port", QString::number(Transfer::kMultipathPort));
+            parser.addOptions({pathOption, portOption});
+            if (!parser.parse(arguments)) {
+                err() << parser.errorText() << "\n";
+                return kExitUsage;
+            }
+            if (parser.isSet("help")) {
+                err() << parser.helpText();
+                return kExitOk;
+            }
+            QStringList files = parser.positionalArguments().mid(1);
+            std::vector<Transfer::MultipathPath> paths;
+            for (const QString &value : parser.values(pathOption)) {
+                Transfer::MultipathPath path;
+                if (!parsePath(value, path)) {
+                    err() << "Bad path: " << value << "\n";
+                    return kExitUsage;
+                }
+                paths.push_back(path);
+            }
+            Transfer::MultipathOptions options;
+            options.port = quint16(parser.value(portOption).toUInt());
+            if (files.size() != 1 || paths.empty() || options.port == 0) {
+                err() << "Usage: multipath-send --path <address>[,from=<interface>][,rate=<MiB/s>] [--path ...] <file>\n";
+                return kExitUsage;
+            }
+
+            Settings settings;
+            settings.load();
+            flowdrop::DeviceInfo deviceInfo = makeDeviceInfo(settings);
+            Transfer::MultipathFile file;
+            file.relativePath = QFileInfo(files.front()).fileName();
+            file.senderId = QString::fromStdString(deviceInfo.id);
+            file.senderName = QString::fromStdString(deviceInfo.name.value_or(deviceInfo.id));
+
+            std::vector<Transfer::MultipathPathStats> stats(paths.size());
+            QElapsedTimer timer;
+            timer.start();
+            bool sent = Transfer::multipathSend(files.front(), file, paths, options, []() { return false; }, &stats);
+            double seconds = double(timer.nsecsElapsed()) / 1e9;
+            qint64 total = 0;
+            for (std::size_t i = 0; i < paths.size(); ++i) {
+                total += stats[i].bytes;
+                out() << "path " << paths[i].remote.toString() << ": "
+                      << QString::number(double(stats[i].bytes) / (1024 * 1024), 'f', 2) << " MiB at "
+                      << QString::number(stats[i].rate / (1024 * 1024), 'f', 2) << " MiB/s"
+                      << (stats[i].failed ? ", dropped" : "") << "\n";
+            }
+            out() << "total " << QString::number(double(total) / (1024 * 1024) / seconds, 'f', 2) << " MiB/s\n";
+            out().flush();
+            return sent ? kExitOk : kExitFailed;
+        }
+
+        int multipathReceive(const QStringList &arguments) {
+            QCommandLineParser parser;
+            parser.setApplicationDescription("Receives one file sent with multipath-send.");
+            parser.addHelpOption();
+            parser.addPositionalArgument("command", "multipath-receive");
+            QCommandLineOption dirOption("dir", "Folder to save the file to.", "folder", ".");
+            QCommandLineOption portOption("port", "TCP port to listen on.", "port", QString::number(Transfer::kMultipathPort));
+            QCommandLineOption timeoutOption("timeout", "Seconds to wait for the sender.", "seconds", "30");
+            parser.addOptions({dirOption, portOption, timeoutOption});
+            if (!parser.parse(arguments)) {
+                err() << parser.errorText() << "\n";
+                return kExitUsage;
+            }
+            if (parser.isSet("help")) {
+                err() << parser.helpText();
+                return kExitOk;
+            }
+            Transfer::MultipathOptions options;
+            options.port = quint16(parser.value(portOption).toUInt());
+            options.idleTimeoutMs = parser.value(timeoutOption).toInt() * 1000;
+            if (options.port == 0 || options.idleTimeoutMs <= 0) {
+                err() << "Usage: multipath-receive [--dir <folder>] [--port <port>] [--timeout <seconds>]\n";
+                return kExitUsage;
+            }
+            return Transfer::multipathReceive(parser.value(dirOption), options, []() { return false; }) ? kExitOk : kExitFailed;
+        }
+
+        // Lists what Presence beacons on and what --interface accepts.
+        int interfaces(const QStringList &arguments) {
+            Q_UNUSED(arguments)
+            auto found = Transfer::localInterfaces();
+            if (found.empty()) {
+                err() << "No usable network interface\n";
+                return kExitFailed;
+            }
+            for (const auto &iface : found) {
+                out() << iface.name << "\t" << iface.address.toString() << "/" << iface.prefixLength
+                      << "\trank " << iface.rank << "\t" << iface.humanName << "\n";
+            }
+            out().flush();
+            return kExitOk;
+        }
+
+    } // namespace
+
+    bool isCommand(int argc, char *argv[]) {
+        return argc > 1 && kCommands.contains(QString::fromLocal8Bit(argv[1]));
+    }
+
+    int run(const QStringList &arguments) {
+        // arguments[0] is the program, arguments[1] the command
+        QString command = arguments.value(1);
+        if (command == "send") {
+            return send(arguments);
+        }
+        if (command == "multicast-send") {
+            return multicastSend(arguments);
+        }
+        if (command == "multicast-receive") {
+            return multicastReceive(arguments);
+        }
+        if (command == "bench") {
+            return bench(arguments);
+        }
+        if (command == "probe") {
+            return probe(arguments);
+        }
+        if (command == "interfaces") {
+            return interfaces(arguments);
+        }
+        if (command == "multipath-send") {
+            return multipathSend(arguments);
+        }
+        if (command == "multipath-receive") {
+            return multipathReceive(arguments);
+        }
+        err() << "Unknown command: " << command << "\n";
+        return kExitUsage;
+    }
+
+} // namespace Cli
@@ -0,0 +1,21 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include <QStringList>
+
+namespace Cli {
+
+    // True when the command line asks for a headless command instead of
+    // the tray application.
+    [[nodiscard]] bool isCommand(int argc, char *argv[]);
+
+    // Runs the command and returns the process exit code. Needs a
+    // QCoreApplication.
+    int run(const QStringList &arguments);
+
+} // namespace Cli
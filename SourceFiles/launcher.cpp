@@ -10,6 +10,7 @@
 #include "platform/platform_notifications.h"
 #include "resources.h"
 #include "application.h"
+#include "cli.h"
 #include "single_instance.h"
 
 #include <QDir>
@@ -19,6 +20,8 @@
 #include <QMessageBox>
 #include <QStyleHints>
 #include <QApplication>
+#include <QCoreApplication>
+#include <csignal>
 #include <iostream>
 
 void logToFile(QtMsgType type, const QMessageLogContext &context, const QString &msg) {
@@ -87,6 +90,17 @@ int launch(int argc, char *argv[]) {
 
     initQtMessageLogging();
 
+#ifndef Q_OS_WIN
+    // streamed receives write to pipes whose reader may quit early, see
+    // Transfer::StreamReceiver; that has to fail the write, not the app
+    ::signal(SIGPIPE, SIG_IGN);
+#endif
+
+    if (Cli::isCommand(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        return Cli::run(QCoreApplication::arguments());
+    }
+
     QApplication app(argc, argv);
 
     SingleInstance singleInstance;
@@ -0,0 +1,217 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "peer_history.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+    constexpr double kDayMs = 24.0 * 60 * 60 * 1000;
+    // how fast a device drops out of "recent" and sends are forgotten
+    constexpr double kRecencyDays = 7;
+    constexpr double kFrequencyDays = 14;
+    constexpr double kRecencyWeight = 40;
+    constexpr double kFrequencyWeight = 10;
+    constexpr double kThroughputWeight = 5;
+    constexpr double kRttWeight = 5;
+    constexpr std::size_t kMaxPeers = 200;
+
+} // namespace
+
+PeerHistory::PeerHistory(QString path) : _path(std::move(path)) {
+}
+
+void PeerHistory::load() {
+    QFile file(_path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    QJsonArray peers = QJsonDocument::fromJson(file.readAll()).object()["peers"].toArray();
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto &value : peers) {
+        QJsonObject json = value.toObject();
+        Peer peer;
+        peer.id = json["id"].toString();
+        peer.name = json["name"].toString();
+        peer.lastUsed = qint64(json["last_used"].toDouble());
+        peer.frequency = json["frequency"].toDouble();
+        peer.throughput = qint64(json["throughput"].toDouble());
+        peer.rttMs = json["rtt_ms"].toDouble(-1);
+        peer.address = json["address"].toString();
+        peer.probePort = quint16(json["probe_port"].toInt());
+        if (!peer.id.isEmpty()) {
+            _peers[peer.id] = peer;
+        }
+    }
+}
+
+bool PeerHistory::save() {
+    std::lock_guard<std::mutex> saveLock(_saveMutex);
+    std::map<QString, Peer> snapshot;
+    quint64 generation;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_generation == _savedGeneration) {
+            return true; // an earlier call already wrote this state
+        }
+        snapshot = _peers;
+        generation = _generation;
+    }
+    QJsonArray peers;
+    for (const auto &[id, peer] : snapshot) {
+        QJsonObject json;
+        json["id"] = peer.id;
+        json["name"] = peer.name;
+        json["last_used"] = double(peer.lastUsed);
+        json["frequency"] = peer.frequency;
+        json["throughput"] = double(peer.throughput);
+        json["rtt_ms"] = peer.rttMs;
+        if (!peer.address.isEmpty()) {
+            json["address"] = peer.address;
+            json["probe_port"] = int(peer.probePort);
+        }
+        peers.append(json);
+    }
+    QJsonObject root;
+    root["peers"] = peers;
+    QSaveFile file(_path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    if (!file.commit()) {
+        return false;
+    }
+    _savedGeneration = generation;
+    return true;
+}
+
+void PeerHistory::remember(const QString &id, const QString &name) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto &peer = _peers[id];
+        peer.id = id;
+        peer.name = name;
+        ++_generation;
+    }
+    save();
+}
+
+void PeerHistory::recordSend(const QString &id, qint64 bytes, qint64 elapsedMs) {
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto &peer = _peers[id];
+        peer.id = id;
+        peer.frequency = decayedFrequency(peer, now) + 1;
+        peer.lastUsed = now;
+        // small sends are all latency, they say nothing about the link
+        if (bytes >= 16 * 1024 * 1024 && elapsedMs > 0) {
+            peer.throughput = bytes * 1000 / elapsedMs;
+        }
+        if (_peers.size() > kMaxPeers) {
+            auto oldest = std::min_element(_peers.begin(), _peers.end(), [](const auto &left, const auto &right) {
+                return left.second.lastUsed < right.second.lastUsed;
+            });
+            _peers.erase(oldest);
+        }
+        ++_generation;
+    }
+    save();
+}
+
+void PeerHistory::recordProbe(const QString &id, qint64 throughput, double rttMs) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _peers.find(id);
+        if (it == _peers.end()) {
+            return;
+        }
+        it->second.throughput = throughput;
+        it->second.rttMs = rttMs;
+        ++_generation;
+    }
+    save();
+}
+
+void PeerHistory::recordAddress(const QString &id, const QString &address, quint16 probePort) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _peers.find(id);
+        if (it == _peers.end() || (it->second.address == address && it->second.probePort == probePort)) {
+            return;
+        }
+        it->second.address = address;
+        it->second.probePort = probePort;
+        ++_generation;
+    }
+    save();
+}
+
+std::optional<PeerHistory::Peer> PeerHistory::find(const QString &id) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _peers.find(id);
+    if (it == _peers.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+double PeerHistory::score(const QString &id) const {
+    auto peer = find(id);
+    return peer ? score(*peer, QDateTime::currentMSecsSinceEpoch()) : 0;
+}
+
+std::vector<PeerHistory::Peer> PeerHistory::recent(std::size_t count) const {
+    std::vector<Peer> peers;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (const auto &[id, peer] : _peers) {
+            if (peer.lastUsed > 0) {
+                peers.push_back(peer);
+            }
+        }
+    }
+    std::sort(peers.begin(), peers.end(), [](const Peer &left, const Peer &right) {
+        return left.lastUsed > right.lastUsed;
+    });
+    if (peers.size() > count) {
+        peers.resize(count);
+    }
+    return peers;
+}
+
+double PeerHistory::decayedFrequency(const Peer &peer, qint64 now) {
+    double ageDays = double(now - peer.lastUsed) / kDayMs;
+    return peer.frequency * std::exp(-ageDays / kFrequencyDays);
+}
+
+double PeerHistory::score(const Peer &peer, qint64 now) {
+    if (peer.lastUsed == 0) {
+        return 0;
+    }
+    double ageDays = double(now - peer.lastUsed) / kDayMs;
+    double score = kRecencyWeight * std::exp(-ageDays / kRecencyDays)
+            + kFrequencyWeight * std::log2(1 + decayedFrequency(peer, now));
+    // a fast link breaks ties between devices used about as much:
+    // 0 at 100 KB/s up to 3 steps at 100 MB/s
+    if (peer.throughput > 0) {
+        score += kThroughputWeight * std::clamp(std::log10(double(peer.throughput) / 1e5), 0.0, 3.0);
+    }
+    if (peer.rttMs >= 0) {
+        score -= std::min(peer.rttMs / 20, kRttWeight);
+    }
+    return score;
+}
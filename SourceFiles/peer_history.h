@@ -0,0 +1,69 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include <QString>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+// What we know about devices we sent to, kept across runs to rank them.
+class PeerHistory {
+public:
+    struct Peer {
+        QString id;
+        QString name;
+        // ms since epoch
+        qint64 lastUsed = 0;
+        // sends, decayed with age so old habits fade
+        double frequency = 0;
+        // bytes per second of the last send or probe, 0 when unknown
+        qint64 throughput = 0;
+        // of the last probe, negative when unknown
+        double rttMs = -1;
+        // where it was last reached, empty when never
+        QString address;
+        quint16 probePort = 0;
+    };
+
+    explicit PeerHistory(QString path);
+
+    void load();
+
+    void remember(const QString &id, const QString &name);
+
+    void recordSend(const QString &id, qint64 bytes, qint64 elapsedMs);
+
+    void recordProbe(const QString &id, qint64 throughput, double rttMs);
+
+    void recordAddress(const QString &id, const QString &address, quint16 probePort);
+
+    [[nodiscard]] std::optional<Peer> find(const QString &id) const;
+
+    // Higher is better, 0 for devices we never used.
+    [[nodiscard]] double score(const QString &id) const;
+
+    // Most recently used first.
+    [[nodiscard]] std::vector<Peer> recent(std::size_t count) const;
+
+private:
+    [[nodiscard]] static double score(const Peer &peer, qint64 now);
+    [[nodiscard]] static double decayedFrequency(const Peer &peer, qint64 now);
+
+    // Writes what changed since the last save, outside of _mutex so the
+    // file write doesn't hold up lookups.
+    bool save();
+
+    const QString _path;
+    mutable std::mutex _mutex;
+    std::map<QString, Peer> _peers;
+    quint64 _generation = 0;
+    // held while writing, saves run one at a time
+    std::mutex _saveMutex;
+    quint64 _savedGeneration = 0;
+}; // PeerHistory
@@ -0,0 +1,55 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "platform/platform_files.h"
+
+#include <QFile>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Platform::Files {
+    bool dataExtents(const QString &path, std::vector<Extent> &extents) {
+        int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st{};
+        if (::fstat(fd, &st) != 0 || qint64(st.st_blocks) * 512 >= qint64(st.st_size)) {
+            ::close(fd);
+            return false;
+        }
+        extents.clear();
+        off_t position = 0;
+        while (position < st.st_size) {
+            off_t data = ::lseek(fd, position, SEEK_DATA);
+            if (data < 0) {
+                break; // ENXIO: only a hole is left
+            }
+            off_t hole = ::lseek(fd, data, SEEK_HOLE);
+            if (hole < 0) {
+                hole = st.st_size;
+            }
+            extents.push_back({qint64(data), qint64(hole - data)});
+            position = hole;
+        }
+        ::close(fd);
+        return true;
+    }
+
+    bool makeFifo(const QString &path) {
+        return ::mkfifo(QFile::encodeName(path).constData(), 0600) == 0;
+    }
+
+    void closeFifo(const QString &path) {
+        // fails with ENXIO when nobody is reading, nothing to wake then
+        int fd = ::open(QFile::encodeName(path).constData(), O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+} // namespace Platform::Files
@@ -0,0 +1,39 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "platform/platform_files.h"
+
+#include <QFile>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+namespace Platform::Files {
+    bool cloneFile(const QString &src, const QString &dst) {
+        int srcFd = ::open(QFile::encodeName(src).constData(), O_RDONLY | O_CLOEXEC);
+        if (srcFd < 0) {
+            return false;
+        }
+        int dstFd = ::open(QFile::encodeName(dst).constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (dstFd < 0) {
+            ::close(srcFd);
+            return false;
+        }
+        bool cloned = ::ioctl(dstFd, FICLONE, srcFd) == 0;
+        ::close(dstFd);
+        ::close(srcFd);
+        if (!cloned) {
+            ::unlink(QFile::encodeName(dst).constData());
+        }
+        return cloned;
+    }
+
+    bool hardLink(const QString &src, const QString &dst) {
+        return ::link(QFile::encodeName(src).constData(), QFile::encodeName(dst).constData()) == 0;
+    }
+} // namespace Platform::Files
@@ -18,6 +18,7 @@
 #include <QStyleFactory>
 #include <QScopedPointer>
 #include <QSystemTrayIcon>
+#include <map>
 #include <memory>
 
 #define TRAY_ICON_SIZE 16
@@ -27,6 +28,7 @@ namespace Platform {
     struct Tray::Impl {
         QScopedPointer<QSystemTrayIcon> _icon;
         QScopedPointer<QMenu> _menu;
+        std::map<QString, QMenu *> _submenus;
 
         void renderAndSetIcon(bool dark) const {
             QColor color = dark ? QColorConstants::White : QColorConstants::Black;
@@ -92,4 +94,16 @@ namespace Platform {
         }
     }
 
+    void Tray::setSubmenu(const QString &title, std::vector<Action> actions) {
+        QMenu *&submenu = pImpl->_submenus[title];
+        if (!submenu) {
+            submenu = pImpl->_menu->addMenu(title);
+        }
+        submenu->clear();
+        for (auto &action : actions) {
+            submenu->addAction(action.text, std::move(action.callback));
+        }
+        submenu->menuAction()->setVisible(!actions.empty());
+    }
+
 } // namespace Platform
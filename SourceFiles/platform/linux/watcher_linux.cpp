@@ -0,0 +1,153 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "platform/platform_watcher.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QHash>
+#include <QSocketNotifier>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace Platform {
+
+    namespace {
+
+        constexpr uint32_t kWatchMask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE
+                | IN_DELETE_SELF | IN_ONLYDIR;
+
+    } // namespace
+
+    class FolderWatcher::Impl {
+    public:
+        Impl(const QString &root, Fn<void(Change, const QString &)> callback)
+                : _callback(std::move(callback)),
+                  _fd(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {
+            if (_fd < 0) {
+                qWarning() << "inotify is not available";
+                return;
+            }
+            _notifier = std::make_unique<QSocketNotifier>(_fd, QSocketNotifier::Read);
+            QObject::connect(_notifier.get(), &QSocketNotifier::activated, [this]() {
+                readEvents();
+            });
+            addTree(root, false);
+        }
+
+        ~Impl() {
+            _notifier.reset();
+            if (_fd >= 0) {
+                ::close(_fd);
+            }
+        }
+
+        [[nodiscard]] bool isValid() const {
+            return _fd >= 0 && !_paths.isEmpty();
+        }
+
+    private:
+        // Files already in a new folder were written before it was watched,
+        // so they are reported here.
+        void addTree(const QString &root, bool reportFiles) {
+            addWatch(root);
+            QDirIterator it(root, QDir::Dirs | QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot | QDir::NoSymLinks,
+                            QDirIterator::Subdirectories);
+            while (it.hasNext()) {
+                QString path = it.next();
+                if (it.fileInfo().isDir()) {
+                    addWatch(path);
+                } else if (reportFiles) {
+                    _callback(Change::Written, path);
+                }
+            }
+        }
+
+        void addWatch(const QString &path) {
+            int wd = ::inotify_add_watch(_fd, QFile::encodeName(path).constData(), kWatchMask);
+            if (wd < 0) {
+                // most likely fs.inotify.max_user_watches
+                qWarning() << "Cannot watch" << path;
+                return;
+            }
+            _paths[wd] = path;
+        }
+
+        void readEvents() {
+            alignas(inotify_event) char buffer[64 * 1024];
+            ssize_t length;
+            while ((length = ::read(_fd, buffer, sizeof(buffer))) > 0) {
+                for (char *p = buffer; p < buffer + length;) {
+                    const auto *event = reinterpret_cast<const inotify_event *>(p);
+                    handle(*event);
+                    p += sizeof(inotify_event) + event->len;
+                }
+            }
+        }
+
+        void handle(const inotify_event &event) {
+            if (event.mask & IN_Q_OVERFLOW) {
+                _callback(Change::Rescan, {});
+                return;
+            }
+            if (event.mask & IN_IGNORED) {
+                _paths.remove(event.wd);
+                return;
+            }
+            auto it = _paths.constFind(event.wd);
+            if (it == _paths.constEnd()) {
+                return;
+            }
+            if (event.mask & IN_DELETE_SELF) {
+                _callback(Change::Removed, it.value());
+                return;
+            }
+            QString path = event.len > 0 ? it.value() + '/' + QFile::decodeName(event.name) : it.value();
+            if (event.mask & IN_ISDIR) {
+                if (event.mask & (IN_CREATE | IN_MOVED_TO)) {
+                    addTree(path, true);
+                } else if (event.mask & IN_MOVED_FROM) {
+                    // the watches follow the folder, stop reporting it under
+                    // the old path
+                    QString prefix = path + '/';
+                    for (auto watch = _paths.begin(); watch != _paths.end(); ++watch) {
+                        if (watch.value() == path || watch.value().startsWith(prefix)) {
+                            ::inotify_rm_watch(_fd, watch.key());
+                        }
+                    }
+                    _callback(Change::Removed, path);
+                } else if (event.mask & IN_DELETE) {
+                    _callback(Change::Removed, path);
+                }
+                return;
+            }
+            if (event.mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                _callback(Change::Written, path);
+            } else if (event.mask & (IN_DELETE | IN_MOVED_FROM)) {
+                _callback(Change::Removed, path);
+            }
+        }
+
+        Fn<void(Change, const QString &)> _callback;
+        int _fd = -1;
+        std::unique_ptr<QSocketNotifier> _notifier;
+        QHash<int, QString> _paths;
+    };
+
+    FolderWatcher::FolderWatcher(const QString &root, Fn<void(Change, const QString &)> callback)
+            : pImpl(std::make_unique<Impl>(QDir::cleanPath(root), std::move(callback))) {
+    }
+
+    FolderWatcher::~FolderWatcher() = default;
+
+    bool FolderWatcher::isValid() const {
+        return pImpl->isValid();
+    }
+
+} // namespace Platform
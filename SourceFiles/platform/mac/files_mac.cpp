@@ -0,0 +1,22 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "platform/platform_files.h"
+
+#include <QFile>
+#include <sys/clonefile.h>
+#include <unistd.h>
+
+namespace Platform::Files {
+    bool cloneFile(const QString &src, const QString &dst) {
+        return ::clonefile(QFile::encodeName(src).constData(), QFile::encodeName(dst).constData(), 0) == 0;
+    }
+
+    bool hardLink(const QString &src, const QString &dst) {
+        return ::link(QFile::encodeName(src).constData(), QFile::encodeName(dst).constData()) == 0;
+    }
+} // namespace Platform::Files
@@ -13,6 +13,7 @@
 #include <QStyleFactory>
 #include <QScopedPointer>
 #include <QSystemTrayIcon>
+#include <map>
 #include <memory>
 
 #include <Cocoa/Cocoa.h>
@@ -167,6 +168,7 @@ namespace Platform {
     struct Tray::Impl {
         std::unique_ptr<NativeIcon> _nativeIcon;
         QMenu *_menu;
+        std::map<QString, QMenu *> _submenus;
 
         void updateIcon() {
             if (_nativeIcon) {
@@ -195,4 +197,17 @@ namespace Platform {
         pImpl->_menu->addAction(text, callback);
     }
 
+    void Tray::setSubmenu(const QString &title, std::vector<Action> actions) {
+        // the native menu follows changes of the QMenu it was made from
+        QMenu *&submenu = pImpl->_submenus[title];
+        if (!submenu) {
+            submenu = pImpl->_menu->addMenu(title);
+        }
+        submenu->clear();
+        for (auto &action : actions) {
+            submenu->addAction(action.text, action.callback);
+        }
+        submenu->menuAction()->setVisible(!actions.empty());
+    }
+
 } // namespace Platform
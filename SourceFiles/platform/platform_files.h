@@ -0,0 +1,36 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include <QString>
+#include <vector>
+
+namespace Platform {
+    namespace Files {
+        struct Extent {
+            qint64 offset = 0;
+            qint64 length = 0;
+        };
+
+        // Creates dst as a copy-on-write clone of src, dst must not exist.
+        bool cloneFile(const QString &src, const QString &dst);
+
+        bool hardLink(const QString &src, const QString &dst);
+
+        // Lists the ranges of path that hold data. Returns false for files
+        // without holes, so callers can take the plain path for them.
+        bool dataExtents(const QString &path, std::vector<Extent> &extents);
+
+        // Creates a named pipe at path. The process should ignore SIGPIPE,
+        // a reader going away must fail the write, not kill it.
+        bool makeFifo(const QString &path);
+
+        // Opens and closes the write end of the named pipe at path, so a
+        // reader blocked opening it sees the end of the data.
+        void closeFifo(const QString &path);
+    } // namespace Files
+} // namespace Platform
@@ -11,6 +11,7 @@
 #include "resources.h"
 
 #include <memory>
+#include <vector>
 #include <QIcon>
 #include <QColor>
 #include <QPainter>
@@ -21,6 +22,11 @@ namespace Platform {
 
     class Tray {
     public:
+        struct Action {
+            QString text;
+            Fn<void()> callback;
+        };
+
         Tray();
         ~Tray();
 
@@ -28,6 +34,10 @@ namespace Platform {
 
         void addAction(const QString &text, Fn<void()> &&callback);
 
+        // The first call adds the submenu after the actions added so far,
+        // later calls replace its actions. Hidden while it has none.
+        void setSubmenu(const QString &title, std::vector<Action> actions);
+
         static QIcon renderIcon(int size, QColor color) {
             QIcon icon(::renderIcon(size, color));
             return icon;
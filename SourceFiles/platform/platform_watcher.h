@@ -0,0 +1,36 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include "base_util.h"
+
+#include <QString>
+#include <memory>
+
+namespace Platform {
+
+    // Watches a folder and everything below it. Events are delivered on the
+    // thread that created the watcher, which needs an event loop.
+    class FolderWatcher {
+    public:
+        enum class Change {
+            Written, // a file was closed after writing or moved in
+            Removed, // a file or folder was deleted or moved out
+            Rescan   // events were lost, the whole tree has to be checked
+        };
+
+        FolderWatcher(const QString &root, Fn<void(Change, const QString &)> callback);
+        ~FolderWatcher();
+
+        [[nodiscard]] bool isValid() const;
+
+    private:
+        class Impl;
+        std::unique_ptr<Impl> pImpl;
+    }; // FolderWatcher
+
+} // namespace Platform
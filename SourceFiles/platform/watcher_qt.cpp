@@ -0,0 +1,155 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+// QFileSystemWatcher based implementation for the systems without inotify.
+// It only reports that a folder changed, so every folder keeps a listing to
+// find out what changed. Written is reported on every size or time change,
+// callers wait for the file to become quiet anyway.
+
+#include "platform/platform_watcher.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <utility>
+
+namespace Platform {
+
+    namespace {
+
+        struct Entry {
+            bool dir = false;
+            qint64 size = 0;
+            QDateTime modified;
+
+            bool operator==(const Entry &other) const {
+                return dir == other.dir && size == other.size && modified == other.modified;
+            }
+        };
+
+        using Listing = QHash<QString, Entry>;
+
+        Listing list(const QString &dirPath) {
+            Listing listing;
+            const auto entries = QDir(dirPath).entryInfoList(
+                    QDir::Dirs | QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot | QDir::NoSymLinks);
+            for (const QFileInfo &info : entries) {
+                listing.insert(info.fileName(), {info.isDir(), info.size(), info.lastModified()});
+            }
+            return listing;
+        }
+
+    } // namespace
+
+    class FolderWatcher::Impl {
+    public:
+        Impl(const QString &root, Fn<void(Change, const QString &)> callback)
+                : _callback(std::move(callback)) {
+            QObject::connect(&_watcher, &QFileSystemWatcher::directoryChanged, [this](const QString &path) {
+                changed(path);
+            });
+            addTree(root, false);
+        }
+
+        [[nodiscard]] bool isValid() const {
+            return !_listings.isEmpty();
+        }
+
+    private:
+        void addTree(const QString &root, bool reportFiles) {
+            addDir(root, reportFiles);
+            QDirIterator it(root, QDir::Dirs | QDir::Hidden | QDir::NoDotAndDotDot | QDir::NoSymLinks,
+                            QDirIterator::Subdirectories);
+            while (it.hasNext()) {
+                addDir(it.next(), reportFiles);
+            }
+        }
+
+        void addDir(const QString &path, bool reportFiles) {
+            if (!_watcher.addPath(path)) {
+                return;
+            }
+            Listing listing = list(path);
+            if (reportFiles) {
+                for (auto it = listing.constBegin(); it != listing.constEnd(); ++it) {
+                    if (!it->dir) {
+                        _callback(Change::Written, path + '/' + it.key());
+                    }
+                }
+            }
+            _listings.insert(path, std::move(listing));
+        }
+
+        void removeTree(const QString &path) {
+            QString prefix = path + '/';
+            for (auto it = _listings.begin(); it != _listings.end();) {
+                if (it.key() == path || it.key().startsWith(prefix)) {
+                    _watcher.removePath(it.key());
+                    it = _listings.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        void changed(const QString &dirPath) {
+            auto previous = _listings.find(dirPath);
+            if (previous == _listings.end()) {
+                return;
+            }
+            if (!QFileInfo(dirPath).isDir()) {
+                removeTree(dirPath);
+                _callback(Change::Removed, dirPath);
+                return;
+            }
+            Listing current = list(dirPath);
+            Listing old = std::exchange(previous.value(), current);
+            for (auto it = current.constBegin(); it != current.constEnd(); ++it) {
+                QString path = dirPath + '/' + it.key();
+                auto before = old.constFind(it.key());
+                if (before != old.constEnd() && *before == *it) {
+                    continue;
+                }
+                if (it->dir) {
+                    if (before == old.constEnd()) {
+                        addTree(path, true);
+                    }
+                } else {
+                    _callback(Change::Written, path);
+                }
+            }
+            for (auto it = old.constBegin(); it != old.constEnd(); ++it) {
+                if (current.contains(it.key())) {
+                    continue;
+                }
+                QString path = dirPath + '/' + it.key();
+                if (it->dir) {
+                    removeTree(path);
+                }
+                _callback(Change::Removed, path);
+            }
+        }
+
+        Fn<void(Change, const QString &)> _callback;
+        QFileSystemWatcher _watcher;
+        QHash<QString, Listing> _listings;
+    };
+
+    FolderWatcher::FolderWatcher(const QString &root, Fn<void(Change, const QString &)> callback)
+            : pImpl(std::make_unique<Impl>(QDir::cleanPath(root), std::move(callback))) {
+    }
+
+    FolderWatcher::~FolderWatcher() = default;
+
+    bool FolderWatcher::isValid() const {
+        return pImpl->isValid();
+    }
+
+} // namespace Platform
@@ -0,0 +1,43 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "../platform_files.h"
+
+#include <QDir>
+#include "Windows.h"
+
+namespace Platform::Files {
+    bool cloneFile(const QString &src, const QString &dst) {
+        Q_UNUSED(src)
+        Q_UNUSED(dst)
+        // block cloning is only available on ReFS volumes, not worth it here
+        return false;
+    }
+
+    bool hardLink(const QString &src, const QString &dst) {
+        return CreateHardLinkW(
+                reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(dst).utf16()),
+                reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(src).utf16()),
+                nullptr) != 0;
+    }
+
+    bool dataExtents(const QString &path, std::vector<Extent> &extents) {
+        Q_UNUSED(path)
+        Q_UNUSED(extents)
+        return false;
+    }
+
+    bool makeFifo(const QString &path) {
+        Q_UNUSED(path)
+        // named pipes live in their own namespace, not at a file path
+        return false;
+    }
+
+    void closeFifo(const QString &path) {
+        Q_UNUSED(path)
+    }
+} // namespace Platform::Files
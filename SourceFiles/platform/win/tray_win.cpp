@@ -19,7 +19,9 @@
 #include <QGraphicsProxyWidget>
 #include <QPropertyAnimation>
 #include <QWindow>
+#include <map>
 #include <memory>
+#include <optional>
 #include <Windows.h>
 #include "application.h"
 #include "style.h"
@@ -134,6 +136,41 @@ public:
         _layout->addWidget(settingsItem);
     }
 
+    void setSubmenu(const QString &title, std::vector<Platform::Tray::Action> &actions) {
+        Submenu &submenu = _submenus[title];
+        if (!submenu.item) {
+            submenu.item = new TrayMenuItem(title + "  ▸");
+            // not a child, it would be hidden together with this menu
+            submenu.menu = std::make_unique<TrayMenu>();
+            connect(submenu.item, &TrayMenuItem::clicked, [item = submenu.item, menu = submenu.menu.get(), this]() {
+                QPoint anchor = item->mapToGlobal(QPoint(item->width(), 0));
+                close();
+                menu->showAt(anchor);
+            });
+            _layout->addWidget(submenu.item);
+        }
+        submenu.menu->clear();
+        for (auto &action : actions) {
+            submenu.menu->addAction(action.text, action.callback);
+        }
+        submenu.item->setVisible(!actions.empty());
+    }
+
+    void clear() {
+        while (QLayoutItem *item = _layout->takeAt(0)) {
+            // may be called from one of the items' callbacks
+            item->widget()->hide();
+            item->widget()->deleteLater();
+            delete item;
+        }
+    }
+
+    void showAt(const QPoint &p) {
+        _anchor = p;
+        show();
+        activateWindow();
+    }
+
     bool prepareGeometryFor(const QPoint &p) {
         QList<QScreen*> screens = QGuiApplication::screens();
         if (screens.isEmpty()) return false;
@@ -186,7 +223,10 @@ protected:
 
     void showEvent(QShowEvent* event) override {
         QWidget::showEvent(event);
-        prepareGeometryFor(QCursor::pos());
+        // items may have been hidden or added since the last time
+        adjustSize();
+        prepareGeometryFor(_anchor.value_or(QCursor::pos()));
+        _anchor.reset();
         // snail code sorry
         for (int i = 0; i < _layout->count(); ++i) {
             QLayoutItem *item = _layout->itemAt(i);
@@ -204,7 +244,14 @@ protected:
     }
 
 private:
+    struct Submenu {
+        TrayMenuItem *item = nullptr;
+        std::unique_ptr<TrayMenu> menu;
+    };
+
     QVBoxLayout *_layout;
+    std::map<QString, Submenu> _submenus;
+    std::optional<QPoint> _anchor;
 };
 
 namespace Platform {
@@ -266,6 +313,10 @@ namespace Platform {
         pImpl->_menu->addAction(text, callback);
     }
 
+    void Tray::setSubmenu(const QString &title, std::vector<Action> actions) {
+        pImpl->_menu->setSubmenu(title, actions);
+    }
+
 } // namespace Platform
 
 #include "tray_win.moc"
\ No newline at end of file
@@ -28,10 +28,43 @@ Settings::Settings() : m_version("1.0") {
             {Setting::OverrideName, "override_name"},
             {Setting::OverrideModel, "override_model"},
             {Setting::OverridePlatform, "override_platform"},
-            {Setting::OverrideSystemVersion, "override_system_version"}
+            {Setting::OverrideSystemVersion, "override_system_version"},
+            {Setting::DeltaTransfer, "delta_transfer"},
+            {Setting::ExtendedFormats, "extended_formats"},
+            {Setting::Dedup, "dedup"},
+            {Setting::RateLimit, "rate_limit"},
+            {Setting::RateLimitUpload, "rate_limit_upload"},
+            {Setting::RateLimitDownload, "rate_limit_download"},
+            {Setting::RateLimitPeer, "rate_limit_peer"},
+            {Setting::MaxIncomingSessions, "max_incoming_sessions"},
+            {Setting::MaxIncomingMiB, "max_incoming_mib"},
+            {Setting::BufferPoolMiB, "buffer_pool_mib"},
+            {Setting::StreamRules, "stream_rules"},
+            {Setting::HotFolder, "hot_folder"},
+            {Setting::HotFolderReceiver, "hot_folder_receiver"},
+            {Setting::HotFolderQuietMs, "hot_folder_quiet_ms"},
+            {Setting::HotFolderArchive, "hot_folder_archive"},
+            {Setting::MirrorFolder, "mirror_folder"},
+            {Setting::MirrorReceiver, "mirror_receiver"},
+            {Setting::MirrorSource, "mirror_source"},
+            {Setting::PreferredInterface, "preferred_interface"},
+            {Setting::DebugLog, "debug_log"},
+            {Setting::DeviceId, "device_id"}
     };
     m_settings[settingToString(Setting::Dest)] = getDefaultDest();
     m_settings[settingToString(Setting::AskMode)] = "ALWAYS";
+    m_settings[settingToString(Setting::DeltaTransfer)] = "OFF";
+    m_settings[settingToString(Setting::ExtendedFormats)] = "OFF";
+    m_settings[settingToString(Setting::Dedup)] = "OFF";
+    m_settings[settingToString(Setting::RateLimit)] = "0";
+    m_settings[settingToString(Setting::RateLimitUpload)] = "0";
+    m_settings[settingToString(Setting::RateLimitDownload)] = "0";
+    m_settings[settingToString(Setting::RateLimitPeer)] = "0";
+    m_settings[settingToString(Setting::MaxIncomingSessions)] = "2";
+    m_settings[settingToString(Setting::MaxIncomingMiB)] = "8192";
+    m_settings[settingToString(Setting::BufferPoolMiB)] = "256";
+    m_settings[settingToString(Setting::HotFolderQuietMs)] = "2000";
+    m_settings[settingToString(Setting::DebugLog)] = "OFF";
 
     for (const auto& entry : m_settingToStringMap) {
         m_stringToSettingMap[entry.second] = entry.first;
@@ -16,7 +16,28 @@ enum class Setting {
     OverrideName,
     OverrideModel,
     OverridePlatform,
-    OverrideSystemVersion
+    OverrideSystemVersion,
+    DeltaTransfer,
+    ExtendedFormats,
+    Dedup,
+    RateLimit,
+    RateLimitUpload,
+    RateLimitDownload,
+    RateLimitPeer,
+    MaxIncomingSessions,
+    MaxIncomingMiB,
+    BufferPoolMiB,
+    StreamRules,
+    HotFolder,
+    HotFolderReceiver,
+    HotFolderQuietMs,
+    HotFolderArchive,
+    MirrorFolder,
+    MirrorReceiver,
+    MirrorSource,
+    PreferredInterface,
+    DebugLog,
+    DeviceId
 };
 
 class Settings {
@@ -0,0 +1,143 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/buffer_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <utility>
+
+namespace Transfer {
+
+    namespace {
+
+        constexpr std::size_t kThreadCacheSize = 4;
+
+        char *allocateBuffer() {
+            return static_cast<char *>(::operator new(BufferPool::kBufferSize, std::align_val_t(BufferPool::kAlignment)));
+        }
+
+    } // namespace
+
+    struct ThreadCache {
+        std::vector<char *> buffers;
+
+        ~ThreadCache() {
+            BufferPool::instance().adopt(buffers);
+        }
+    };
+
+    namespace {
+
+        thread_local ThreadCache Cache;
+
+    } // namespace
+
+    Buffer::Buffer(Buffer &&other) noexcept : _data(std::exchange(other._data, nullptr)) {
+    }
+
+    Buffer &Buffer::operator=(Buffer &&other) noexcept {
+        if (this != &other) {
+            if (_data) {
+                BufferPool::instance().release(_data);
+            }
+            _data = std::exchange(other._data, nullptr);
+        }
+        return *this;
+    }
+
+    Buffer::~Buffer() {
+        if (_data) {
+            BufferPool::instance().release(_data);
+        }
+    }
+
+    std::size_t Buffer::size() const {
+        return _data ? BufferPool::kBufferSize : 0;
+    }
+
+    BufferPool &BufferPool::instance() {
+        // never destroyed, buffers may come back from threads exiting late
+        static auto *pool = new BufferPool;
+        return *pool;
+    }
+
+    Buffer BufferPool::acquire() {
+        constexpr auto kSize = qint64(kBufferSize);
+        if (!Cache.buffers.empty()) {
+            char *data = Cache.buffers.back();
+            Cache.buffers.pop_back();
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stats.inUse += kSize;
+            _stats.peakInUse = std::max(_stats.peakInUse, _stats.inUse);
+            return Buffer(data);
+        }
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _released.wait_for(lock, std::chrono::milliseconds(kAcquireWaitMs), [&]() {
+            return !_free.empty() || _stats.allocated + kSize <= _limit;
+        });
+        char *data;
+        if (!_free.empty()) {
+            data = _free.back();
+            _free.pop_back();
+        } else {
+            _stats.allocated += kSize;
+            lock.unlock();
+            data = allocateBuffer();
+            lock.lock();
+        }
+        _stats.inUse += kSize;
+        _stats.peakInUse = std::max(_stats.peakInUse, _stats.inUse);
+        return Buffer(data);
+    }
+
+    void BufferPool::release(char *data) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stats.inUse -= qint64(kBufferSize);
+        if (_stats.allocated > _limit) {
+            // the limit was lowered or acquire() went past it, shrink back
+            _stats.allocated -= qint64(kBufferSize);
+            ::operator delete(data, std::align_val_t(kAlignment));
+            return;
+        }
+        // Buffers in a thread cache can't be handed to other threads, so
+        // only cache while at most half of the limit is allocated. The other
+        // half always comes back to the shared list.
+        if (Cache.buffers.size() < kThreadCacheSize && _stats.allocated <= _limit / 2) {
+            Cache.buffers.push_back(data);
+            return;
+        }
+        _free.push_back(data);
+        _released.notify_one();
+    }
+
+    void BufferPool::adopt(std::vector<char *> &buffers) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _free.insert(_free.end(), buffers.begin(), buffers.end());
+        buffers.clear();
+        _released.notify_all();
+    }
+
+    void BufferPool::setLimit(qint64 bytes) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _limit = std::max(bytes, qint64(kBufferSize));
+        while (_stats.allocated > _limit && !_free.empty()) {
+            ::operator delete(_free.back(), std::align_val_t(kAlignment));
+            _free.pop_back();
+            _stats.allocated -= qint64(kBufferSize);
+        }
+        _released.notify_all();
+    }
+
+    BufferPoolStats BufferPool::stats() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _stats;
+    }
+
+} // namespace Transfer
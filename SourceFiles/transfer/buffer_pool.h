@@ -0,0 +1,89 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include <QtGlobal>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace Transfer {
+
+    class BufferPool;
+
+    // A pooled I/O buffer, returned to the pool when destroyed.
+    class Buffer {
+    public:
+        Buffer() = default;
+        Buffer(Buffer &&other) noexcept;
+        Buffer &operator=(Buffer &&other) noexcept;
+        Buffer(const Buffer &) = delete;
+        Buffer &operator=(const Buffer &) = delete;
+        ~Buffer();
+
+        [[nodiscard]] char *data() const {
+            return _data;
+        }
+
+        [[nodiscard]] std::size_t size() const;
+
+    private:
+        friend class BufferPool;
+
+        explicit Buffer(char *data) : _data(data) {}
+
+        char *_data = nullptr;
+    }; // Buffer
+
+    struct BufferPoolStats {
+        qint64 allocated = 0; // bytes held by the pool, in use or cached
+        qint64 inUse = 0;
+        qint64 peakInUse = 0;
+    };
+
+    // Fixed-size, page-aligned buffers for the transfer paths, so they can
+    // be used for O_DIRECT reads. Every thread keeps a few free buffers of
+    // its own, the rest is shared. Allocation stops at the memory limit and
+    // acquire() waits for a buffer to come back instead, for a while: when
+    // none does it allocates past the limit, and release() frees the excess
+    // again, so holders that wait on each other can't deadlock.
+    class BufferPool {
+    public:
+        static constexpr std::size_t kBufferSize = 256 * 1024;
+        static constexpr std::size_t kAlignment = 4096;
+        static constexpr qint64 kDefaultLimit = 256 * 1024 * 1024;
+        static constexpr int kAcquireWaitMs = 2000;
+
+        [[nodiscard]] static BufferPool &instance();
+
+        [[nodiscard]] Buffer acquire();
+
+        // Limit on allocated bytes, never lower than one buffer.
+        void setLimit(qint64 bytes);
+
+        [[nodiscard]] BufferPoolStats stats();
+
+    private:
+        friend class Buffer;
+        friend struct ThreadCache;
+
+        BufferPool() = default;
+
+        void release(char *data);
+
+        // takes the buffers of an exiting thread
+        void adopt(std::vector<char *> &buffers);
+
+        std::mutex _mutex;
+        std::condition_variable _released;
+        std::vector<char *> _free;
+        qint64 _limit = kDefaultLimit;
+        BufferPoolStats _stats;
+    }; // BufferPool
+
+} // namespace Transfer
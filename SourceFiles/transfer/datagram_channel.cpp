@@ -0,0 +1,134 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/datagram_channel.h"
+
+#include <QDebug>
+#include <QNetworkDatagram>
+#include <QNetworkInterface>
+
+#ifdef Q_OS_LINUX
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif // Q_OS_LINUX
+
+namespace Transfer {
+
+    namespace {
+
+        bool networkInterface(const QString &name, QNetworkInterface &result) {
+            if (name.isEmpty()) {
+                return true;
+            }
+            result = QNetworkInterface::interfaceFromName(name);
+            if (!result.isValid()) {
+                qWarning() << "No such network interface:" << name;
+                return false;
+            }
+            return true;
+        }
+
+    } // namespace
+
+    std::unique_ptr<UdpChannel> UdpChannel::open(const QString &interfaceName) {
+        QNetworkInterface iface;
+        if (!networkInterface(interfaceName, iface)) {
+            return nullptr;
+        }
+        std::unique_ptr<UdpChannel> channel(new UdpChannel());
+        if (!channel->_socket.bind(QHostAddress::AnyIPv4, 0)) {
+            qWarning() << "Cannot bind datagram socket:" << channel->_socket.errorString();
+            return nullptr;
+        }
+        channel->setMulticastOptions();
+        if (iface.isValid()) {
+            channel->_socket.setMulticastInterface(iface);
+        }
+        return channel;
+    }
+
+    std::unique_ptr<UdpChannel> UdpChannel::join(const QHostAddress &group, quint16 port, const QString &interfaceName) {
+        QNetworkInterface iface;
+        if (!networkInterface(interfaceName, iface)) {
+            return nullptr;
+        }
+        std::unique_ptr<UdpChannel> channel(new UdpChannel());
+        QUdpSocket &socket = channel->_socket;
+        if (!socket.bind(QHostAddress::AnyIPv4, port, QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint)
+            || !(iface.isValid() ? socket.joinMulticastGroup(group, iface) : socket.joinMulticastGroup(group))) {
+            qWarning() << "Cannot join" << group << ":" << socket.errorString();
+            return nullptr;
+        }
+        channel->setMulticastOptions();
+        return channel;
+    }
+
+    void UdpChannel::setMulticastOptions() {
+        _socket.setSocketOption(QAbstractSocket::MulticastTtlOption, 1);
+        // members on this host have to see the packets as well
+        _socket.setSocketOption(QAbstractSocket::MulticastLoopbackOption, 1);
+    }
+
+    void UdpChannel::send(const QByteArray &data, const QHostAddress &address, quint16 port) {
+        _socket.writeDatagram(data, address, port);
+    }
+
+    void UdpChannel::send(const std::vector<QByteArray> &batch, const QHostAddress &address, quint16 port) {
+        std::size_t sent = 0;
+#ifdef Q_OS_LINUX
+        // one sendmmsg() instead of a system call per datagram
+        sockaddr_in target{};
+        target.sin_family = AF_INET;
+        target.sin_port = htons(port);
+        target.sin_addr.s_addr = htonl(address.toIPv4Address());
+        std::vector<iovec> vectors(batch.size());
+        std::vector<mmsghdr> messages(batch.size());
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            vectors[i].iov_base = const_cast<char *>(batch[i].constData());
+            vectors[i].iov_len = std::size_t(batch[i].size());
+            messages[i].msg_hdr.msg_name = &target;
+            messages[i].msg_hdr.msg_namelen = sizeof(target);
+            messages[i].msg_hdr.msg_iov = &vectors[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+        auto fd = int(_socket.socketDescriptor());
+        while (fd >= 0 && sent < batch.size()) {
+            int result = ::sendmmsg(fd, messages.data() + sent, unsigned(batch.size() - sent), 0);
+            if (result <= 0) {
+                break; // the rest takes the portable path, it reports errors
+            }
+            sent += std::size_t(result);
+        }
+#endif // Q_OS_LINUX
+        for (; sent < batch.size(); ++sent) {
+            send(batch[sent], address, port);
+        }
+    }
+
+    bool UdpChannel::wait(int timeoutMs) {
+        return _socket.hasPendingDatagrams() || _socket.waitForReadyRead(timeoutMs);
+    }
+
+    std::optional<Datagram> UdpChannel::receive() {
+        if (!_socket.hasPendingDatagrams()) {
+            return std::nullopt;
+        }
+        QNetworkDatagram datagram = _socket.receiveDatagram();
+        return Datagram{datagram.data(), datagram.senderAddress(), quint16(datagram.senderPort())};
+    }
+
+    void UdpChannel::setBufferSizes(int send, int receive) {
+        // SO_SNDBUF and SO_RCVBUF, the kernel may clamp them
+        if (send > 0) {
+            _socket.setSocketOption(QAbstractSocket::SendBufferSizeSocketOption, send);
+        }
+        if (receive > 0) {
+            _socket.setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption, receive);
+        }
+    }
+
+} // namespace Transfer
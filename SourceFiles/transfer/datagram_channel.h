@@ -0,0 +1,76 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include <QByteArray>
+#include <QHostAddress>
+#include <QUdpSocket>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace Transfer {
+
+    struct Datagram {
+        QByteArray data;
+        QHostAddress address;
+        quint16 port = 0;
+    };
+
+    // What our own datagram transports send through, so they can run
+    // over a real socket or an emulated link.
+    class DatagramChannel {
+    public:
+        virtual ~DatagramChannel() = default;
+
+        virtual void send(const QByteArray &data, const QHostAddress &address, quint16 port) = 0;
+
+        // Sends the datagrams in order, in as few system calls as the
+        // platform allows.
+        virtual void send(const std::vector<QByteArray> &batch, const QHostAddress &address, quint16 port) {
+            for (const auto &data : batch) {
+                send(data, address, port);
+            }
+        }
+
+        // Blocks until a datagram can be received or the timeout passes.
+        virtual bool wait(int timeoutMs) = 0;
+
+        // Doesn't block.
+        virtual std::optional<Datagram> receive() = 0;
+
+        // Socket buffer sizes in bytes, 0 leaves one as it is.
+        virtual void setBufferSizes(int send, int receive) {
+            Q_UNUSED(send)
+            Q_UNUSED(receive)
+        }
+    }; // DatagramChannel
+
+    class UdpChannel final : public DatagramChannel {
+    public:
+        // Binds any port to send to the group from. Multicast leaves through
+        // the named interface, or the one the system picks when empty.
+        static std::unique_ptr<UdpChannel> open(const QString &interfaceName = {});
+        // Binds the group port, shared with the other members on this host,
+        // and joins the group on the named interface.
+        static std::unique_ptr<UdpChannel> join(const QHostAddress &group, quint16 port, const QString &interfaceName = {});
+
+        void send(const QByteArray &data, const QHostAddress &address, quint16 port) override;
+        void send(const std::vector<QByteArray> &batch, const QHostAddress &address, quint16 port) override;
+        bool wait(int timeoutMs) override;
+        std::optional<Datagram> receive() override;
+        void setBufferSizes(int send, int receive) override;
+
+    private:
+        UdpChannel() = default;
+
+        void setMulticastOptions();
+
+        QUdpSocket _socket;
+    }; // UdpChannel
+
+} // namespace Transfer
@@ -0,0 +1,460 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/delta.h"
+
+#include "transfer/buffer_pool.h"
+#include "transfer/rolling_checksum.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <gsl/gsl>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <unordered_map>
+
+namespace Transfer {
+
+    namespace {
+
+        constexpr char kSignatureMagic[] = "FDSIG002";
+        constexpr char kDeltaMagic[] = "FDDELTA2";
+        constexpr int kMagicLength = 8;
+
+        constexpr std::uint32_t kMinBlockSize = 2048;
+        constexpr std::uint32_t kMaxBlockSize = 128 * 1024;
+        constexpr qint64 kReadSize = 1024 * 1024;
+        constexpr std::uint32_t kMaxLiteral = 256 * 1024;
+
+        enum DeltaOp : quint8 {
+            OpCopy = 'C',
+            OpLiteral = 'L',
+            OpEnd = 'E'
+        };
+
+        QByteArray strongHash(const std::uint8_t *data, std::size_t length) {
+            return QCryptographicHash::hash(
+                    QByteArrayView(reinterpret_cast<const char *>(data), static_cast<qsizetype>(length)),
+                    QCryptographicHash::Md5);
+        }
+
+        bool readMagic(QDataStream &stream, const char *magic) {
+            char buffer[kMagicLength];
+            return stream.readRawData(buffer, kMagicLength) == kMagicLength
+                   && std::memcmp(buffer, magic, kMagicLength) == 0;
+        }
+
+        // Collects the aligned block signature of a file that is read
+        // sequentially in arbitrary pieces.
+        class SignatureBuilder {
+        public:
+            explicit SignatureBuilder(DeltaSignature &signature, std::uint32_t blockSize)
+                    : _signature(signature),
+                      _fileHash(QCryptographicHash::Md5) {
+                _signature.blockSize = blockSize;
+                _signature.fileSize = 0;
+                _signature.fileHash.clear();
+                _signature.blocks.clear();
+                _block.reserve(blockSize);
+            }
+
+            void feed(const std::uint8_t *data, std::size_t length) {
+                _signature.fileSize += length;
+                _fileHash.addData(QByteArrayView(reinterpret_cast<const char *>(data), static_cast<qsizetype>(length)));
+                while (length > 0) {
+                    std::size_t take = std::min<std::size_t>(length, _signature.blockSize - _block.size());
+                    _block.insert(_block.end(), data, data + take);
+                    data += take;
+                    length -= take;
+                    if (_block.size() == _signature.blockSize) {
+                        flush();
+                    }
+                }
+            }
+
+            void finish() {
+                if (!_block.empty()) {
+                    flush();
+                }
+                _signature.fileHash = _fileHash.result();
+            }
+
+        private:
+            void flush() {
+                _signature.blocks.push_back({
+                        weakChecksum(_block.data(), _block.size()),
+                        strongHash(_block.data(), _block.size())});
+                _block.clear();
+            }
+
+            DeltaSignature &_signature;
+            QCryptographicHash _fileHash;
+            std::vector<std::uint8_t> _block;
+        };
+
+        class DeltaWriter {
+        public:
+            explicit DeltaWriter(QDataStream &stream) : _stream(stream) {
+            }
+
+            void copy(std::uint32_t index) {
+                if (_copyCount > 0 && _copyIndex + _copyCount == index) {
+                    ++_copyCount;
+                    return;
+                }
+                flushCopy();
+                _copyIndex = index;
+                _copyCount = 1;
+            }
+
+            void literal(const std::uint8_t *data, std::size_t length) {
+                if (length == 0) return;
+                flushCopy();
+                while (length > 0) {
+                    auto chunk = static_cast<std::uint32_t>(std::min<std::size_t>(length, kMaxLiteral));
+                    _stream << quint8(OpLiteral) << quint32(chunk);
+                    _stream.writeRawData(reinterpret_cast<const char *>(data), static_cast<int>(chunk));
+                    data += chunk;
+                    length -= chunk;
+                }
+            }
+
+            void end(const QByteArray &targetHash) {
+                flushCopy();
+                _stream << quint8(OpEnd);
+                _stream.writeRawData(targetHash.constData(), static_cast<int>(targetHash.size()));
+            }
+
+        private:
+            void flushCopy() {
+                if (_copyCount == 0) return;
+                _stream << quint8(OpCopy) << quint32(_copyIndex) << quint32(_copyCount);
+                _copyCount = 0;
+            }
+
+            QDataStream &_stream;
+            std::uint32_t _copyIndex = 0;
+            std::uint32_t _copyCount = 0;
+        };
+
+    } // namespace
+
+    bool DeltaSignature::save(const QString &path) const {
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly)) {
+            return false;
+        }
+        QDataStream stream(&file);
+        stream.writeRawData(kSignatureMagic, kMagicLength);
+        stream << quint32(blockSize) << quint64(fileSize);
+        stream.writeRawData(fileHash.constData(), static_cast<int>(fileHash.size()));
+        stream << quint32(blocks.size());
+        for (const auto &block : blocks) {
+            stream << quint32(block.weak);
+            stream.writeRawData(block.strong.constData(), static_cast<int>(block.strong.size()));
+        }
+        return stream.status() == QDataStream::Ok;
+    }
+
+    bool DeltaSignature::load(const QString &path) {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+        QDataStream stream(&file);
+        if (!readMagic(stream, kSignatureMagic)) {
+            return false;
+        }
+        const int strongLength = QCryptographicHash::hashLength(QCryptographicHash::Md5);
+        quint32 storedBlockSize;
+        quint64 storedFileSize;
+        QByteArray storedHash(strongLength, Qt::Uninitialized);
+        quint32 count;
+        stream >> storedBlockSize >> storedFileSize;
+        if (stream.readRawData(storedHash.data(), strongLength) != strongLength) {
+            return false;
+        }
+        stream >> count;
+        if (stream.status() != QDataStream::Ok || storedBlockSize < kMinBlockSize || storedBlockSize > kMaxBlockSize) {
+            return false;
+        }
+        blockSize = storedBlockSize;
+        fileSize = storedFileSize;
+        fileHash = storedHash;
+        blocks.clear();
+        blocks.reserve(count);
+        for (quint32 i = 0; i < count; ++i) {
+            DeltaBlock block;
+            quint32 weak;
+            stream >> weak;
+            block.weak = weak;
+            block.strong.resize(strongLength);
+            if (stream.readRawData(block.strong.data(), strongLength) != strongLength) {
+                return false;
+            }
+            blocks.push_back(std::move(block));
+        }
+        return stream.status() == QDataStream::Ok;
+    }
+
+    QByteArray hashFile(const QString &filePath) {
+        QFile file(filePath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return {};
+        }
+        QCryptographicHash hash(QCryptographicHash::Md5);
+        if (!hash.addData(&file)) {
+            return {};
+        }
+        return hash.result();
+    }
+
+    std::uint32_t deltaBlockSizeFor(std::uint64_t fileSize) {
+        // same rule of thumb as rsync: block size around sqrt(size)
+        auto blockSize = kMinBlockSize;
+        while (blockSize < kMaxBlockSize && std::uint64_t(blockSize) * blockSize < fileSize) {
+            blockSize *= 2;
+        }
+        return blockSize;
+    }
+
+    bool buildDeltaSignature(const QString &filePath, DeltaSignature &signature) {
+        QFile file(filePath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+        SignatureBuilder builder(signature, deltaBlockSizeFor(file.size()));
+        Buffer buffer = BufferPool::instance().acquire();
+        qint64 read;
+        while ((read = file.read(buffer.data(), qint64(buffer.size()))) > 0) {
+            builder.feed(reinterpret_cast<const std::uint8_t *>(buffer.data()), static_cast<std::size_t>(read));
+        }
+        builder.finish();
+        return read == 0;
+    }
+
+    bool writeDelta(
+            const QString &targetPath,
+            const DeltaSignature &basis,
+            const QString &deltaPath,
+            DeltaSignature &targetSignature) {
+        QFile in(targetPath);
+        if (!in.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+        QFile out(deltaPath);
+        if (!out.open(QIODevice::WriteOnly)) {
+            return false;
+        }
+
+        const std::size_t blockSize = basis.blockSize;
+        std::unordered_multimap<std::uint32_t, std::uint32_t> lookup;
+        lookup.reserve(basis.blocks.size());
+        for (std::uint32_t i = 0; i < basis.blocks.size(); ++i) {
+            // the short tail block can't be found by a full-size window
+            if (i + 1 == basis.blocks.size() && basis.fileSize % blockSize != 0) break;
+            lookup.emplace(basis.blocks[i].weak, i);
+        }
+
+        QDataStream stream(&out);
+        stream.writeRawData(kDeltaMagic, kMagicLength);
+        stream << quint32(basis.blockSize) << quint64(basis.fileSize);
+        stream.writeRawData(basis.fileHash.constData(), static_cast<int>(basis.fileHash.size()));
+        stream << quint64(in.size());
+
+        DeltaWriter writer(stream);
+        SignatureBuilder nextSignature(targetSignature, deltaBlockSizeFor(in.size()));
+
+        std::vector<std::uint8_t> buffer(std::max<std::size_t>(kReadSize, 2 * blockSize));
+        std::size_t literalStart = 0;
+        std::size_t start = 0;
+        std::size_t end = 0;
+        bool eof = false;
+        bool rollingValid = false;
+        RollingChecksum checksum;
+
+        while (true) {
+            if (end - start < blockSize && !eof) {
+                writer.literal(buffer.data() + literalStart, start - literalStart);
+                std::memmove(buffer.data(), buffer.data() + start, end - start);
+                end -= start;
+                start = 0;
+                literalStart = 0;
+                rollingValid = false;
+
+                qint64 read = in.read(reinterpret_cast<char *>(buffer.data() + end), static_cast<qint64>(buffer.size() - end));
+                if (read < 0) {
+                    return false;
+                }
+                if (read == 0) {
+                    eof = true;
+                }
+                const auto *fresh = buffer.data() + end;
+                nextSignature.feed(fresh, static_cast<std::size_t>(read));
+                end += static_cast<std::size_t>(read);
+                continue;
+            }
+            if (end - start < blockSize || lookup.empty()) {
+                if (!eof) {
+                    writer.literal(buffer.data() + literalStart, end - literalStart);
+                    start = end;
+                    literalStart = end;
+                    continue;
+                }
+                writer.literal(buffer.data() + literalStart, end - literalStart);
+                break;
+            }
+
+            if (!rollingValid) {
+                checksum.reset(buffer.data() + start, blockSize);
+                rollingValid = true;
+            }
+
+            bool matched = false;
+            auto range = lookup.equal_range(checksum.value());
+            if (range.first != range.second) {
+                QByteArray strong = strongHash(buffer.data() + start, blockSize);
+                for (auto it = range.first; it != range.second; ++it) {
+                    if (basis.blocks[it->second].strong == strong) {
+                        writer.literal(buffer.data() + literalStart, start - literalStart);
+                        writer.copy(it->second);
+                        start += blockSize;
+                        literalStart = start;
+                        rollingValid = false;
+                        matched = true;
+                        break;
+                    }
+                }
+            }
+            if (matched) continue;
+
+            if (start - literalStart >= kMaxLiteral) {
+                writer.literal(buffer.data() + literalStart, start - literalStart);
+                literalStart = start;
+            }
+            if (start + blockSize < end) {
+                checksum.roll(buffer[start], buffer[start + blockSize]);
+            } else {
+                rollingValid = false;
+            }
+            ++start;
+        }
+
+        nextSignature.finish();
+        writer.end(targetSignature.fileHash);
+        return stream.status() == QDataStream::Ok;
+    }
+
+    bool applyDelta(const QString &basisPath, const QString &deltaPath, const QString &outputPath) {
+        QFile basis(basisPath);
+        QFile delta(deltaPath);
+        QFile output(outputPath);
+        if (!basis.open(QIODevice::ReadOnly) || !delta.open(QIODevice::ReadOnly) || !output.open(QIODevice::WriteOnly)) {
+            return false;
+        }
+
+        QDataStream stream(&delta);
+        if (!readMagic(stream, kDeltaMagic)) {
+            return false;
+        }
+        quint32 blockSize;
+        quint64 basisSize;
+        QByteArray basisHash(QCryptographicHash::hashLength(QCryptographicHash::Md5), Qt::Uninitialized);
+        quint64 targetSize;
+        stream >> blockSize >> basisSize;
+        if (stream.readRawData(basisHash.data(), static_cast<int>(basisHash.size())) != basisHash.size()) {
+            return false;
+        }
+        stream >> targetSize;
+        if (stream.status() != QDataStream::Ok || blockSize < kMinBlockSize || blockSize > kMaxBlockSize) {
+            return false;
+        }
+        // the sender only knows what it sent last time, the copy here may
+        // have changed since
+        if (static_cast<quint64>(basis.size()) != basisSize || hashFile(basisPath) != basisHash) {
+            qWarning() << "Delta basis mismatch:" << basisPath;
+            return false;
+        }
+
+        QCryptographicHash outputHash(QCryptographicHash::Md5);
+        static_assert(kMaxLiteral <= BufferPool::kBufferSize && kMaxBlockSize <= BufferPool::kBufferSize);
+        Buffer buffer = BufferPool::instance().acquire();
+        const auto writeOut = [&](qint64 length) {
+            outputHash.addData(QByteArrayView(buffer.data(), length));
+            return output.write(buffer.data(), length) == length;
+        };
+
+        while (true) {
+            quint8 op;
+            stream >> op;
+            if (stream.status() != QDataStream::Ok) {
+                return false;
+            }
+            if (op == OpCopy) {
+                quint32 index;
+                quint32 count;
+                stream >> index >> count;
+                if (!basis.seek(qint64(index) * blockSize)) {
+                    return false;
+                }
+                for (quint32 i = 0; i < count; ++i) {
+                    qint64 read = basis.read(buffer.data(), blockSize);
+                    if (read <= 0 || !writeOut(read)) {
+                        return false;
+                    }
+                }
+            } else if (op == OpLiteral) {
+                quint32 length;
+                stream >> length;
+                if (length > kMaxLiteral || stream.readRawData(buffer.data(), static_cast<int>(length)) != static_cast<int>(length)) {
+                    return false;
+                }
+                if (!writeOut(length)) {
+                    return false;
+                }
+            } else if (op == OpEnd) {
+                QByteArray expected(QCryptographicHash::hashLength(QCryptographicHash::Md5), Qt::Uninitialized);
+                if (stream.readRawData(expected.data(), static_cast<int>(expected.size())) != expected.size()) {
+                    return false;
+                }
+                return static_cast<quint64>(output.size()) == targetSize && outputHash.result() == expected;
+            } else {
+                return false;
+            }
+        }
+    }
+
+    bool applyReceivedDelta(const QString &destDir, const QString &relativePath) {
+        Expects(relativePath.endsWith(kDeltaSuffix));
+
+        QDir dir(destDir);
+        QString deltaPath = dir.filePath(relativePath);
+        QString basisPath = deltaPath.chopped(kDeltaSuffix.size());
+        QString outputPath = basisPath + ".fdpatch";
+
+        bool applied = QFile::exists(basisPath) && applyDelta(basisPath, deltaPath, outputPath);
+        if (applied) {
+            std::error_code error;
+            std::filesystem::rename(
+                    std::filesystem::path(outputPath.toStdU16String()),
+                    std::filesystem::path(basisPath.toStdU16String()),
+                    error);
+            applied = !error;
+        }
+        if (!applied) {
+            qWarning() << "Failed to apply delta:" << deltaPath;
+            QFile::remove(outputPath);
+        }
+        QFile::remove(deltaPath);
+        return applied;
+    }
+
+} // namespace Transfer
@@ -0,0 +1,60 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <cstdint>
+#include <vector>
+
+namespace Transfer {
+
+    // Files carrying a delta are sent under the target name plus this suffix
+    // and patched into place by the receiver.
+    inline const QString kDeltaSuffix = QStringLiteral(".fddelta");
+
+    struct DeltaBlock {
+        std::uint32_t weak = 0;
+        QByteArray strong;
+    };
+
+    struct DeltaSignature {
+        std::uint32_t blockSize = 0;
+        std::uint64_t fileSize = 0;
+        // of the whole file, see hashFile()
+        QByteArray fileHash;
+        std::vector<DeltaBlock> blocks;
+
+        bool save(const QString &path) const;
+
+        bool load(const QString &path);
+    };
+
+    // MD5 of the whole file, empty when it can't be read. A delta names the
+    // hash of its basis and is only applied to a file that has it.
+    [[nodiscard]] QByteArray hashFile(const QString &filePath);
+
+    [[nodiscard]] std::uint32_t deltaBlockSizeFor(std::uint64_t fileSize);
+
+    bool buildDeltaSignature(const QString &filePath, DeltaSignature &signature);
+
+    // Encodes targetPath as copies of basis blocks plus literal data. The
+    // signature of targetPath itself is collected on the way into
+    // targetSignature, so the next delta does not need another pass.
+    bool writeDelta(
+            const QString &targetPath,
+            const DeltaSignature &basis,
+            const QString &deltaPath,
+            DeltaSignature &targetSignature);
+
+    bool applyDelta(const QString &basisPath, const QString &deltaPath, const QString &outputPath);
+
+    // Patches destDir/relativePath (which must end with kDeltaSuffix) into
+    // the file it was made for and removes the delta.
+    bool applyReceivedDelta(const QString &destDir, const QString &relativePath);
+
+} // namespace Transfer
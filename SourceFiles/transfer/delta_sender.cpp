@@ -0,0 +1,125 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/delta_sender.h"
+
+#include "transfer/delta.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QTemporaryFile>
+
+namespace Transfer {
+
+    DeltaSender::DeltaSender(const QString &receiverId, Verify verify) : _verify(std::move(verify)) {
+        QDir cacheRoot(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
+        QString receiverDir = "delta/" + QString::fromLatin1(
+                QCryptographicHash::hash(receiverId.toUtf8(), QCryptographicHash::Md5).toHex());
+        cacheRoot.mkpath(receiverDir);
+        _cacheDir = QDir(cacheRoot.filePath(receiverDir));
+    }
+
+    DeltaSender::~DeltaSender() {
+        discard();
+    }
+
+    QString DeltaSender::signaturePathFor(const QString &relativePath) const {
+        QByteArray key = QCryptographicHash::hash(relativePath.toUtf8(), QCryptographicHash::Md5).toHex();
+        return _cacheDir.filePath(QString::fromLatin1(key) + ".sig");
+    }
+
+    void DeltaSender::prepare(QString &filePath, QString &relativePath) {
+        QFileInfo info(filePath);
+        if (info.size() < kMinFileSize) {
+            return;
+        }
+
+        Pending pending;
+        pending.signaturePath = signaturePathFor(relativePath);
+        pending.nextSignaturePath = pending.signaturePath + ".next";
+        pending.sourcePath = filePath;
+        pending.relativePath = relativePath;
+        QFile::remove(pending.nextSignaturePath);
+
+        // first send, or the receiver's copy changed since the last one:
+        // the signature is taken after the file got through
+        DeltaSignature basis;
+        if (!basis.load(pending.signaturePath) || !_verify(relativePath, basis.fileHash)) {
+            _pending.push_back(pending);
+            return;
+        }
+
+        QTemporaryFile deltaFile(QDir::temp().filePath("flowdrop-XXXXXX" + kDeltaSuffix));
+        deltaFile.setAutoRemove(false);
+        if (!deltaFile.open()) {
+            return;
+        }
+        pending.deltaPath = deltaFile.fileName();
+        deltaFile.close();
+
+        DeltaSignature next;
+        bool written = writeDelta(filePath, basis, pending.deltaPath, next) && next.save(pending.nextSignaturePath);
+        // not worth it when most of the file changed anyway
+        if (!written || QFileInfo(pending.deltaPath).size() > info.size() / 10 * 9) {
+            QFile::remove(pending.deltaPath);
+            pending.deltaPath.clear();
+            if (written) {
+                _pending.push_back(pending);
+            } else {
+                QFile::remove(pending.nextSignaturePath);
+            }
+            return;
+        }
+
+        qInfo() << "Sending delta for" << relativePath << QFileInfo(pending.deltaPath).size() << "of" << info.size();
+        pending.targetHash = next.fileHash;
+        filePath = pending.deltaPath;
+        relativePath += kDeltaSuffix;
+        _pending.push_back(pending);
+    }
+
+    std::vector<std::pair<QString, QString>> DeltaSender::commit() {
+        std::vector<std::pair<QString, QString>> resend;
+        std::vector<Pending> failed;
+        for (auto &pending : _pending) {
+            if (!pending.deltaPath.isEmpty()) {
+                QFile::remove(pending.deltaPath);
+                pending.deltaPath.clear();
+                if (!_verify(pending.relativePath, pending.targetHash)) {
+                    qWarning() << "Delta for" << pending.relativePath << "was not applied, sending it in full";
+                    resend.emplace_back(pending.sourcePath, pending.relativePath);
+                    failed.push_back(pending);
+                    continue;
+                }
+            }
+            if (!QFile::exists(pending.nextSignaturePath)) {
+                DeltaSignature signature;
+                if (!buildDeltaSignature(pending.sourcePath, signature) || !signature.save(pending.nextSignaturePath)) {
+                    continue;
+                }
+            }
+            QFile::remove(pending.signaturePath);
+            QFile::rename(pending.nextSignaturePath, pending.signaturePath);
+        }
+        // their next signature is good once the full file got through
+        _pending = std::move(failed);
+        return resend;
+    }
+
+    void DeltaSender::discard() {
+        for (const auto &pending : _pending) {
+            if (!pending.deltaPath.isEmpty()) {
+                QFile::remove(pending.deltaPath);
+            }
+            QFile::remove(pending.nextSignaturePath);
+        }
+        _pending.clear();
+    }
+
+} // namespace Transfer
@@ -0,0 +1,63 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include "base_util.h"
+
+#include <QByteArray>
+#include <QDir>
+#include <QString>
+#include <utility>
+#include <vector>
+
+namespace Transfer {
+
+    // Remembers the block signature of every large file sent to a receiver
+    // and, on the next send of the same relative path, replaces the file by
+    // a delta against that copy. The receiver is asked first whether its
+    // copy is still the one sent, and afterwards whether the delta made
+    // the new one.
+    class DeltaSender {
+    public:
+        static constexpr qint64 kMinFileSize = 1024 * 1024;
+
+        // Whether the receiver's file at relativePath has the hash, see
+        // hashFile().
+        using Verify = Fn<bool(const QString &relativePath, const QByteArray &hash)>;
+
+        DeltaSender(const QString &receiverId, Verify verify);
+        ~DeltaSender();
+
+        // Rewrites filePath/relativePath to point to a delta when possible.
+        void prepare(QString &filePath, QString &relativePath);
+
+        // Call once the prepared files were sent. Returns the files whose
+        // delta the receiver couldn't apply as (file path, relative path),
+        // they have to be sent again in full and are committed by the
+        // next call.
+        std::vector<std::pair<QString, QString>> commit();
+
+        void discard();
+
+    private:
+        struct Pending {
+            QString signaturePath;
+            QString nextSignaturePath;
+            QString sourcePath;
+            QString relativePath;
+            QString deltaPath;
+            QByteArray targetHash;
+        };
+
+        [[nodiscard]] QString signaturePathFor(const QString &relativePath) const;
+
+        const Verify _verify;
+        QDir _cacheDir;
+        std::vector<Pending> _pending;
+    }; // DeltaSender
+
+} // namespace Transfer
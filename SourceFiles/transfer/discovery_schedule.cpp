@@ -0,0 +1,28 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/discovery_schedule.h"
+
+#include <algorithm>
+
+namespace Transfer {
+
+    DiscoverySchedule::DiscoverySchedule(const Options &options) : _options(options) {
+    }
+
+    DiscoverySchedule::Round DiscoverySchedule::next() {
+        if (!_burstDone) {
+            _burstDone = true;
+            _pauseMs = _options.firstPauseMs;
+            return {0, _options.burstMs};
+        }
+        Round round{_pauseMs, _options.roundMs};
+        _pauseMs = std::min(_pauseMs * 2, _options.heartbeatMs);
+        return round;
+    }
+
+} // namespace Transfer
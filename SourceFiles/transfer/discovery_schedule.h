@@ -0,0 +1,43 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+namespace Transfer {
+
+    // When to run flowdrop's discovery: one long round when the list is
+    // opened, then short rounds with pauses that double up to a slow
+    // heartbeat. Devices mostly show up in the first seconds, later rounds
+    // only catch the ones that come online, so a list left open doesn't
+    // keep the network busy.
+    class DiscoverySchedule {
+    public:
+        struct Options {
+            int burstMs = 10 * 1000;
+            int roundMs = 2 * 1000;
+            int firstPauseMs = 2 * 1000;
+            int heartbeatMs = 60 * 1000;
+        };
+
+        struct Round {
+            int pauseMs = 0;
+            int activeMs = 0;
+        };
+
+        DiscoverySchedule() : DiscoverySchedule(Options()) {
+        }
+
+        explicit DiscoverySchedule(const Options &options);
+
+        [[nodiscard]] Round next();
+
+    private:
+        const Options _options;
+        int _pauseMs = 0;
+        bool _burstDone = false;
+    }; // DiscoverySchedule
+
+} // namespace Transfer
@@ -0,0 +1,165 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/hot_folder.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+
+namespace Transfer {
+
+    namespace {
+
+        // a folder that never goes quiet is still sent this often
+        constexpr qint64 kMaxBatchDelayMs = 30 * 1000;
+        constexpr int kMaxBatchEntries = 10000;
+        constexpr qint64 kRetryDelayMs = 60 * 1000;
+
+    } // namespace
+
+    HotFolder::HotFolder(Options options, Send send)
+            : _options(std::move(options)),
+              _send(std::move(send)) {
+        _options.folder = QDir::cleanPath(_options.folder);
+        if (!_options.archive.isEmpty()) {
+            _archivePath = QDir(_options.folder).filePath(_options.archive);
+        }
+        _clock.start();
+        _timer.setInterval(std::max(_options.quietMs / 2, 100));
+        QObject::connect(&_timer, &QTimer::timeout, [this]() {
+            flush();
+        });
+
+        QDir().mkpath(_options.folder);
+        _watcher = std::make_unique<Platform::FolderWatcher>(_options.folder, [this](auto change, const QString &path) {
+            changed(change, path);
+        });
+        // whatever was dropped while we were not running
+        scan();
+    }
+
+    bool HotFolder::isValid() const {
+        return _watcher->isValid();
+    }
+
+    QString HotFolder::entryOf(const QString &path) const {
+        QString relative = QDir(_options.folder).relativeFilePath(path);
+        if (relative.isEmpty() || relative == "." || relative.startsWith("..")) {
+            return {};
+        }
+        QString name = relative.section('/', 0, 0);
+        if (name.startsWith('.') || name == _options.archive) {
+            return {};
+        }
+        return QDir(_options.folder).filePath(name);
+    }
+
+    void HotFolder::scan() {
+        const auto names = QDir(_options.folder).entryList(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot);
+        for (const QString &name : names) {
+            changed(Platform::FolderWatcher::Change::Written, QDir(_options.folder).filePath(name));
+        }
+    }
+
+    void HotFolder::changed(Platform::FolderWatcher::Change change, const QString &path) {
+        if (change == Platform::FolderWatcher::Change::Rescan) {
+            scan();
+            return;
+        }
+        QString entry = entryOf(path);
+        if (entry.isEmpty()) {
+            return;
+        }
+        if (change == Platform::FolderWatcher::Change::Removed && entry == path) {
+            _pending.remove(entry);
+            return;
+        }
+        qint64 now = _clock.elapsed();
+        _pending[entry] = now;
+        _lastEvent = now;
+        if (_batchStart < 0) {
+            _batchStart = now;
+        }
+        if (!_timer.isActive()) {
+            _timer.start();
+        }
+    }
+
+    void HotFolder::flush() {
+        qint64 now = _clock.elapsed();
+        // let a burst finish, so it goes out as one batch
+        if (now - _lastEvent < _options.quietMs && now - _batchStart < kMaxBatchDelayMs) {
+            return;
+        }
+
+        QStringList ready;
+        for (auto it = _pending.begin(); it != _pending.end();) {
+            if (now - it.value() < _options.quietMs || _inFlight.contains(it.key())) {
+                ++it;
+                continue;
+            }
+            if (QFileInfo::exists(it.key())) {
+                ready.push_back(it.key());
+            }
+            it = _pending.erase(it);
+        }
+        _batchStart = _pending.isEmpty() ? -1 : now;
+        if (_pending.isEmpty()) {
+            _timer.stop();
+        }
+
+        for (qsizetype i = 0; i < ready.size(); i += kMaxBatchEntries) {
+            QStringList batch = ready.mid(i, kMaxBatchEntries);
+            for (const QString &entry : batch) {
+                _inFlight.insert(entry);
+            }
+            qInfo() << "Hot folder: sending" << batch.size() << "entries to" << _options.receiverId;
+            _send(batch, [this, batch](bool ok) {
+                QMetaObject::invokeMethod(QCoreApplication::instance(), [this, batch, ok]() {
+                    sent(batch, ok);
+                }, Qt::QueuedConnection);
+            });
+        }
+    }
+
+    void HotFolder::sent(const QStringList &entries, bool ok) {
+        for (const QString &entry : entries) {
+            _inFlight.remove(entry);
+        }
+        if (!ok) {
+            qWarning() << "Hot folder: send failed, retrying later";
+            qint64 retryAt = _clock.elapsed() + kRetryDelayMs - _options.quietMs;
+            for (const QString &entry : entries) {
+                _pending.insert(entry, retryAt);
+            }
+            if (_batchStart < 0) {
+                _batchStart = _clock.elapsed();
+            }
+            _timer.start();
+            return;
+        }
+        if (_archivePath.isEmpty()) {
+            return;
+        }
+        QDir archive(_archivePath);
+        archive.mkpath(".");
+        for (const QString &entry : entries) {
+            QString name = QFileInfo(entry).fileName();
+            QString target = archive.filePath(name);
+            if (QFileInfo::exists(target)) {
+                target = archive.filePath(QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss-zzz-") + name);
+            }
+            if (!QDir().rename(entry, target)) {
+                qWarning() << "Hot folder: cannot archive" << entry;
+            }
+        }
+    }
+
+} // namespace Transfer
@@ -0,0 +1,66 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include "base_util.h"
+#include "platform/platform_watcher.h"
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <memory>
+
+namespace Transfer {
+
+    // Sends whatever lands in a folder to one receiver. An entry is sent
+    // once it has been quiet for a while, entries that become quiet
+    // together go out as one send, so a burst of files costs a few
+    // transfers. Sent entries can be moved to an archive subfolder.
+    class HotFolder {
+    public:
+        struct Options {
+            QString folder;
+            QString receiverId;
+            int quietMs = 2000;
+            QString archive; // subfolder name, empty to leave files in place
+        };
+
+        // Has to call done with the result once the paths were sent.
+        using Send = Fn<void(const QStringList &paths, Fn<void(bool)> done)>;
+
+        HotFolder(Options options, Send send);
+
+        [[nodiscard]] bool isValid() const;
+
+    private:
+        void changed(Platform::FolderWatcher::Change change, const QString &path);
+
+        void scan();
+
+        void flush();
+
+        void sent(const QStringList &entries, bool ok);
+
+        // the entry right below the folder that path belongs to
+        [[nodiscard]] QString entryOf(const QString &path) const;
+
+        Options _options;
+        Send _send;
+        QString _archivePath;
+        std::unique_ptr<Platform::FolderWatcher> _watcher;
+        QTimer _timer;
+        QElapsedTimer _clock;
+        QHash<QString, qint64> _pending; // entry -> time of its last event
+        QSet<QString> _inFlight;
+        qint64 _lastEvent = 0;
+        qint64 _batchStart = -1;
+    }; // HotFolder
+
+} // namespace Transfer
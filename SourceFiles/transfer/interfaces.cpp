@@ -0,0 +1,101 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/interfaces.h"
+
+#include <algorithm>
+
+namespace Transfer {
+
+    int interfaceRank(QNetworkInterface::InterfaceType type) {
+        switch (type) {
+            case QNetworkInterface::Ethernet:
+                return 0;
+            case QNetworkInterface::Wifi:
+                return 1;
+            default:
+                return 2;
+        }
+    }
+
+    qint64 typicalRate(QNetworkInterface::InterfaceType type) {
+        switch (type) {
+            case QNetworkInterface::Ethernet:
+                return 1000 * 1000 * 1000 / 8;
+            case QNetworkInterface::Wifi:
+                return 30 * 1000 * 1000;
+            default:
+                return 5 * 1000 * 1000;
+        }
+    }
+
+    std::vector<LocalInterface> localInterfaces() {
+        std::vector<LocalInterface> result;
+        for (const QNetworkInterface &iface : QNetworkInterface::allInterfaces()) {
+            auto flags = iface.flags();
+            if (!flags.testFlag(QNetworkInterface::IsUp) || !flags.testFlag(QNetworkInterface::IsRunning)
+                || !flags.testFlag(QNetworkInterface::CanMulticast) || flags.testFlag(QNetworkInterface::IsLoopBack)) {
+                continue;
+            }
+            for (const QNetworkAddressEntry &entry : iface.addressEntries()) {
+                if (entry.ip().protocol() != QAbstractSocket::IPv4Protocol) {
+                    continue;
+                }
+                result.push_back({
+                    iface.name(),
+                    iface.humanReadableName(),
+                    iface.type(),
+                    iface.index(),
+                    entry.ip(),
+                    entry.prefixLength(),
+                    interfaceRank(iface.type())
+                });
+                break;
+            }
+        }
+        std::stable_sort(result.begin(), result.end(), [](const LocalInterface &left, const LocalInterface &right) {
+            return left.rank < right.rank;
+        });
+        return result;
+    }
+
+    std::optional<LocalInterface> interfaceFor(
+            const QHostAddress &address,
+            int index,
+            const std::vector<LocalInterface> &interfaces) {
+        if (index > 0) {
+            for (const auto &iface : interfaces) {
+                if (iface.index == index) {
+                    return iface;
+                }
+            }
+        }
+        for (const auto &iface : interfaces) {
+            if (address.isInSubnet(iface.address, iface.prefixLength)) {
+                return iface;
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::optional<LocalInterface> findInterface(const QString &name) {
+        for (auto &iface : localInterfaces()) {
+            if (iface.name == name) {
+                return iface;
+            }
+        }
+        return std::nullopt;
+    }
+
+    QString formatInterface(const LocalInterface &iface) {
+        QString name = iface.humanName == iface.name
+                ? iface.name
+                : iface.humanName + " (" + iface.name + ")";
+        return name + ", " + iface.address.toString() + "/" + QString::number(iface.prefixLength);
+    }
+
+} // namespace Transfer
@@ -0,0 +1,51 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include <QHostAddress>
+#include <QNetworkInterface>
+#include <QString>
+#include <optional>
+#include <vector>
+
+namespace Transfer {
+
+    struct LocalInterface {
+        // as the system knows it, e.g. eth0 or en0
+        QString name;
+        QString humanName;
+        QNetworkInterface::InterfaceType type = QNetworkInterface::Unknown;
+        int index = 0;
+        QHostAddress address;
+        int prefixLength = 0;
+        // lower is expected to be faster, see interfaceRank()
+        int rank = 0;
+    };
+
+    // Wired before wireless before everything else (tunnels, VPNs, phones).
+    [[nodiscard]] int interfaceRank(QNetworkInterface::InterfaceType type);
+
+    // Bytes per second a link of the type usually carries, paths to a
+    // peer are ranked by it until a probe measured them.
+    [[nodiscard]] qint64 typicalRate(QNetworkInterface::InterfaceType type);
+
+    // The IPv4 interfaces that are up and can do multicast, loopback left
+    // out, best rank first.
+    [[nodiscard]] std::vector<LocalInterface> localInterfaces();
+
+    // Where a datagram from address came in: by index when the platform
+    // reports it, else the interface whose subnet holds the address.
+    [[nodiscard]] std::optional<LocalInterface> interfaceFor(
+            const QHostAddress &address,
+            int index,
+            const std::vector<LocalInterface> &interfaces);
+
+    [[nodiscard]] std::optional<LocalInterface> findInterface(const QString &name);
+
+    [[nodiscard]] QString formatInterface(const LocalInterface &iface);
+
+} // namespace Transfer
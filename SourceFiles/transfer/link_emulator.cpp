@@ -0,0 +1,165 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/link_emulator.h"
+
+#include <algorithm>
+#include <map>
+
+namespace Transfer {
+
+    namespace {
+
+        using namespace std::chrono_literals;
+
+        // what a typical access point or switch port buffers
+        constexpr auto kQueueTime = 50ms;
+        // UDP payload of a 1500 byte Ethernet frame; bigger datagrams are
+        // fragmented and lost with any of their fragments
+        constexpr qint64 kFramePayload = 1472;
+
+    } // namespace
+
+    const std::vector<LinkProfile> &LinkProfile::presets() {
+        static const std::vector<LinkProfile> profiles = {
+                {"ideal", 0us, 0us, 0, 0},
+                {"lan100", 300us, 100us, 100 * 1000 * 1000 / 8, 0.0001},
+                {"wifi24", 3ms, 4ms, 30 * 1000 * 1000 / 8, 0.01},
+                {"hotspot", 40ms, 25ms, 10 * 1000 * 1000 / 8, 0.03},
+        };
+        return profiles;
+    }
+
+    std::optional<LinkProfile> LinkProfile::find(const QString &name) {
+        for (const auto &profile : presets()) {
+            if (profile.name == name) {
+                return profile;
+            }
+        }
+        return std::nullopt;
+    }
+
+    class EmulatedNetwork::Channel final : public DatagramChannel {
+    public:
+        Channel(EmulatedNetwork &network, quint16 port, bool member)
+                : _network(network),
+                  _port(port),
+                  _member(member) {
+        }
+
+        ~Channel() override {
+            _network.remove(this);
+        }
+
+        using DatagramChannel::send;
+
+        void send(const QByteArray &data, const QHostAddress &address, quint16 port) override {
+            _network.route(*this, data, address, port);
+        }
+
+        bool wait(int timeoutMs) override {
+            std::unique_lock<std::mutex> lock(_network._mutex);
+            auto deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+            while (true) {
+                auto now = Clock::now();
+                if (!_inbound.empty() && _inbound.begin()->first <= now) {
+                    return true;
+                }
+                if (now >= deadline) {
+                    return false;
+                }
+                auto next = _inbound.empty() ? deadline : std::min(deadline, _inbound.begin()->first);
+                _arrived.wait_until(lock, next);
+            }
+        }
+
+        std::optional<Datagram> receive() override {
+            std::lock_guard<std::mutex> lock(_network._mutex);
+            if (_inbound.empty() || _inbound.begin()->first > Clock::now()) {
+                return std::nullopt;
+            }
+            Datagram datagram = std::move(_inbound.begin()->second);
+            _inbound.erase(_inbound.begin());
+            return datagram;
+        }
+
+    private:
+        friend class EmulatedNetwork;
+
+        EmulatedNetwork &_network;
+        const quint16 _port;
+        const bool _member;
+        // the rest is guarded by the network's mutex
+        Clock::time_point _busyUntil;
+        std::multimap<Clock::time_point, Datagram> _inbound;
+        std::condition_variable _arrived;
+    }; // EmulatedNetwork::Channel
+
+    EmulatedNetwork::EmulatedNetwork(LinkProfile profile, quint32 seed)
+            : _profile(std::move(profile)),
+              _random(seed) {
+    }
+
+    EmulatedNetwork::~EmulatedNetwork() = default;
+
+    std::unique_ptr<DatagramChannel> EmulatedNetwork::open(bool member) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto channel = std::make_unique<Channel>(*this, _nextPort++, member);
+        _channels.push_back(channel.get());
+        return channel;
+    }
+
+    LinkStats EmulatedNetwork::stats() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _stats;
+    }
+
+    void EmulatedNetwork::route(Channel &from, const QByteArray &data, const QHostAddress &address, quint16 port) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_stats.sent;
+        auto now = Clock::now();
+        auto departure = now;
+        if (_profile.bandwidth > 0) {
+            auto start = std::max(now, from._busyUntil);
+            if (start - now > kQueueTime) {
+                ++_stats.dropped;
+                return;
+            }
+            auto transmit = std::chrono::nanoseconds(data.size() * 1000000000LL / _profile.bandwidth);
+            from._busyUntil = start + transmit;
+            departure = from._busyUntil;
+        }
+
+        std::uniform_real_distribution<double> chance(0, 1);
+        std::uniform_int_distribution<qint64> jitter(-_profile.jitter.count(), _profile.jitter.count());
+        bool multicast = address.isMulticast();
+        auto frames = std::max<qint64>((data.size() + kFramePayload - 1) / kFramePayload, 1);
+        for (Channel *to : _channels) {
+            if (multicast ? !to->_member : to->_port != port) {
+                continue;
+            }
+            bool lost = false;
+            for (qint64 i = 0; i < frames; ++i) {
+                lost = chance(_random) < _profile.loss || lost;
+            }
+            if (lost) {
+                ++_stats.lost;
+                continue;
+            }
+            auto delay = std::max(_profile.latency + std::chrono::microseconds(jitter(_random)), 0us);
+            to->_inbound.emplace(departure + delay, Datagram{data, QHostAddress::LocalHost, from._port});
+            to->_arrived.notify_all();
+            ++_stats.delivered;
+        }
+    }
+
+    void EmulatedNetwork::remove(Channel *channel) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _channels.erase(std::remove(_channels.begin(), _channels.end(), channel), _channels.end());
+    }
+
+} // namespace Transfer
@@ -0,0 +1,74 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include "transfer/datagram_channel.h"
+
+#include <QString>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <vector>
+
+namespace Transfer {
+
+    struct LinkProfile {
+        QString name;
+        std::chrono::microseconds latency{0};
+        std::chrono::microseconds jitter{0};
+        // bytes per second, 0 means unlimited
+        qint64 bandwidth = 0;
+        double loss = 0;
+
+        static const std::vector<LinkProfile> &presets();
+        static std::optional<LinkProfile> find(const QString &name);
+    };
+
+    struct LinkStats {
+        qint64 sent = 0;
+        qint64 delivered = 0;
+        qint64 lost = 0;
+        // didn't fit the sender's queue
+        qint64 dropped = 0;
+    };
+
+    // An in-process network for the datagram transports, so they can be
+    // measured on a reproducible link. Every channel sends through its
+    // own link with the profile's bandwidth and a short tail-drop queue,
+    // each delivery then gets the latency, jitter and loss. Loss applies
+    // per Ethernet frame, a datagram that needs several is lost with any
+    // of them, like a fragmented one on a real link. Multicast
+    // addresses reach every member, including the sender when it is one.
+    // Loss and jitter come from a seeded generator.
+    class EmulatedNetwork {
+    public:
+        explicit EmulatedNetwork(LinkProfile profile, quint32 seed = 1);
+        ~EmulatedNetwork();
+
+        // Members get what is sent to multicast addresses.
+        std::unique_ptr<DatagramChannel> open(bool member);
+
+        [[nodiscard]] LinkStats stats() const;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        class Channel;
+
+        void route(Channel &from, const QByteArray &data, const QHostAddress &address, quint16 port);
+        void remove(Channel *channel);
+
+        const LinkProfile _profile;
+        mutable std::mutex _mutex;
+        std::mt19937 _random;
+        std::vector<Channel *> _channels;
+        quint16 _nextPort = 40000;
+        LinkStats _stats;
+    }; // EmulatedNetwork
+
+} // namespace Transfer
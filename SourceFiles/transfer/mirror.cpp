@@ -0,0 +1,382 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/mirror.h"
+
+#include "transfer/mirror_index.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QtEndian>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace Transfer {
+
+    namespace {
+
+        constexpr char kRemovalMagic[] = "FDREMOV1";
+        constexpr int kMagicLength = 8;
+
+        constexpr int kQuietMs = 1000;
+        constexpr qint64 kMaxDelayMs = 10 * 1000;
+        constexpr qsizetype kBatchSize = 1000;
+        // batches queued but not sent yet, holds the scan back so a big
+        // folder doesn't end up in memory as queued sends
+        constexpr int kMaxOutstanding = 2;
+        // past this many pending events a full scan is cheaper
+        constexpr qsizetype kMaxChangedPaths = 50000;
+        constexpr int kRetryDelayMs = 60 * 1000;
+
+        quint64 contentHash(const QString &filePath) {
+            QFile file(filePath);
+            if (!file.open(QIODevice::ReadOnly)) {
+                return 0;
+            }
+            QCryptographicHash hash(QCryptographicHash::Sha256);
+            if (!hash.addData(&file)) {
+                return 0;
+            }
+            return std::max<quint64>(qFromLittleEndian<quint64>(hash.result().constData()), 1);
+        }
+
+    } // namespace
+
+    bool applyReceivedRemoval(const QString &destDir, const QString &relativePath) {
+        QDir dir(destDir);
+        QString markerPath = dir.filePath(relativePath);
+        QFile marker(markerPath);
+        char magic[kMagicLength];
+        bool valid = marker.open(QIODevice::ReadOnly)
+                && marker.read(magic, kMagicLength) == kMagicLength
+                && std::memcmp(magic, kRemovalMagic, kMagicLength) == 0;
+        marker.close();
+        QFile::remove(markerPath);
+        if (!valid) {
+            return false;
+        }
+
+        QString root = QDir::cleanPath(dir.absolutePath());
+        QString target = QDir::cleanPath(markerPath.chopped(kRemovalSuffix.size()));
+        if (!target.startsWith(root + '/') || !QFileInfo(target).isFile()) {
+            return false;
+        }
+        if (!QFile::remove(target)) {
+            return false;
+        }
+        for (QString parent = QFileInfo(target).path(); parent != root && parent.startsWith(root + '/');
+             parent = QFileInfo(parent).path()) {
+            if (!QDir().rmdir(parent)) {
+                break; // not empty
+            }
+        }
+        qInfo() << "Mirror removed" << target;
+        return true;
+    }
+
+    struct Mirror::Worker : std::enable_shared_from_this<Mirror::Worker> {
+        struct Pending {
+            QString relativePath;
+            MirrorIndex::State state;
+        };
+
+        Options options;
+        Send send;
+        MirrorIndex index;
+        QString baseDir;
+        QString removalDir;
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::deque<Fn<void()>> tasks;
+        int outstanding = 0;
+        bool stopped = false;
+        std::thread thread;
+
+        std::vector<Pending> files;
+        std::vector<Pending> removals;
+
+        Worker(Options options, Send send)
+                : options(std::move(options)),
+                  send(std::move(send)),
+                  index(QDir(this->options.stateDir).filePath("mirror_index.dat")) {
+            QDir folder(this->options.folder);
+            folder.cdUp();
+            baseDir = folder.path();
+            removalDir = QDir(this->options.stateDir).filePath("removals");
+        }
+
+        void post(Fn<void()> task) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopped) return;
+            tasks.push_back(std::move(task));
+            wake.notify_all();
+        }
+
+        void run() {
+            while (true) {
+                Fn<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wake.wait(lock, [&]() { return stopped || !tasks.empty(); });
+                    if (stopped) return;
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                }
+                task();
+            }
+        }
+
+        [[nodiscard]] bool isStopped() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return stopped;
+        }
+
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopped = true;
+                wake.notify_all();
+            }
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+
+        [[nodiscard]] QString relativeOf(const QString &path) const {
+            return QDir(options.folder).relativeFilePath(path);
+        }
+
+        // Queues filePath when the receiver does not have this version.
+        void check(const QString &filePath, const QFileInfo &info, bool scanning) {
+            QString relativePath = relativeOf(filePath);
+            MirrorIndex::State state{info.size(), info.lastModified().toMSecsSinceEpoch(), 0};
+            auto known = index.find(relativePath);
+            if (known && scanning) {
+                index.keep(relativePath, *known);
+            }
+            if (known && known->size == state.size && known->modified == state.modified) {
+                return;
+            }
+            if (known && known->size == state.size) {
+                // touched, or rewritten with the same size
+                state.hash = contentHash(filePath);
+                if (known->hash != 0 && known->hash == state.hash) {
+                    index.set(relativePath, state);
+                    return;
+                }
+            }
+            files.push_back({relativePath, state});
+            if (qsizetype(files.size()) >= kBatchSize) {
+                sendFiles();
+            }
+        }
+
+        void removed(const QString &relativePath) {
+            removals.push_back({relativePath, {}});
+            if (qsizetype(removals.size()) >= kBatchSize) {
+                sendRemovals();
+            }
+        }
+
+        void checkTree(const QString &root, bool scanning) {
+            QDirIterator it(root, QDir::Files | QDir::Hidden | QDir::NoSymLinks, QDirIterator::Subdirectories);
+            while (it.hasNext() && !isStopped()) {
+                QString filePath = it.next();
+                check(filePath, it.fileInfo(), scanning);
+            }
+        }
+
+        void fullScan() {
+            QElapsedTimer timer;
+            timer.start();
+            index.beginScan();
+            checkTree(options.folder, true);
+            index.finishScan([this](const QString &relativePath) {
+                removed(relativePath);
+            });
+            flushBatches();
+            qInfo() << "Mirror scan of" << options.folder << "took" << timer.elapsed() << "ms," << index.size() << "files indexed";
+        }
+
+        void sync(const QStringList &paths) {
+            for (const QString &path : paths) {
+                QFileInfo info(path);
+                if (info.isFile()) {
+                    check(path, info, false);
+                } else if (info.isDir()) {
+                    checkTree(path, false);
+                } else {
+                    QString relativePath = relativeOf(path);
+                    if (index.find(relativePath)) {
+                        removed(relativePath);
+                    } else {
+                        index.forEachUnder(relativePath + '/', [this](const QString &child) {
+                            removed(child);
+                        });
+                    }
+                }
+            }
+            flushBatches();
+        }
+
+        void flushBatches() {
+            sendFiles();
+            sendRemovals();
+        }
+
+        void sendFiles() {
+            if (files.empty()) return;
+            QStringList paths;
+            qint64 size = 0;
+            for (const auto &file : files) {
+                paths.push_back(QDir(options.folder).filePath(file.relativePath));
+                size += file.state.size;
+            }
+            submit(std::move(paths), size, baseDir, std::exchange(files, {}), false);
+        }
+
+        void sendRemovals() {
+            if (removals.empty()) return;
+            // markers are files under the same relative path, so they go
+            // through the regular send path
+            QStringList paths;
+            std::vector<Pending> batch;
+            for (auto &removal : std::exchange(removals, {})) {
+                QString markerPath = QDir(removalDir).filePath(QFileInfo(options.folder).fileName() + '/' + removal.relativePath + kRemovalSuffix);
+                QDir().mkpath(QFileInfo(markerPath).path());
+                QFile marker(markerPath);
+                if (!marker.open(QIODevice::WriteOnly | QIODevice::Truncate) || marker.write(kRemovalMagic, kMagicLength) != kMagicLength) {
+                    continue;
+                }
+                paths.push_back(markerPath);
+                batch.push_back(std::move(removal));
+            }
+            if (!batch.empty()) {
+                submit(std::move(paths), 0, removalDir, std::move(batch), true);
+            }
+        }
+
+        void submit(QStringList paths, qint64 size, const QString &base, std::vector<Pending> batch, bool removal);
+    };
+
+    void Mirror::Worker::submit(QStringList paths, qint64 size, const QString &base, std::vector<Pending> batch, bool removal) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return stopped || outstanding < kMaxOutstanding; });
+            if (stopped) return;
+            ++outstanding;
+        }
+        SendJob job;
+        job.receiverId = options.receiverId;
+        job.files = paths;
+        job.priority = Priority::Background;
+        job.size = std::max<qint64>(size, 1);
+        job.fileCount = std::size_t(paths.size());
+        job.baseDir = base;
+        // the worker may be gone when a send finishes on quit
+        job.done = [worker = weak_from_this(), paths, batch = std::move(batch), removal](bool ok) {
+            auto self = worker.lock();
+            if (!self) return;
+            for (std::size_t i = 0; i < batch.size(); ++i) {
+                if (removal) {
+                    QFile::remove(paths.value(qsizetype(i)));
+                    if (ok) self->index.remove(batch[i].relativePath);
+                } else if (ok) {
+                    self->index.set(batch[i].relativePath, batch[i].state);
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(self->mutex);
+                --self->outstanding;
+                self->wake.notify_all();
+            }
+            if (!ok) {
+                qWarning() << "Mirror send failed, rescanning later";
+                QMetaObject::invokeMethod(QCoreApplication::instance(), [worker]() {
+                    QTimer::singleShot(kRetryDelayMs, QCoreApplication::instance(), [worker]() {
+                        if (auto self = worker.lock()) {
+                            self->post([self = self.get()]() { self->fullScan(); });
+                        }
+                    });
+                }, Qt::QueuedConnection);
+            }
+        };
+        send(std::move(job));
+    }
+
+    Mirror::Mirror(Options options, Send send) : _options(std::move(options)) {
+        _options.folder = QDir::cleanPath(_options.folder);
+        QDir().mkpath(_options.stateDir);
+        _worker = std::make_shared<Worker>(_options, std::move(send));
+        _worker->index.load();
+        _worker->thread = std::thread([worker = _worker.get()]() {
+            worker->run();
+        });
+        _worker->post([worker = _worker.get()]() {
+            worker->fullScan();
+        });
+
+        _timer.setSingleShot(true);
+        _timer.setInterval(kQuietMs);
+        QObject::connect(&_timer, &QTimer::timeout, [this]() {
+            flush();
+        });
+        _watcher = std::make_unique<Platform::FolderWatcher>(_options.folder, [this](auto change, const QString &path) {
+            changed(change, path);
+        });
+    }
+
+    Mirror::~Mirror() {
+        _watcher.reset();
+        _worker->stop();
+    }
+
+    bool Mirror::isValid() const {
+        return _watcher->isValid();
+    }
+
+    void Mirror::changed(Platform::FolderWatcher::Change change, const QString &path) {
+        if (change == Platform::FolderWatcher::Change::Rescan || _changed.size() >= kMaxChangedPaths) {
+            _rescan = true;
+            _changed.clear();
+        } else if (!_rescan) {
+            _changed.insert(path);
+        }
+        // wait for a quiet moment, but not forever
+        if (!_timer.isActive()) {
+            _pending.start();
+            _timer.start();
+        } else if (_pending.elapsed() < kMaxDelayMs) {
+            _timer.start();
+        }
+    }
+
+    void Mirror::flush() {
+        if (_rescan) {
+            _rescan = false;
+            _worker->post([worker = _worker.get()]() {
+                worker->fullScan();
+            });
+            return;
+        }
+        QStringList paths(_changed.begin(), _changed.end());
+        _changed.clear();
+        _worker->post([worker = _worker.get(), paths]() {
+            worker->sync(paths);
+        });
+    }
+
+} // namespace Transfer
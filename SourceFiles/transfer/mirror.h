@@ -0,0 +1,65 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include "base_util.h"
+#include "platform/platform_watcher.h"
+#include "transfer/send_queue.h"
+
+#include <QElapsedTimer>
+#include <QSet>
+#include <QString>
+#include <QTimer>
+#include <memory>
+
+namespace Transfer {
+
+    // Tells a mirror receiver that <relative path> was removed.
+    inline const QString kRemovalSuffix = QStringLiteral(".fdremove");
+
+    // Removes the file a received removal marker points at, along with
+    // folders left empty by it. Only for markers from the device set as
+    // the mirror source, see Setting::MirrorSource.
+    bool applyReceivedRemoval(const QString &destDir, const QString &relativePath);
+
+    // Keeps a folder on a receiver in sync with a local folder, one way. A
+    // full scan on start sends what changed while we were not running, after
+    // that the folder watcher drives incremental syncs. What the receiver has
+    // is kept in a MirrorIndex, so restarts only send the difference.
+    class Mirror {
+    public:
+        struct Options {
+            QString folder;
+            QString receiverId;
+            QString stateDir; // index and removal markers
+        };
+
+        // Has to call job.done once the job is over.
+        using Send = Fn<void(SendJob job)>;
+
+        Mirror(Options options, Send send);
+        ~Mirror();
+
+        [[nodiscard]] bool isValid() const;
+
+    private:
+        struct Worker;
+
+        void changed(Platform::FolderWatcher::Change change, const QString &path);
+
+        void flush();
+
+        Options _options;
+        std::shared_ptr<Worker> _worker;
+        std::unique_ptr<Platform::FolderWatcher> _watcher;
+        QTimer _timer;
+        QElapsedTimer _pending;
+        QSet<QString> _changed;
+        bool _rescan = false;
+    }; // Mirror
+
+} // namespace Transfer
@@ -0,0 +1,214 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/mirror_index.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QtEndian>
+#include <QSet>
+#include <filesystem>
+
+namespace Transfer {
+
+    namespace {
+
+        const QString kScanSuffix = ".next";
+
+        void writeRecord(QFile &file, quint8 op, const QString &relativePath, const MirrorIndex::State &state) {
+            QDataStream stream(&file);
+            stream << op << relativePath << state.size << state.modified << state.hash;
+        }
+
+    } // namespace
+
+    MirrorIndex::MirrorIndex(const QString &logPath) : _logPath(logPath), _log(logPath) {
+    }
+
+    void MirrorIndex::openLog() {
+        if (!_log.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            qWarning() << "Cannot write mirror index:" << _logPath;
+        }
+    }
+
+    quint64 MirrorIndex::keyOf(const QString &relativePath) {
+        QByteArray digest = QCryptographicHash::hash(relativePath.toUtf8(), QCryptographicHash::Md5);
+        return qFromLittleEndian<quint64>(digest.constData());
+    }
+
+    void MirrorIndex::load() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _entries.clear();
+        _log.close();
+        QFile file(_logPath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            openLog();
+            return;
+        }
+        QDataStream stream(&file);
+        qint64 valid = 0;
+        while (!stream.atEnd()) {
+            quint8 op;
+            QString relativePath;
+            State state;
+            stream >> op >> relativePath >> state.size >> state.modified >> state.hash;
+            if (stream.status() != QDataStream::Ok) {
+                break;
+            }
+            if (op == OpSet) {
+                _entries.insert(keyOf(relativePath), {state});
+            } else {
+                _entries.remove(keyOf(relativePath));
+            }
+            valid = file.pos();
+        }
+        bool truncated = valid < file.size();
+        file.close();
+        if (truncated) {
+            // drop a record cut off by a crash, or it would hide the
+            // records appended after it
+            QFile::resize(_logPath, valid);
+        }
+        openLog();
+    }
+
+    std::optional<MirrorIndex::State> MirrorIndex::find(const QString &relativePath) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _entries.constFind(keyOf(relativePath));
+        if (it == _entries.constEnd()) {
+            return std::nullopt;
+        }
+        return it->state;
+    }
+
+    void MirrorIndex::set(const QString &relativePath, const State &state) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Entry &entry = _entries[keyOf(relativePath)];
+        entry.state = state;
+        entry.seen = true;
+        append(OpSet, relativePath, state);
+    }
+
+    void MirrorIndex::remove(const QString &relativePath) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _entries.remove(keyOf(relativePath));
+        append(OpRemove, relativePath, {});
+    }
+
+    void MirrorIndex::append(Op op, const QString &relativePath, const State &state) {
+        if (_log.isOpen()) {
+            writeRecord(_log, op, relativePath, state);
+        }
+        // changes made during a scan have to survive the log swap
+        if (_scanLog) {
+            writeRecord(*_scanLog, op, relativePath, state);
+        }
+    }
+
+    void MirrorIndex::replay(const Fn<void(const QString &)> &visit) {
+        _log.flush();
+        QFile file(_logPath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return;
+        }
+        QDataStream stream(&file);
+        while (!stream.atEnd()) {
+            quint8 op;
+            QString relativePath;
+            State state;
+            stream >> op >> relativePath >> state.size >> state.modified >> state.hash;
+            if (stream.status() != QDataStream::Ok) {
+                break;
+            }
+            if (op == OpSet && _entries.contains(keyOf(relativePath))) {
+                visit(relativePath);
+            }
+        }
+    }
+
+    void MirrorIndex::forEachUnder(const QString &prefix, const Fn<void(const QString &)> &visit) {
+        QSet<QString> found;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            replay([&](const QString &relativePath) {
+                if (relativePath.startsWith(prefix)) {
+                    found.insert(relativePath);
+                }
+            });
+        }
+        for (const QString &relativePath : found) {
+            visit(relativePath);
+        }
+    }
+
+    void MirrorIndex::beginScan() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto &entry : _entries) {
+            entry.seen = false;
+        }
+        _scanLog = std::make_unique<QFile>(_logPath + kScanSuffix);
+        if (!_scanLog->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qWarning() << "Cannot write mirror index:" << _scanLog->fileName();
+            _scanLog.reset();
+        }
+    }
+
+    void MirrorIndex::keep(const QString &relativePath, const State &state) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _entries.find(keyOf(relativePath));
+        if (it == _entries.end()) {
+            return;
+        }
+        it->seen = true;
+        if (_scanLog) {
+            writeRecord(*_scanLog, OpSet, relativePath, state);
+        }
+    }
+
+    void MirrorIndex::finishScan(const Fn<void(const QString &)> &removed) {
+        QSet<QString> missing;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            replay([&](const QString &relativePath) {
+                auto it = _entries.find(keyOf(relativePath));
+                if (it->seen) {
+                    return;
+                }
+                // still on the receiver until the removal went through
+                it->seen = true;
+                missing.insert(relativePath);
+                if (_scanLog) {
+                    writeRecord(*_scanLog, OpSet, relativePath, it->state);
+                }
+            });
+            if (_scanLog) {
+                _scanLog->close();
+                _log.close();
+                std::error_code error;
+                std::filesystem::rename(
+                        std::filesystem::path(_scanLog->fileName().toStdU16String()),
+                        std::filesystem::path(_logPath.toStdU16String()),
+                        error);
+                if (error) {
+                    qWarning() << "Cannot replace mirror index:" << _logPath;
+                }
+                _scanLog.reset();
+                openLog();
+            }
+        }
+        for (const QString &relativePath : missing) {
+            removed(relativePath);
+        }
+    }
+
+    qsizetype MirrorIndex::size() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _entries.size();
+    }
+
+} // namespace Transfer
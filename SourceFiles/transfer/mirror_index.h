@@ -0,0 +1,83 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include "base_util.h"
+
+#include <QFile>
+#include <QHash>
+#include <QString>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+namespace Transfer {
+
+    // What the receiver of a mirror has of every file, by path relative to
+    // the mirrored folder. Only a 64-bit key of each path is kept in memory;
+    // the paths themselves live in an append-only log on disk, which is
+    // read back for the rare lookups that need them (removed files and
+    // folders). A full scan rewrites the log with live entries only.
+    class MirrorIndex {
+    public:
+        struct State {
+            qint64 size = 0;
+            qint64 modified = 0;
+            quint64 hash = 0; // 0 when the content was not hashed
+        };
+
+        explicit MirrorIndex(const QString &logPath);
+
+        void load();
+
+        [[nodiscard]] std::optional<State> find(const QString &relativePath);
+
+        void set(const QString &relativePath, const State &state);
+
+        void remove(const QString &relativePath);
+
+        // Calls visit for every indexed path below prefix.
+        void forEachUnder(const QString &prefix, const Fn<void(const QString &)> &visit);
+
+        // A full scan reports every file it finds with keep(). When it is
+        // done, finishScan() calls removed for everything it did not see.
+        void beginScan();
+
+        void keep(const QString &relativePath, const State &state);
+
+        void finishScan(const Fn<void(const QString &)> &removed);
+
+        [[nodiscard]] qsizetype size();
+
+    private:
+        enum Op : quint8 {
+            OpSet = 1,
+            OpRemove = 2
+        };
+
+        struct Entry {
+            State state;
+            bool seen = false;
+        };
+
+        [[nodiscard]] static quint64 keyOf(const QString &relativePath);
+
+        // Replays the log, calling visit for every path that is still set.
+        void replay(const Fn<void(const QString &)> &visit);
+
+        void append(Op op, const QString &relativePath, const State &state);
+
+        void openLog();
+
+        std::mutex _mutex;
+        QString _logPath;
+        QFile _log;
+        QHash<quint64, Entry> _entries;
+        std::unique_ptr<QFile> _scanLog;
+    }; // MirrorIndex
+
+} // namespace Transfer
@@ -0,0 +1,719 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/multicast.h"
+
+#include "transfer/shaper.h"
+#include "transfer/transport_tuner.h"
+
+#include <QBitArray>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <thread>
+#include <vector>
+
+namespace Transfer {
+
+    namespace {
+
+        constexpr quint32 kMagic = 0x46444d43; // FDMC
+        // Files are split into units that fit an Ethernet frame with the
+        // headers, one per datagram so nothing is fragmented. The tuner
+        // sizes the bursts they are sent in.
+        constexpr int kUnitSize = 1400;
+        constexpr int kAnnounceIntervalMs = 500;
+        constexpr int kStatusIntervalMs = 200;
+        constexpr int kRateIntervalMs = 250;
+        constexpr int kMaxNackRanges = 100;
+        // gaps this close to the newest unit may still be reordering
+        constexpr quint32 kReorderWindow = 256;
+        constexpr qint64 kMinRate = 256 * 1024;
+        constexpr double kLossThreshold = 0.02;
+        constexpr double kBackoff = 0.7;
+        constexpr int kDoneRepeats = 3;
+        constexpr int kLingerMs = 2000;
+        // receivers answer each other's NACKs after a random delay, the
+        // first answer on the group cancels the others
+        constexpr int kPeerRepairMinMs = 10;
+        constexpr int kPeerRepairMaxMs = 150;
+        constexpr int kPeerRepairsPerRound = 256;
+        constexpr std::size_t kMaxPeerRepairs = 4096;
+        // the sender leaves NACKs this long to the receivers
+        constexpr int kPeerGraceMs = kPeerRepairMaxMs + kStatusIntervalMs;
+        constexpr std::size_t kMaxDeferred = 65536;
+        constexpr quint32 kNoEcho = 0xffffffff;
+
+        enum Type : quint8 {
+            TypeAnnounce = 1,
+            TypeData = 2,
+            TypeStatus = 3
+        };
+
+        struct Range {
+            quint32 first = 0;
+            quint32 count = 0;
+        };
+
+        struct Announce {
+            quint64 session = 0;
+            qint64 size = 0;
+            quint32 units = 0;
+            bool end = false; // every unit was sent at least once
+            // sender's clock in ms, echoed back for the RTT
+            quint32 stamp = 0;
+            QString name;
+        };
+
+        struct Status {
+            quint64 session = 0;
+            quint64 receiver = 0;
+            quint32 received = 0;
+            bool done = false;
+            quint32 echoStamp = 0;
+            // how long the stamp was held, kNoEcho before any announce
+            quint32 echoDelay = kNoEcho;
+            std::vector<Range> missing;
+        };
+
+        quint32 unitCount(qint64 size) {
+            return quint32((size + kUnitSize - 1) / kUnitSize);
+        }
+
+        qint64 unitsLength(qint64 size, quint32 first, quint32 count) {
+            qint64 offset = qint64(first) * kUnitSize;
+            return std::min<qint64>(qint64(count) * kUnitSize, size - offset);
+        }
+
+        QByteArray encode(Type type, const Fn<void(QDataStream &)> &body) {
+            QByteArray packet;
+            QDataStream stream(&packet, QIODevice::WriteOnly);
+            stream << kMagic << quint8(type);
+            body(stream);
+            return packet;
+        }
+
+        bool decodeHeader(QDataStream &stream, Type &type) {
+            quint32 magic;
+            quint8 value;
+            stream >> magic >> value;
+            type = Type(value);
+            return stream.status() == QDataStream::Ok && magic == kMagic;
+        }
+
+        QByteArray encodeAnnounce(const Announce &announce) {
+            return encode(TypeAnnounce, [&](QDataStream &stream) {
+                stream << announce.session << announce.size << announce.units << announce.end << announce.stamp << announce.name;
+            });
+        }
+
+        bool decodeAnnounce(QDataStream &stream, Announce &announce) {
+            stream >> announce.session >> announce.size >> announce.units >> announce.end >> announce.stamp >> announce.name;
+            return stream.status() == QDataStream::Ok && announce.size >= 0 && announce.units == unitCount(announce.size);
+        }
+
+        QByteArray encodeData(quint64 session, quint32 first, quint16 count, const char *data, int length) {
+            return encode(TypeData, [&](QDataStream &stream) {
+                stream << session << first << count;
+                stream.writeRawData(data, length);
+            });
+        }
+
+        // One datagram per unit of data, which holds units first and on.
+        std::vector<QByteArray> encodeUnits(quint64 session, quint32 first, quint32 count, const char *data, int length) {
+            std::vector<QByteArray> packets;
+            packets.reserve(count);
+            for (quint32 i = 0; i < count; ++i) {
+                int offset = int(i) * kUnitSize;
+                packets.push_back(encodeData(session, first + i, 1, data + offset, std::min(length - offset, kUnitSize)));
+            }
+            return packets;
+        }
+
+        QByteArray encodeStatus(const Status &status) {
+            return encode(TypeStatus, [&](QDataStream &stream) {
+                stream << status.session << status.receiver << status.received << status.done << status.echoStamp
+                       << status.echoDelay << quint16(status.missing.size());
+                for (const auto &range : status.missing) {
+                    stream << range.first << range.count;
+                }
+            });
+        }
+
+        bool decodeStatus(QDataStream &stream, Status &status) {
+            quint16 ranges;
+            stream >> status.session >> status.receiver >> status.received >> status.done >> status.echoStamp
+                   >> status.echoDelay >> ranges;
+            for (quint16 i = 0; i < ranges && stream.status() == QDataStream::Ok; ++i) {
+                Range range;
+                stream >> range.first >> range.count;
+                status.missing.push_back(range);
+            }
+            return stream.status() == QDataStream::Ok;
+        }
+
+        void sleepFor(std::chrono::nanoseconds wait) {
+            // short waits are left as debt in the bucket, sleeping that
+            // little overshoots anyway
+            if (wait > std::chrono::milliseconds(1)) {
+                std::this_thread::sleep_for(wait);
+            }
+        }
+
+        class Sender {
+        public:
+            Sender(QFile &file, const MulticastOptions &options, DatagramChannel &channel)
+                    : _file(file),
+                      _options(options),
+                      _channel(channel),
+                      _units(unitCount(file.size())),
+                      _queued(int(_units)),
+                      _rate(double(options.initialRate)),
+                      _tuner(QFileInfo(file.fileName()).fileName(), kUnitSize, kStatusIntervalMs) {
+                _announce.session = QRandomGenerator::global()->generate64();
+                _announce.size = file.size();
+                _announce.units = _units;
+                _announce.name = QFileInfo(file.fileName()).fileName();
+                _pacing.setRate(qint64(_rate));
+            }
+
+            bool run(const Fn<bool()> &isStopped) {
+                QElapsedTimer clock;
+                clock.start();
+                qint64 lastAnnounce = -kAnnounceIntervalMs;
+                qint64 lastRate = 0;
+                qint64 lastHeard = 0;
+                std::vector<char> buffer(kUnitSize * TransportTuner::kMaxUnits);
+                _channel.setBufferSizes(_tuner.sendBuffer(), 0);
+
+                while (!isStopped()) {
+                    qint64 now = clock.elapsed();
+                    if (now - lastAnnounce >= kAnnounceIntervalMs) {
+                        _announce.end = _next >= _units;
+                        _announce.stamp = quint32(now);
+                        send(encodeAnnounce(_announce));
+                        lastAnnounce = now;
+                    }
+                    if (readStatuses(now)) {
+                        lastHeard = now;
+                    }
+                    if (now - lastRate >= kRateIntervalMs) {
+                        adjustRate();
+                        pruneDeferred(now);
+                        lastRate = now;
+                    }
+
+                    Range chunk = nextChunk();
+                    if (chunk.count == 0) {
+                        if (finished()) {
+                            qInfo() << "Multicast: sent" << _announce.name << "to" << _receivers.size() << "receivers,"
+                                    << _repaired << "units repaired," << _leftToPeers << "NACKs left to receivers";
+                            _tuner.logSummary();
+                            return true;
+                        }
+                        if (now - lastHeard > _options.idleTimeoutMs) {
+                            qWarning() << "Multicast: receivers went quiet," << doneCount() << "of" << _options.receivers << "done";
+                            return false;
+                        }
+                        _channel.wait(kStatusIntervalMs);
+                        continue;
+                    }
+
+                    auto length = int(unitsLength(_announce.size, chunk.first, chunk.count));
+                    if (!_file.seek(qint64(chunk.first) * kUnitSize) || _file.read(buffer.data(), length) != length) {
+                        qWarning() << "Multicast: cannot read" << _file.fileName();
+                        return false;
+                    }
+                    _channel.send(encodeUnits(_announce.session, chunk.first, chunk.count, buffer.data(), length),
+                                  _options.group, _options.port);
+                    _sentSinceRate += chunk.count;
+                    sleepFor(_pacing.take(length));
+                }
+                return false;
+            }
+
+        private:
+            struct ReceiverState {
+                quint32 received = 0;
+                bool done = false;
+                double rttMs = -1;
+            };
+
+            struct Deferred {
+                qint64 first = 0;
+                qint64 last = 0;
+            };
+
+            void send(const QByteArray &packet) {
+                _channel.send(packet, _options.group, _options.port);
+            }
+
+            // Repairs go before new units, consecutive ones share a
+            // burst. New units wait while the slowest receiver is a
+            // window behind.
+            Range nextChunk() {
+                auto units = quint32(_tuner.chunkUnits());
+                Range chunk;
+                if (!_repairs.empty()) {
+                    chunk.first = _repairs.front();
+                    while (!_repairs.empty() && chunk.count < units && _repairs.front() == chunk.first + chunk.count) {
+                        _queued.clearBit(int(_repairs.front()));
+                        _repairs.pop_front();
+                        ++chunk.count;
+                    }
+                    _repaired += chunk.count;
+                    return chunk;
+                }
+                if (_next < _units && qint64(_next - slowestReceived()) * kUnitSize < _tuner.window()) {
+                    chunk.first = _next;
+                    chunk.count = std::min(units, _units - _next);
+                    _next += chunk.count;
+                }
+                return chunk;
+            }
+
+            [[nodiscard]] quint32 slowestReceived() const {
+                quint32 slowest = _next;
+                for (const auto &[id, receiver] : _receivers) {
+                    if (!receiver.done) {
+                        slowest = std::min(slowest, receiver.received);
+                    }
+                }
+                return slowest;
+            }
+
+            bool readStatuses(qint64 now) {
+                bool heard = false;
+                while (auto datagram = _channel.receive()) {
+                    QDataStream stream(datagram->data);
+                    Type type;
+                    Status status;
+                    if (!decodeHeader(stream, type) || type != TypeStatus || !decodeStatus(stream, status)
+                        || status.session != _announce.session) {
+                        continue;
+                    }
+                    heard = true;
+                    ReceiverState &receiver = _receivers[status.receiver];
+                    receiver.received = status.received;
+                    receiver.done = status.done;
+                    if (status.echoDelay != kNoEcho) {
+                        qint64 rtt = qint64(quint32(now) - status.echoStamp) - qint64(status.echoDelay);
+                        receiver.rttMs = double(std::max<qint64>(rtt, 0));
+                    }
+                    for (const auto &range : status.missing) {
+                        quint64 last = std::min<quint64>(quint64(range.first) + range.count, _next);
+                        for (quint64 i = range.first; i < last; ++i) {
+                            nacked(quint32(i), now);
+                        }
+                    }
+                }
+                return heard;
+            }
+
+            void nacked(quint32 index, qint64 now) {
+                // several receivers usually miss the same chunk
+                if (_queued.testBit(int(index))) {
+                    return;
+                }
+                // with other receivers around one of them likely holds the
+                // chunk, the sender only repairs what is still missing
+                // after they had their chance
+                auto it = _deferred.find(index);
+                if (it != _deferred.end()) {
+                    it->second.last = now;
+                    if (now - it->second.first >= kPeerGraceMs) {
+                        _deferred.erase(it);
+                        queueRepair(index);
+                    }
+                    return;
+                }
+                ++_nackedSinceRate;
+                if (_options.peerRepair && _receivers.size() > 1 && _deferred.size() < kMaxDeferred) {
+                    _deferred.emplace(index, Deferred{now, now});
+                } else {
+                    queueRepair(index);
+                }
+            }
+
+            void queueRepair(quint32 index) {
+                _queued.setBit(int(index));
+                _repairs.push_back(index);
+            }
+
+            // NACKs that stopped coming were answered by a receiver
+            void pruneDeferred(qint64 now) {
+                for (auto it = _deferred.begin(); it != _deferred.end();) {
+                    if (now - it->second.last > kPeerGraceMs * 2) {
+                        it = _deferred.erase(it);
+                        ++_leftToPeers;
+                    } else {
+                        ++it;
+                    }
+                }
+            }
+
+            // AIMD: back off on loss, probe upwards otherwise. The tuner
+            // then sizes chunks, window and buffers for the new rate.
+            void adjustRate() {
+                TuningSample sample;
+                if (_sentSinceRate > 0) {
+                    sample.loss = double(_nackedSinceRate) / double(_sentSinceRate);
+                    if (sample.loss > kLossThreshold) {
+                        _rate = std::max(_rate * kBackoff, double(kMinRate));
+                    } else {
+                        _rate = std::min(_rate + double(_options.initialRate) / 4, double(_options.maxRate));
+                    }
+                    _pacing.setRate(qint64(_rate));
+                }
+                for (auto &[id, receiver] : _receivers) {
+                    sample.rttMs = std::max(sample.rttMs, receiver.rttMs);
+                    receiver.rttMs = -1;
+                }
+                sample.rate = qint64(_rate);
+                if (_tuner.update(sample)) {
+                    _channel.setBufferSizes(_tuner.sendBuffer(), 0);
+                }
+                _sentSinceRate = 0;
+                _nackedSinceRate = 0;
+            }
+
+            [[nodiscard]] int doneCount() const {
+                int done = 0;
+                for (const auto &[id, receiver] : _receivers) {
+                    done += receiver.done ? 1 : 0;
+                }
+                return done;
+            }
+
+            [[nodiscard]] bool finished() const {
+                return doneCount() == int(_receivers.size()) && doneCount() >= _options.receivers;
+            }
+
+            QFile &_file;
+            const MulticastOptions &_options;
+            DatagramChannel &_channel;
+            Announce _announce;
+            const quint32 _units;
+            quint32 _next = 0;
+            std::deque<quint32> _repairs;
+            QBitArray _queued;
+            std::map<quint64, ReceiverState> _receivers;
+            std::map<quint32, Deferred> _deferred;
+            TokenBucket _pacing;
+            double _rate;
+            TransportTuner _tuner;
+            qint64 _sentSinceRate = 0;
+            qint64 _nackedSinceRate = 0;
+            qint64 _repaired = 0;
+            qint64 _leftToPeers = 0;
+        };
+
+        class Receiver {
+        public:
+            Receiver(const QString &destDir, const MulticastOptions &options, DatagramChannel &channel)
+                    : _destDir(destDir),
+                      _options(options),
+                      _channel(channel) {
+                _status.receiver = QRandomGenerator::global()->generate64();
+            }
+
+            bool run(const Fn<bool()> &isStopped) {
+                QElapsedTimer clock;
+                clock.start();
+                qint64 lastPacket = 0;
+                qint64 lastStatus = 0;
+                qint64 doneAt = -1;
+                bool finished = false;
+                while (!isStopped()) {
+                    _channel.wait(kStatusIntervalMs / 2);
+                    qint64 now = clock.elapsed();
+                    if (readPackets(now)) {
+                        lastPacket = now;
+                    }
+                    servePeers(now);
+                    if (_started && (now - lastStatus >= kStatusIntervalMs || (_status.done && doneAt < 0))) {
+                        sendStatus(now);
+                        tuneReceiveBuffer(now);
+                        lastStatus = now;
+                    }
+                    if (_status.done && doneAt < 0) {
+                        finished = finish();
+                        doneAt = now;
+                    }
+                    // keeps confirming for a while in case the sender
+                    // missed the done status
+                    if (doneAt >= 0 && (now - doneAt > kLingerMs || now - lastPacket > kAnnounceIntervalMs * 2)) {
+                        return finished;
+                    }
+                    if (now - lastPacket > _options.idleTimeoutMs) {
+                        qWarning() << "Multicast: sender went quiet";
+                        break;
+                    }
+                }
+                if (doneAt < 0) {
+                    _output.remove();
+                }
+                return finished;
+            }
+
+        private:
+            bool readPackets(qint64 now) {
+                bool heard = false;
+                while (auto datagram = _channel.receive()) {
+                    QDataStream stream(datagram->data);
+                    Type type;
+                    if (!decodeHeader(stream, type)) {
+                        continue;
+                    }
+                    if (type == TypeAnnounce) {
+                        Announce announce;
+                        if (decodeAnnounce(stream, announce) && (!_started || announce.session == _announce.session)) {
+                            heard = true;
+                            if (!_started && !start(announce, *datagram)) {
+                                return heard;
+                            }
+                            _announce.end = announce.end;
+                            _status.echoStamp = announce.stamp;
+                            _echoReceived = now;
+                        }
+                    } else if (type == TypeData && _started) {
+                        quint64 session;
+                        quint32 first;
+                        quint16 count;
+                        stream >> session >> first >> count;
+                        if (stream.status() != QDataStream::Ok || session != _announce.session || count == 0
+                            || quint64(first) + count > _announce.units) {
+                            continue;
+                        }
+                        heard = true;
+                        _bytesSinceTune += datagram->data.size();
+                        for (quint32 i = first; i < first + count; ++i) {
+                            _peerRepairs.erase(i);
+                        }
+                        store(first, count, datagram->data.mid(int(stream.device()->pos())));
+                    } else if (type == TypeStatus && _started && _options.peerRepair) {
+                        Status status;
+                        if (decodeStatus(stream, status) && status.session == _announce.session
+                            && status.receiver != _status.receiver) {
+                            schedulePeerRepairs(status, now);
+                        }
+                    }
+                }
+                return heard;
+            }
+
+            bool start(const Announce &announce, const Datagram &datagram) {
+                _announce = announce;
+                _sender = datagram.address;
+                _senderPort = datagram.port;
+                _have.resize(int(announce.units));
+                // the name comes from the network, keep it inside destDir
+                QString name = QFileInfo(announce.name).fileName();
+                if (name.isEmpty()) {
+                    return false;
+                }
+                QDir().mkpath(_destDir);
+                _targetPath = QDir(_destDir).filePath(name);
+                _output.setFileName(_targetPath + ".fdmcast");
+                if (!_output.open(QIODevice::ReadWrite | QIODevice::Truncate) || !_output.resize(announce.size)) {
+                    qWarning() << "Multicast: cannot write" << _output.fileName();
+                    return false;
+                }
+                _started = true;
+                _status.session = announce.session;
+                _status.done = announce.units == 0;
+                qInfo() << "Multicast: receiving" << name << "," << announce.size << "bytes from" << _sender;
+                return true;
+            }
+
+            void store(quint32 first, quint32 count, const QByteArray &payload) {
+                quint32 fresh = 0;
+                for (quint32 i = first; i < first + count; ++i) {
+                    fresh += _have.testBit(int(i)) ? 0 : 1;
+                }
+                // units we already hold are rewritten with the same bytes
+                qint64 expected = unitsLength(_announce.size, first, count);
+                if (fresh == 0 || payload.size() != expected || !_output.seek(qint64(first) * kUnitSize)
+                    || _output.write(payload) != expected) {
+                    return;
+                }
+                for (quint32 i = first; i < first + count; ++i) {
+                    _have.setBit(int(i));
+                }
+                _highest = std::max(_highest, first + count - 1);
+                _status.received += fresh;
+                _status.done = _status.received == _announce.units;
+            }
+
+            void schedulePeerRepairs(const Status &status, qint64 now) {
+                for (const auto &range : status.missing) {
+                    quint64 last = std::min<quint64>(quint64(range.first) + range.count, _announce.units);
+                    for (quint64 i = range.first; i < last && _peerRepairs.size() < kMaxPeerRepairs; ++i) {
+                        if (_have.testBit(int(i))) {
+                            int delay = QRandomGenerator::global()->bounded(kPeerRepairMinMs, kPeerRepairMaxMs);
+                            _peerRepairs.try_emplace(quint32(i), now + delay);
+                        }
+                    }
+                }
+            }
+
+            // Sends the repairs nobody else answered in time, consecutive
+            // units are read and sent as one burst. Our own packets loop
+            // back, but the entries are gone by then.
+            void servePeers(qint64 now) {
+                std::vector<char> buffer(kUnitSize * TransportTuner::kMaxUnits);
+                int served = 0;
+                for (auto it = _peerRepairs.begin(); it != _peerRepairs.end() && served < kPeerRepairsPerRound;) {
+                    if (it->second > now) {
+                        ++it;
+                        continue;
+                    }
+                    Range chunk{it->first, 0};
+                    while (it != _peerRepairs.end() && it->first == chunk.first + chunk.count && it->second <= now
+                           && chunk.count < quint32(TransportTuner::kMaxUnits)) {
+                        it = _peerRepairs.erase(it);
+                        ++chunk.count;
+                    }
+                    auto length = int(unitsLength(_announce.size, chunk.first, chunk.count));
+                    if (_output.isOpen() && _output.seek(qint64(chunk.first) * kUnitSize)
+                        && _output.read(buffer.data(), length) == length) {
+                        _channel.send(encodeUnits(_announce.session, chunk.first, chunk.count, buffer.data(), length),
+                                      _options.group, _options.port);
+                        served += int(chunk.count);
+                        _peerRepaired += chunk.count;
+                    }
+                }
+            }
+
+            void collectMissing() {
+                _status.missing.clear();
+                quint32 limit = _announce.end ? _announce.units
+                        : (_highest > kReorderWindow ? _highest - kReorderWindow : 0);
+                for (quint32 i = _nackFrom; i < limit && int(_status.missing.size()) < kMaxNackRanges; ++i) {
+                    if (_have.testBit(int(i))) {
+                        continue;
+                    }
+                    Range range{i, 0};
+                    while (i < limit && !_have.testBit(int(i))) {
+                        ++range.count;
+                        ++i;
+                    }
+                    _status.missing.push_back(range);
+                }
+                // start the next scan after the first gap, so a long
+                // transfer doesn't walk the whole bitmap every time
+                _nackFrom = _status.missing.empty() ? limit : _status.missing.front().first;
+            }
+
+            void sendStatus(qint64 now) {
+                collectMissing();
+                if (_echoReceived >= 0) {
+                    _status.echoDelay = quint32(now - _echoReceived);
+                }
+                QByteArray packet = encodeStatus(_status);
+                int repeats = _status.done ? kDoneRepeats : 1;
+                for (int i = 0; i < repeats; ++i) {
+                    _channel.send(packet, _sender, _senderPort);
+                }
+                // the other receivers see what we miss and can serve it
+                if (_options.peerRepair && !_status.missing.empty()) {
+                    _channel.send(packet, _options.group, _options.port);
+                }
+            }
+
+            void tuneReceiveBuffer(qint64 now) {
+                if (now <= _lastTune) {
+                    return;
+                }
+                int size = TransportTuner::receiveBuffer(_bytesSinceTune * 1000 / (now - _lastTune));
+                if (size > _receiveBuffer * 2 || size < _receiveBuffer / 2) {
+                    _channel.setBufferSizes(0, size);
+                    qInfo() << "Multicast: receive buffer" << size / 1024 << "KiB";
+                    _receiveBuffer = size;
+                }
+                _bytesSinceTune = 0;
+                _lastTune = now;
+            }
+
+            bool finish() {
+                _output.close();
+                QFile::remove(_targetPath);
+                if (!QFile::rename(_output.fileName(), _targetPath)) {
+                    qWarning() << "Multicast: cannot move" << _output.fileName();
+                    return false;
+                }
+                qInfo() << "Multicast: received" << _targetPath << "," << _peerRepaired << "units served to other receivers";
+                // keeps serving the others while lingering
+                _output.setFileName(_targetPath);
+                _output.open(QIODevice::ReadOnly);
+                return true;
+            }
+
+            QString _destDir;
+            const MulticastOptions &_options;
+            DatagramChannel &_channel;
+            bool _started = false;
+            Announce _announce;
+            QHostAddress _sender;
+            quint16 _senderPort = 0;
+            QBitArray _have;
+            quint32 _highest = 0;
+            quint32 _nackFrom = 0;
+            Status _status;
+            QString _targetPath;
+            QFile _output;
+            std::map<quint32, qint64> _peerRepairs;
+            qint64 _peerRepaired = 0;
+            qint64 _echoReceived = -1;
+            qint64 _bytesSinceTune = 0;
+            qint64 _lastTune = 0;
+            int _receiveBuffer = 0;
+        };
+
+    } // namespace
+
+    bool multicastSend(const QString &filePath, const MulticastOptions &options, const Fn<bool()> &isStopped) {
+        auto channel = UdpChannel::open(options.interfaceName);
+        return channel && multicastSend(filePath, options, *channel, isStopped);
+    }
+
+    bool multicastSend(
+            const QString &filePath,
+            const MulticastOptions &options,
+            DatagramChannel &channel,
+            const Fn<bool()> &isStopped) {
+        QFile file(filePath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            qWarning() << "Multicast: cannot open" << filePath;
+            return false;
+        }
+        Sender sender(file, options, channel);
+        return sender.run(isStopped);
+    }
+
+    bool multicastReceive(const QString &destDir, const MulticastOptions &options, const Fn<bool()> &isStopped) {
+        auto channel = UdpChannel::join(options.group, options.port, options.interfaceName);
+        return channel && multicastReceive(destDir, options, *channel, isStopped);
+    }
+
+    bool multicastReceive(
+            const QString &destDir,
+            const MulticastOptions &options,
+            DatagramChannel &channel,
+            const Fn<bool()> &isStopped) {
+        Receiver receiver(destDir, options, channel);
+        return receiver.run(isStopped);
+    }
+
+} // namespace Transfer
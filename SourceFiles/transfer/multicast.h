@@ -0,0 +1,63 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include "base_util.h"
+#include "transfer/datagram_channel.h"
+
+#include <QHostAddress>
+#include <QString>
+
+namespace Transfer {
+
+    struct MulticastOptions {
+        QHostAddress group{QStringLiteral("239.255.70.68")};
+        quint16 port = 45470;
+        // sender: starting and highest rate, in bytes per second
+        qint64 initialRate = 4 * 1024 * 1024;
+        qint64 maxRate = 100 * 1024 * 1024;
+        // sender: receivers that have to finish before it stops
+        int receivers = 1;
+        // receivers serve each other's NACKs from what they already hold
+        bool peerRepair = true;
+        // gives up after this long without hearing from the other side
+        int idleTimeoutMs = 30 * 1000;
+        // sends or joins on this interface, empty lets the system pick
+        QString interfaceName;
+    };
+
+    // One-to-many transfer over UDP multicast. The sender multicasts every
+    // chunk once, receivers report the gaps they see (NACKs) and the sender
+    // repairs them, again by multicast, as several receivers usually miss
+    // the same chunks. The sending rate backs off when receivers report
+    // loss, so it follows the slowest receiver.
+    //
+    // With peerRepair, receivers also put their NACKs on the group and
+    // answer the ones of others after a random delay, the sender only
+    // repairs what nobody else could. Repair traffic then spreads over
+    // the receivers instead of all coming from the sender.
+    //
+    // Both calls block until the transfer is over, isStopped lets the
+    // caller break them off.
+    bool multicastSend(const QString &filePath, const MulticastOptions &options, const Fn<bool()> &isStopped);
+
+    bool multicastReceive(const QString &destDir, const MulticastOptions &options, const Fn<bool()> &isStopped);
+
+    // Over a given channel, see EmulatedNetwork.
+    bool multicastSend(
+            const QString &filePath,
+            const MulticastOptions &options,
+            DatagramChannel &channel,
+            const Fn<bool()> &isStopped);
+
+    bool multicastReceive(
+            const QString &destDir,
+            const MulticastOptions &options,
+            DatagramChannel &channel,
+            const Fn<bool()> &isStopped);
+
+} // namespace Transfer
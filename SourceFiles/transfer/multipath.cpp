@@ -0,0 +1,789 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/multipath.h"
+
+#include "transfer/delta.h"
+#include "transfer/shaper.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QtEndian>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <gsl/gsl>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+
+namespace Transfer {
+
+    namespace {
+
+        constexpr quint32 kMagic = 0x46444d50; // FDMP
+        constexpr quint8 kRanges = 1;
+        constexpr quint8 kCommit = 2;
+        constexpr quint8 kVerify = 3;
+        constexpr int kHeaderSize = 4 + 1 + 8 + 8;
+        constexpr int kRangeHeaderSize = 8 + 4;
+        constexpr qint64 kMaxRangeSize = 16 * 1024 * 1024;
+        // keeps the socket busy without queueing seconds of data
+        constexpr qint64 kMaxPending = 4 * 1024 * 1024;
+        constexpr int kPollMs = 100;
+        // a thread each, a few transfers' worth of paths
+        constexpr std::size_t kMaxConnections = 32;
+        const QString kStageSuffix = ".fdmpath";
+
+        struct Header {
+            quint8 command = 0;
+            MultipathFile file;
+        };
+
+        struct Range {
+            qint64 offset = 0;
+            qint64 length = 0;
+        };
+
+        bool readExactly(QTcpSocket &socket, char *data, qint64 size, int timeoutMs) {
+            while (size > 0) {
+                if (socket.bytesAvailable() == 0 && !socket.waitForReadyRead(timeoutMs)) {
+                    return false;
+                }
+                qint64 read = socket.read(data, size);
+                if (read < 0) {
+                    return false;
+                }
+                data += read;
+                size -= read;
+            }
+            return true;
+        }
+
+        bool flushTo(QTcpSocket &socket, qint64 pending, int timeoutMs) {
+            while (socket.bytesToWrite() > pending) {
+                if (!socket.waitForBytesWritten(timeoutMs)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void appendString(QByteArray &packet, const QString &value) {
+            QByteArray data = value.toUtf8().left(0xffff);
+            char size[2];
+            qToBigEndian(quint16(data.size()), size);
+            packet.append(size, 2);
+            packet.append(data);
+        }
+
+        bool readString(QTcpSocket &socket, QString &value, int timeoutMs) {
+            char size[2];
+            if (!readExactly(socket, size, 2, timeoutMs)) {
+                return false;
+            }
+            QByteArray data(qFromBigEndian<quint16>(size), Qt::Uninitialized);
+            if (!readExactly(socket, data.data(), data.size(), timeoutMs)) {
+                return false;
+            }
+            value = QString::fromUtf8(data);
+            return true;
+        }
+
+        QByteArray encodeHeader(const Header &header) {
+            QByteArray packet(kHeaderSize, Qt::Uninitialized);
+            char *data = packet.data();
+            qToBigEndian(kMagic, data);
+            data[4] = char(header.command);
+            qToBigEndian(header.file.transferId, data + 5);
+            qToBigEndian(header.file.size, data + 13);
+            appendString(packet, header.file.relativePath);
+            appendString(packet, header.file.senderId);
+            appendString(packet, header.file.senderName);
+            appendString(packet, header.file.sessionToken);
+            return packet;
+        }
+
+        bool readHeader(QTcpSocket &socket, Header &header, int timeoutMs) {
+            char data[kHeaderSize];
+            if (!readExactly(socket, data, kHeaderSize, timeoutMs) || qFromBigEndian<quint32>(data) != kMagic) {
+                return false;
+            }
+            header.command = quint8(data[4]);
+            header.file.transferId = qFromBigEndian<quint64>(data + 5);
+            header.file.size = qFromBigEndian<qint64>(data + 13);
+            if (!readString(socket, header.file.relativePath, timeoutMs)
+                || !readString(socket, header.file.senderId, timeoutMs)
+                || !readString(socket, header.file.senderName, timeoutMs)
+                || !readString(socket, header.file.sessionToken, timeoutMs)) {
+                return false;
+            }
+            return header.file.size >= 0 && header.command >= kRanges && header.command <= kVerify;
+        }
+
+        // The path comes from the network, empty when it leads out of root.
+        QString confinedPath(const QString &root, const QString &relativePath) {
+            QDir dir(root);
+            QString base = QDir::cleanPath(dir.absolutePath());
+            QString target = QDir::cleanPath(dir.absoluteFilePath(relativePath));
+            return !relativePath.isEmpty() && target.startsWith(base + '/') ? target : QString();
+        }
+
+        QString describe(const MultipathPath &path) {
+            return path.local.isNull() ? path.remote.toString() : path.local.toString() + " -> " + path.remote.toString();
+        }
+
+        // Ranges still to send, shared by the paths.
+        class RangeQueue {
+        public:
+            RangeQueue(qint64 size, qint64 rangeSize) {
+                for (qint64 offset = 0; offset < size; offset += rangeSize) {
+                    _pending.push_back({offset, std::min(rangeSize, size - offset)});
+                }
+            }
+
+            // At least one range while any is left, up to about bytes.
+            std::vector<Range> take(qint64 bytes) {
+                std::lock_guard<std::mutex> lock(_mutex);
+                std::vector<Range> batch;
+                qint64 taken = 0;
+                while (!_pending.empty() && (batch.empty() || taken + _pending.front().length <= bytes)) {
+                    batch.push_back(_pending.front());
+                    taken += _pending.front().length;
+                    _pending.pop_front();
+                }
+                _inFlight += qint64(batch.size());
+                return batch;
+            }
+
+            void done() {
+                std::lock_guard<std::mutex> lock(_mutex);
+                --_inFlight;
+                _changed.notify_all();
+            }
+
+            // From a path that dropped, the others pick them up.
+            void giveBack(const std::deque<Range> &ranges) {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _pending.insert(_pending.begin(), ranges.begin(), ranges.end());
+                _inFlight -= qint64(ranges.size());
+                _changed.notify_all();
+            }
+
+            // Until there is work again or nothing is left at all.
+            void waitForWork(int timeoutMs) {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _changed.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this]() {
+                    return !_pending.empty() || _inFlight == 0;
+                });
+            }
+
+            [[nodiscard]] bool finished() {
+                std::lock_guard<std::mutex> lock(_mutex);
+                return _pending.empty() && _inFlight == 0;
+            }
+
+        private:
+            std::mutex _mutex;
+            std::condition_variable _changed;
+            std::deque<Range> _pending;
+            qint64 _inFlight = 0;
+        };
+
+        bool connectPath(QTcpSocket &socket, const MultipathPath &path, const MultipathOptions &options, const Header &header) {
+            if (!path.local.isNull() && !socket.bind(path.local)) {
+                qWarning() << "Multipath: cannot bind" << path.local << ":" << socket.errorString();
+                return false;
+            }
+            socket.connectToHost(path.remote, options.port);
+            if (!socket.waitForConnected(options.ioTimeoutMs)) {
+                qWarning() << "Multipath: cannot connect" << describe(path) << ":" << socket.errorString();
+                return false;
+            }
+            socket.write(encodeHeader(header));
+            // the receiver asks about a new transfer before it answers and
+            // waits for the paths to settle before a commit
+            int answerTimeoutMs = header.command == kRanges ? options.askTimeoutMs : 2 * options.ioTimeoutMs;
+            char status = 0;
+            if (!flushTo(socket, 0, options.ioTimeoutMs) || !readExactly(socket, &status, 1, answerTimeoutMs) || status != 1) {
+                qWarning() << "Multipath: refused on" << describe(path);
+                return false;
+            }
+            return true;
+        }
+
+        // Feeds one path until the queue is empty or the path drops.
+        void runPath(
+                const QString &filePath,
+                const MultipathPath &path,
+                const MultipathOptions &options,
+                const Header &header,
+                RangeQueue &queue,
+                const Fn<bool()> &isStopped,
+                std::once_flag &accepted,
+                MultipathPathStats &stats) {
+            QFile file(filePath);
+            QTcpSocket socket;
+            if (!file.open(QIODevice::ReadOnly) || !connectPath(socket, path, options, header)) {
+                stats.failed = true;
+                return;
+            }
+            std::call_once(accepted, [&]() {
+                if (options.accepted) {
+                    options.accepted();
+                }
+            });
+            TokenBucket bucket;
+            bucket.setRate(path.maxRate);
+            QByteArray buffer;
+            std::deque<Range> unacked;
+            auto readAcks = [&](bool wait) {
+                while (!unacked.empty() && (wait || socket.bytesAvailable() >= 8)) {
+                    char ack[8];
+                    if (!readExactly(socket, ack, 8, options.ioTimeoutMs)
+                        || qFromBigEndian<qint64>(ack) != unacked.front().offset) {
+                        return false;
+                    }
+                    stats.bytes += unacked.front().length;
+                    unacked.pop_front();
+                    queue.done();
+                }
+                return true;
+            };
+
+            while (!isStopped()) {
+                // before a rate is known, a couple of ranges to measure one
+                auto want = stats.rate > 0
+                        ? qint64(stats.rate * options.batchMs / 1000)
+                        : 2 * options.rangeSize;
+                std::vector<Range> batch = queue.take(want);
+                if (batch.empty()) {
+                    if (queue.finished()) {
+                        break;
+                    }
+                    queue.waitForWork(kPollMs);
+                    continue;
+                }
+                unacked.insert(unacked.end(), batch.begin(), batch.end());
+
+                QElapsedTimer timer;
+                timer.start();
+                bool ok = true;
+                qint64 bytes = 0;
+                for (const Range &range : batch) {
+                    buffer.resize(range.length);
+                    if (!file.seek(range.offset) || file.read(buffer.data(), range.length) != range.length) {
+                        qWarning() << "Multipath: cannot read" << filePath;
+                        ok = false;
+                        break;
+                    }
+                    std::this_thread::sleep_for(bucket.take(range.length));
+                    if (options.throttle) {
+                        options.throttle(range.length);
+                    }
+                    char rangeHeader[kRangeHeaderSize];
+                    qToBigEndian(range.offset, rangeHeader);
+                    qToBigEndian(quint32(range.length), rangeHeader + 8);
+                    socket.write(rangeHeader, kRangeHeaderSize);
+                    socket.write(buffer);
+                    bytes += range.length;
+                    if (!flushTo(socket, kMaxPending, options.ioTimeoutMs) || !readAcks(false)) {
+                        ok = false;
+                        break;
+                    }
+                }
+                if (!ok || !readAcks(true)) {
+                    qWarning() << "Multipath: path" << describe(path) << "dropped," << unacked.size() << "ranges go to the others";
+                    queue.giveBack(unacked);
+                    stats.failed = true;
+                    return;
+                }
+                double measured = double(bytes) * 1000 / double(std::max<qint64>(timer.elapsed(), 1));
+                stats.rate = stats.rate > 0 ? 0.7 * stats.rate + 0.3 * measured : measured;
+            }
+            if (!unacked.empty()) {
+                queue.giveBack(unacked);
+            }
+            socket.disconnectFromHost();
+        }
+
+        bool commit(const std::vector<MultipathPath> &paths, const MultipathOptions &options, Header header) {
+            header.command = kCommit;
+            for (const auto &path : paths) {
+                QTcpSocket socket;
+                if (connectPath(socket, path, options, header)) {
+                    socket.disconnectFromHost();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Hands accepted sockets to the serving loop instead of keeping
+        // them, so they can be opened on the threads that serve them.
+        class Listener : public QTcpServer {
+        public:
+            std::vector<qintptr> takeDescriptors() {
+                return std::exchange(_descriptors, {});
+            }
+
+        protected:
+            void incomingConnection(qintptr descriptor) override {
+                _descriptors.push_back(descriptor);
+            }
+
+        private:
+            std::vector<qintptr> _descriptors;
+        };
+
+    } // namespace
+
+    bool multipathSend(
+            const QString &filePath,
+            MultipathFile file,
+            const std::vector<MultipathPath> &paths,
+            const MultipathOptions &options,
+            const Fn<bool()> &isStopped,
+            std::vector<MultipathPathStats> *stats) {
+        if (paths.empty() || options.rangeSize <= 0 || options.rangeSize > kMaxRangeSize) {
+            return false;
+        }
+        Header header;
+        header.command = kRanges;
+        header.file = std::move(file);
+        // 0 stands for no transfer on the receiver
+        header.file.transferId = QRandomGenerator::global()->generate64() | 1;
+        header.file.size = QFileInfo(filePath).size();
+
+        RangeQueue queue(header.file.size, options.rangeSize);
+        std::once_flag accepted;
+        std::vector<MultipathPathStats> pathStats(paths.size());
+        std::vector<std::thread> threads;
+        for (std::size_t i = 0; i < paths.size(); ++i) {
+            threads.emplace_back([&, i]() {
+                runPath(filePath, paths[i], options, header, queue, isStopped, accepted, pathStats[i]);
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        for (std::size_t i = 0; i < paths.size(); ++i) {
+            qInfo() << "Multipath:" << describe(paths[i]) << "carried" << pathStats[i].bytes << "bytes at"
+                    << pathStats[i].rate / (1024 * 1024) << "MiB/s" << (pathStats[i].failed ? "before it dropped" : "");
+        }
+        if (stats) {
+            *stats = pathStats;
+        }
+        if (!queue.finished()) {
+            qWarning() << "Multipath: every path dropped before" << filePath << "was sent";
+            return false;
+        }
+        return commit(paths, options, header);
+    }
+
+    bool multipathVerify(const MultipathPath &path, const MultipathFile &file, const QByteArray &hash, const MultipathOptions &options) {
+        Header header;
+        header.command = kVerify;
+        header.file = file;
+        QTcpSocket socket;
+        if (!path.local.isNull() && !socket.bind(path.local)) {
+            return false;
+        }
+        socket.connectToHost(path.remote, options.port);
+        if (!socket.waitForConnected(options.ioTimeoutMs)) {
+            return false;
+        }
+        QByteArray hashData = hash.left(0xffff);
+        char size[2];
+        qToBigEndian(quint16(hashData.size()), size);
+        socket.write(encodeHeader(header));
+        socket.write(size, 2);
+        socket.write(hashData);
+        // the receiver reads the whole file to answer
+        char status = 0;
+        bool match = flushTo(socket, 0, options.ioTimeoutMs) && readExactly(socket, &status, 1, options.askTimeoutMs) && status == 1;
+        socket.disconnectFromHost();
+        return match;
+    }
+
+    bool multipathReceive(const QString &destDir, const MultipathOptions &options, const Fn<bool()> &isStopped) {
+        MultipathServer server(destDir, options);
+        std::atomic<bool> started = false;
+        std::atomic<int> result = -1;
+        // one file from whoever sends first
+        server.setAskCallback([&](const MultipathFile &) {
+            return !started.exchange(true);
+        });
+        server.setDoneCallback([&](const MultipathFile &, const QString &filePath) {
+            result = filePath.isEmpty() ? 0 : 1;
+        });
+        if (!server.start()) {
+            return false;
+        }
+        QElapsedTimer idle;
+        idle.start();
+        while (result < 0 && !isStopped()) {
+            if (!started && idle.elapsed() > options.idleTimeoutMs) {
+                qWarning() << "Multipath: no sender showed up";
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(kPollMs));
+        }
+        server.stop();
+        return result == 1;
+    }
+
+    struct MultipathServer::Staged {
+        enum class State {
+            Asking,
+            Accepted,
+            Declined
+        };
+
+        MultipathFile file;
+        State state = State::Asking;
+        QString targetPath;
+        QString stagePath;
+        // ranges of a dropped path may come again over another
+        std::set<qint64> ranges;
+        qint64 received = 0;
+        int writers = 0;
+        // since the last range or answer
+        QElapsedTimer idle;
+    };
+
+    MultipathServer::MultipathServer(QString destDir, MultipathOptions options)
+            : _destDir(std::move(destDir)),
+              _options(std::move(options)) {
+    }
+
+    MultipathServer::~MultipathServer() {
+        stop();
+    }
+
+    bool MultipathServer::start() {
+        std::promise<bool> listening;
+        std::future<bool> listened = listening.get_future();
+        // the listener is used by the thread that serves it
+        _thread = std::thread([this, &listening]() {
+            run(listening);
+        });
+        if (!listened.get()) {
+            _thread.join();
+            return false;
+        }
+        return true;
+    }
+
+    void MultipathServer::stop() {
+        if (!_thread.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+            _changed.notify_all();
+        }
+        _thread.join();
+    }
+
+    void MultipathServer::run(std::promise<bool> &listening) {
+        Listener listener;
+        if (!listener.listen(QHostAddress::Any, _options.port)) {
+            qWarning() << "Multipath: cannot listen on" << _options.port << ":" << listener.errorString();
+            listening.set_value(false);
+            return;
+        }
+        listening.set_value(true);
+
+        QElapsedTimer sinceExpiry;
+        sinceExpiry.start();
+        while (!_stopping) {
+            listener.waitForNewConnection(kPollMs);
+            for (auto it = _connections.begin(); it != _connections.end();) {
+                if (!*it->finished) {
+                    ++it;
+                    continue;
+                }
+                it->thread.join();
+                it = _connections.erase(it);
+            }
+            for (qintptr descriptor : listener.takeDescriptors()) {
+                if (_connections.size() >= kMaxConnections) {
+                    qWarning() << "Multipath: too many connections, refusing one";
+                    QTcpSocket refused;
+                    if (refused.setSocketDescriptor(descriptor)) {
+                        refused.abort();
+                    }
+                    continue;
+                }
+                auto finished = std::make_shared<std::atomic<bool>>(false);
+                std::thread thread([this, descriptor, finished]() {
+                    serve(descriptor);
+                    *finished = true;
+                });
+                _connections.push_back({std::move(thread), finished});
+            }
+            if (sinceExpiry.elapsed() >= 1000) {
+                sinceExpiry.restart();
+                expire();
+            }
+        }
+        listener.close();
+        for (auto &connection : _connections) {
+            connection.thread.join();
+        }
+        _connections.clear();
+
+        // nothing comes for what is left
+        std::vector<std::shared_ptr<Staged>> left;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (const auto &[id, staged] : _transfers) {
+                if (staged->state == Staged::State::Accepted) {
+                    left.push_back(staged);
+                }
+            }
+            _transfers.clear();
+        }
+        for (const auto &staged : left) {
+            drop(staged);
+        }
+    }
+
+    std::shared_ptr<MultipathServer::Staged> MultipathServer::accept(const MultipathFile &file) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        auto it = _transfers.find(file.transferId);
+        if (it != _transfers.end()) {
+            // another path of a transfer, the first one asked for it
+            auto staged = it->second;
+            _changed.wait(lock, [&]() {
+                return staged->state != Staged::State::Asking || _stopping;
+            });
+            bool same = staged->file.size == file.size && staged->file.senderId == file.senderId;
+            return staged->state == Staged::State::Accepted && same ? staged : nullptr;
+        }
+        if (file.transferId == 0 || _stopping) {
+            return nullptr;
+        }
+
+        QString target = confinedPath(_destDir, file.relativePath);
+        if (target.isEmpty()) {
+            qWarning() << "Multipath: refused path" << file.relativePath;
+            return nullptr;
+        }
+        auto staged = std::make_shared<Staged>();
+        staged->file = file;
+        staged->targetPath = target;
+        staged->stagePath = target + "." + QString::number(file.transferId, 16) + kStageSuffix;
+        staged->idle.start();
+        _transfers[file.transferId] = staged;
+        lock.unlock();
+
+        bool accepted = !_ask || _ask(file);
+        bool staging = false;
+        if (accepted) {
+            QDir().mkpath(QFileInfo(target).path());
+            QFile stage(staged->stagePath);
+            staging = stage.open(QIODevice::WriteOnly | QIODevice::Truncate) && stage.resize(file.size);
+            if (!staging) {
+                qWarning() << "Multipath: cannot write" << staged->stagePath;
+            }
+        }
+
+        lock.lock();
+        staged->state = staging ? Staged::State::Accepted : Staged::State::Declined;
+        staged->idle.restart();
+        _changed.notify_all();
+        lock.unlock();
+        if (accepted && !staging) {
+            drop(staged);
+            return nullptr;
+        }
+        if (staging) {
+            qInfo() << "Multipath: receiving" << file.relativePath << "from" << file.senderId << "," << file.size << "bytes";
+        }
+        return staging ? staged : nullptr;
+    }
+
+    bool MultipathServer::commit(quint64 transferId) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        auto it = _transfers.find(transferId);
+        if (it == _transfers.end() || it->second->state != Staged::State::Accepted) {
+            return false;
+        }
+        auto staged = it->second;
+        // the connections of the paths may not have noticed yet that the
+        // sender closed them, their handles keep the file busy
+        _changed.wait_for(lock, std::chrono::milliseconds(_options.ioTimeoutMs), [&]() {
+            return staged->writers == 0;
+        });
+        if (staged->received != staged->file.size) {
+            qWarning() << "Multipath: commit with" << staged->received << "of" << staged->file.size << "bytes";
+            return false;
+        }
+        _transfers.erase(transferId);
+        lock.unlock();
+
+        // replaces the target in one step, an older copy the user already
+        // agreed to replace stays whole when the move fails
+        std::error_code error;
+        std::filesystem::rename(
+                std::filesystem::path(staged->stagePath.toStdU16String()),
+                std::filesystem::path(staged->targetPath.toStdU16String()),
+                error);
+        if (error) {
+            qWarning() << "Multipath: cannot move" << staged->stagePath << ":" << QString::fromStdString(error.message());
+            drop(staged);
+            return false;
+        }
+        qInfo() << "Multipath: received" << staged->targetPath;
+        if (_done) {
+            _done(staged->file, staged->targetPath);
+        }
+        return true;
+    }
+
+    void MultipathServer::expire() {
+        std::vector<std::shared_ptr<Staged>> quiet;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (auto it = _transfers.begin(); it != _transfers.end();) {
+                const auto &staged = it->second;
+                // a declined one stays a moment for its other paths
+                qint64 limit = staged->state == Staged::State::Declined ? _options.ioTimeoutMs : _options.idleTimeoutMs;
+                if (staged->state == Staged::State::Asking || staged->writers > 0 || staged->idle.elapsed() <= limit) {
+                    ++it;
+                    continue;
+                }
+                if (staged->state == Staged::State::Accepted) {
+                    qWarning() << "Multipath: sender of" << staged->file.relativePath << "went quiet";
+                    quiet.push_back(staged);
+                }
+                it = _transfers.erase(it);
+            }
+        }
+        for (const auto &staged : quiet) {
+            drop(staged);
+        }
+    }
+
+    void MultipathServer::drop(const std::shared_ptr<Staged> &staged) {
+        QFile::remove(staged->stagePath);
+        if (_done) {
+            _done(staged->file, {});
+        }
+    }
+
+    void MultipathServer::serve(qintptr descriptor) {
+        QTcpSocket socket;
+        if (!socket.setSocketDescriptor(descriptor)) {
+            return;
+        }
+        Header header;
+        if (!readHeader(socket, header, _options.ioTimeoutMs)) {
+            return;
+        }
+        std::shared_ptr<Staged> staged;
+        bool ok;
+        if (header.command == kVerify) {
+            // only says whether the file matches what the asker knows, it
+            // never hands out anything about the file
+            char size[2];
+            QByteArray hash;
+            if (!readExactly(socket, size, 2, _options.ioTimeoutMs)) {
+                return;
+            }
+            hash.resize(qFromBigEndian<quint16>(size));
+            if (!readExactly(socket, hash.data(), hash.size(), _options.ioTimeoutMs)) {
+                return;
+            }
+            // hashing is an oracle on the content and costs a read of the
+            // whole file, only for senders we took files from
+            QString target = _verifyAuthorize && _verifyAuthorize(socket.peerAddress(), header.file)
+                    ? confinedPath(_destDir, header.file.relativePath)
+                    : QString();
+            if (target.isEmpty()) {
+                qWarning() << "Multipath: refused to verify" << header.file.relativePath << "for" << socket.peerAddress();
+            }
+            // a delta for it may still be coming in or being applied
+            QElapsedTimer waited;
+            waited.start();
+            while (!target.isEmpty() && QFile::exists(target + kDeltaSuffix) && waited.elapsed() < _options.ioTimeoutMs) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(kPollMs));
+            }
+            ok = !target.isEmpty() && !hash.isEmpty() && hashFile(target) == hash;
+        } else if (header.command == kCommit) {
+            ok = commit(header.file.transferId);
+        } else {
+            staged = accept(header.file);
+            ok = staged != nullptr;
+        }
+        socket.write(ok ? "\1" : "\0", 1);
+        if (!flushTo(socket, 0, _options.ioTimeoutMs) || !staged) {
+            socket.disconnectFromHost();
+            return;
+        }
+
+        // every range has its own place, so connections write through
+        // their own handles without taking turns
+        QFile output(staged->stagePath);
+        if (!output.open(QIODevice::ReadWrite)) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            ++staged->writers;
+        }
+        auto writerDone = gsl::finally([&]() {
+            output.close();
+            std::lock_guard<std::mutex> lock(_mutex);
+            --staged->writers;
+            _changed.notify_all();
+        });
+        QByteArray buffer;
+        char rangeHeader[kRangeHeaderSize];
+        while (!_stopping && readExactly(socket, rangeHeader, kRangeHeaderSize, _options.ioTimeoutMs)) {
+            qint64 offset = qFromBigEndian<qint64>(rangeHeader);
+            qint64 length = qFromBigEndian<quint32>(rangeHeader + 8);
+            if (offset < 0 || length <= 0 || length > kMaxRangeSize || offset > staged->file.size - length) {
+                qWarning() << "Multipath: bad range" << offset << length;
+                return;
+            }
+            buffer.resize(length);
+            if (!readExactly(socket, buffer.data(), length, _options.ioTimeoutMs)
+                || !output.seek(offset) || output.write(buffer) != length || !output.flush()) {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (staged->ranges.insert(offset).second) {
+                    staged->received += length;
+                }
+                staged->idle.restart();
+            }
+            if (_throttle) {
+                _throttle(staged->file.senderId, length);
+            }
+            char ack[8];
+            qToBigEndian(offset, ack);
+            socket.write(ack, 8);
+            if (!flushTo(socket, kMaxPending, _options.ioTimeoutMs)) {
+                return;
+            }
+        }
+    }
+
+} // namespace Transfer
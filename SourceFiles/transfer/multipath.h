@@ -0,0 +1,166 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include "base_util.h"
+
+#include <QByteArray>
+#include <QHostAddress>
+#include <QString>
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Transfer {
+
+    constexpr quint16 kMultipathPort = 45473;
+
+    struct MultipathPath {
+        QHostAddress remote;
+        // binds our side to the address of one interface, null lets the
+        // system pick
+        QHostAddress local;
+        // bytes per second, 0 for unlimited; emulates a slower link
+        qint64 maxRate = 0;
+    };
+
+    struct MultipathOptions {
+        quint16 port = kMultipathPort;
+        qint64 rangeSize = 1024 * 1024;
+        // a path takes about this much work at a time at its measured
+        // rate, which bounds the wait for the slowest one at the end
+        int batchMs = 250;
+        int ioTimeoutMs = 10 * 1000;
+        // sender: how long the receiver may take to answer, the user may
+        // be asked first
+        int askTimeoutMs = 5 * 60 * 1000;
+        // receiver: drops a transfer after this long without progress
+        int idleTimeoutMs = 30 * 1000;
+        // sender: called with the size of every range before it goes out
+        Fn<void(qint64)> throttle;
+        // sender: called once when the receiver took the transfer
+        Fn<void()> accepted;
+    };
+
+    struct MultipathPathStats {
+        qint64 bytes = 0;
+        // bytes per second, last measured
+        double rate = 0;
+        bool failed = false;
+    };
+
+    // What a transfer carries besides the data, the receiver is asked
+    // about it once however many connections it comes over.
+    struct MultipathFile {
+        quint64 transferId = 0;
+        qint64 size = 0;
+        // where it goes under the receiver's folder
+        QString relativePath;
+        QString senderId;
+        QString senderName;
+        // the send it belongs to, see SendSession::token()
+        QString sessionToken;
+    };
+
+    // Sends one file over several TCP connections at once, one per path,
+    // e.g. wired and wireless to the same peer. The file is cut into
+    // ranges that every path takes from a shared queue in batches sized
+    // by its own rate, so each carries a share in proportion to its
+    // speed. A range counts once the receiver acknowledged it; when a
+    // path drops, its unacknowledged ranges go back to the queue and the
+    // others finish the transfer.
+    //
+    // transferId and size of file are filled in here. stats, when given,
+    // gets an entry per path. Blocks until the transfer is over,
+    // isStopped lets the caller break it off.
+    bool multipathSend(
+            const QString &filePath,
+            MultipathFile file,
+            const std::vector<MultipathPath> &paths,
+            const MultipathOptions &options,
+            const Fn<bool()> &isStopped,
+            std::vector<MultipathPathStats> *stats = nullptr);
+
+    // Whether the receiver's copy of file.relativePath has the given hash,
+    // see hashFile(). false as well when it can't be asked.
+    bool multipathVerify(const MultipathPath &path, const MultipathFile &file, const QByteArray &hash, const MultipathOptions &options);
+
+    // Receives one file sent with multipathSend() into destDir.
+    bool multipathReceive(const QString &destDir, const MultipathOptions &options, const Fn<bool()> &isStopped);
+
+    // Receives multipath transfers into destDir. Ranges are written in
+    // place into a staging file next to the target, which replaces the
+    // target on commit; a transfer whose sender went quiet is dropped
+    // together with its staging file. Also answers multipathVerify().
+    class MultipathServer {
+    public:
+        MultipathServer(QString destDir, MultipathOptions options);
+        ~MultipathServer();
+
+        // Called on the thread of the first connection of a transfer, the
+        // sender waits for the answer. Everything is taken when not set.
+        void setAskCallback(Fn<bool(const MultipathFile &)> ask) {
+            _ask = std::move(ask);
+        }
+
+        // Called once for every accepted transfer when it is over, with
+        // an empty filePath when it failed or was dropped.
+        void setDoneCallback(Fn<void(const MultipathFile &, const QString &filePath)> done) {
+            _done = std::move(done);
+        }
+
+        // Decides who may ask whether a file under destDir matches a hash,
+        // see multipathVerify(). Nobody may when not set.
+        void setVerifyAuthorize(Fn<bool(const QHostAddress &peer, const MultipathFile &file)> authorize) {
+            _verifyAuthorize = std::move(authorize);
+        }
+
+        // Called with the size of every range after it was received.
+        void setThrottle(Fn<void(const QString &senderId, qint64 bytes)> throttle) {
+            _throttle = std::move(throttle);
+        }
+
+        // Listens and serves on a thread of its own until stop().
+        bool start();
+
+        void stop();
+
+    private:
+        struct Staged;
+        struct Connection {
+            std::thread thread;
+            std::shared_ptr<std::atomic<bool>> finished;
+        };
+
+        void run(std::promise<bool> &listening);
+        void serve(qintptr descriptor);
+        std::shared_ptr<Staged> accept(const MultipathFile &file);
+        bool commit(quint64 transferId);
+        void expire();
+        void drop(const std::shared_ptr<Staged> &staged);
+
+        const QString _destDir;
+        const MultipathOptions _options;
+        Fn<bool(const MultipathFile &)> _ask;
+        Fn<void(const MultipathFile &, const QString &)> _done;
+        Fn<void(const QString &, qint64)> _throttle;
+        Fn<bool(const QHostAddress &, const MultipathFile &)> _verifyAuthorize;
+        std::atomic<bool> _stopping = false;
+        std::thread _thread;
+        std::list<Connection> _connections;
+        std::mutex _mutex;
+        std::condition_variable _changed;
+        std::map<quint64, std::shared_ptr<Staged>> _transfers;
+    }; // MultipathServer
+
+} // namespace Transfer
@@ -0,0 +1,64 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include <gsl/gsl>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace Transfer {
+
+    // Fixed-capacity storage for objects that are created and destroyed
+    // together. Storage is allocated once and reused after reset().
+    template <typename T>
+    class ObjectArena {
+    public:
+        explicit ObjectArena(std::size_t capacity) : _slots(new Slot[capacity]), _capacity(capacity) {
+        }
+
+        ObjectArena(const ObjectArena &) = delete;
+        ObjectArena &operator=(const ObjectArena &) = delete;
+
+        ~ObjectArena() {
+            reset();
+        }
+
+        template <typename... Args>
+        T *create(Args &&...args) {
+            Expects(_size < _capacity);
+            T *object = new (_slots[_size].data) T(std::forward<Args>(args)...);
+            ++_size;
+            return object;
+        }
+
+        void reset() {
+            for (std::size_t i = 0; i < _size; ++i) {
+                std::launder(reinterpret_cast<T *>(_slots[i].data))->~T();
+            }
+            _size = 0;
+        }
+
+        [[nodiscard]] std::size_t size() const {
+            return _size;
+        }
+
+        [[nodiscard]] bool full() const {
+            return _size == _capacity;
+        }
+
+    private:
+        struct Slot {
+            alignas(T) unsigned char data[sizeof(T)];
+        };
+
+        std::unique_ptr<Slot[]> _slots;
+        std::size_t _capacity;
+        std::size_t _size = 0;
+    }; // ObjectArena
+
+} // namespace Transfer
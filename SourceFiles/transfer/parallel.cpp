@@ -0,0 +1,28 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/parallel.h"
+
+#include <algorithm>
+
+namespace Transfer {
+
+    void ParallelTuner::record(int streams, double bytesPerSecond) {
+        if (bytesPerSecond > _bestRate * 1.1) {
+            // still gaining, try more streams next time
+            _bestRate = bytesPerSecond;
+            _bestStreams = streams;
+            _streams = std::min(streams * 2, kMaxStreams);
+        } else {
+            // settle on the best known count, the decay lets it explore
+            // again when the link gets better
+            _streams = _bestStreams;
+            _bestRate *= 0.9;
+        }
+    }
+
+} // namespace Transfer
@@ -0,0 +1,29 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+namespace Transfer {
+
+    // Picks the number of parallel connections per receiver by hill
+    // climbing on the throughput of previous transfers.
+    class ParallelTuner {
+    public:
+        static constexpr int kMaxStreams = 16;
+
+        [[nodiscard]] int streams() const {
+            return _streams;
+        }
+
+        void record(int streams, double bytesPerSecond);
+
+    private:
+        int _streams = 2;
+        int _bestStreams = 1;
+        double _bestRate = 0;
+    }; // ParallelTuner
+
+} // namespace Transfer
@@ -0,0 +1,370 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/presence.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QNetworkDatagram>
+#include <QTimer>
+#include <QUdpSocket>
+#include <algorithm>
+
+namespace Transfer {
+
+    namespace {
+
+        constexpr quint32 kMagic = 0x46445042; // FDPB
+        constexpr quint8 kBeacon = 1;
+        constexpr quint8 kQuery = 2;
+        const QHostAddress kGroup(QStringLiteral("239.255.70.68"));
+        constexpr quint16 kPort = 45472;
+        constexpr int kBeaconIntervalMs = 5000;
+        // where nothing was discovered for a while
+        constexpr int kIdleBeaconIntervalMs = 60 * 1000;
+        constexpr int kQueryIntervalMs = 1000;
+        // a path not beaconed on for this many intervals is gone
+        constexpr int kStaleBeacons = 3;
+
+        bool isStale(const PeerAddress &path, qint64 now) {
+            return path.lastSeen < now - qint64(kStaleBeacons) * std::max(path.beaconIntervalMs, kBeaconIntervalMs);
+        }
+
+        DiscoverySchedule::Options idleOptions() {
+            DiscoverySchedule::Options options;
+            options.burstMs = 0;
+            options.roundMs = 0;
+            options.firstPauseMs = kBeaconIntervalMs;
+            options.heartbeatMs = kIdleBeaconIntervalMs;
+            return options;
+        }
+
+        struct Message {
+            quint8 type = 0;
+            QString deviceId;
+            quint16 probePort = 0;
+            quint32 features = 0;
+            quint32 intervalMs = 0;
+        };
+
+        QByteArray encode(const Message &message) {
+            QByteArray packet;
+            QDataStream stream(&packet, QIODevice::WriteOnly);
+            stream << kMagic << message.type << message.deviceId << message.probePort << message.features << message.intervalMs;
+            return packet;
+        }
+
+        bool decode(const QByteArray &packet, Message &message) {
+            QDataStream stream(packet);
+            quint32 magic;
+            stream >> magic >> message.type >> message.deviceId >> message.probePort;
+            // older instances beacon without them
+            if (!stream.atEnd()) {
+                stream >> message.features;
+            }
+            if (!stream.atEnd()) {
+                stream >> message.intervalMs;
+            }
+            return stream.status() == QDataStream::Ok && magic == kMagic;
+        }
+
+        bool bindGroupPort(QUdpSocket &socket) {
+            if (!socket.bind(QHostAddress::AnyIPv4, kPort, QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint)) {
+                qWarning() << "Presence cannot bind" << kPort << ":" << socket.errorString();
+                return false;
+            }
+            socket.setSocketOption(QAbstractSocket::MulticastTtlOption, 1);
+            socket.setSocketOption(QAbstractSocket::MulticastLoopbackOption, 1);
+            return true;
+        }
+
+        // On the interface the system picks.
+        bool joinGroup(QUdpSocket &socket) {
+            if (!bindGroupPort(socket)) {
+                return false;
+            }
+            if (!socket.joinMulticastGroup(kGroup)) {
+                qWarning() << "Presence cannot join" << kGroup << ":" << socket.errorString();
+                return false;
+            }
+            return true;
+        }
+
+    } // namespace
+
+    Presence::Presence(QString deviceId, quint16 probePort, quint32 features)
+            : _deviceId(std::move(deviceId)),
+              _probePort(probePort),
+              _features(features),
+              _socket(new QUdpSocket(this)),
+              _timer(new QTimer(this)) {
+        _idleSchedule.emplace(idleOptions());
+        _timer->setSingleShot(true);
+        connect(_socket, &QUdpSocket::readyRead, this, [this]() { readBeacons(); });
+        connect(_timer, &QTimer::timeout, this, [this]() {
+            joinInterfaces();
+            tick();
+            expire();
+        });
+    }
+
+    Presence::~Presence() = default;
+
+    bool Presence::start() {
+        if (!bindGroupPort(*_socket)) {
+            return false;
+        }
+        joinInterfaces();
+        if (_joined.empty() && !_socket->joinMulticastGroup(kGroup)) {
+            qWarning() << "Presence cannot join" << kGroup << ":" << _socket->errorString();
+            return false;
+        }
+        tick();
+        return true;
+    }
+
+    std::optional<PeerAddress> Presence::find(const QString &deviceId) const {
+        auto found = paths(deviceId);
+        if (found.empty()) {
+            return std::nullopt;
+        }
+        return found.front();
+    }
+
+    std::vector<PeerAddress> Presence::paths(const QString &deviceId) const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _peers.find(deviceId);
+        if (it == _peers.end()) {
+            return {};
+        }
+        qint64 now = QDateTime::currentMSecsSinceEpoch();
+        auto measured = _throughput.find(deviceId);
+        std::vector<PeerAddress> result;
+        for (const auto &[name, path] : it->second) {
+            // the device left that network, or altogether
+            if (isStale(path, now)) {
+                continue;
+            }
+            result.push_back(path);
+            if (measured != _throughput.end()) {
+                auto rate = measured->second.find(name);
+                if (rate != measured->second.end()) {
+                    result.back().throughput = rate->second;
+                }
+            }
+        }
+        auto expectedRate = [](const PeerAddress &path) {
+            return path.throughput > 0 ? path.throughput : typicalRate(path.via.type);
+        };
+        std::stable_sort(result.begin(), result.end(), [&](const PeerAddress &left, const PeerAddress &right) {
+            bool leftPreferred = !_preferredInterface.isEmpty() && left.via.name == _preferredInterface;
+            bool rightPreferred = !_preferredInterface.isEmpty() && right.via.name == _preferredInterface;
+            if (leftPreferred != rightPreferred) {
+                return leftPreferred;
+            }
+            if (left.via.name.isEmpty() != right.via.name.isEmpty()) {
+                return right.via.name.isEmpty();
+            }
+            return expectedRate(left) > expectedRate(right);
+        });
+        return result;
+    }
+
+    quint32 Presence::features(const QString &deviceId) const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _peers.find(deviceId);
+        if (it == _peers.end()) {
+            return 0;
+        }
+        qint64 now = QDateTime::currentMSecsSinceEpoch();
+        quint32 features = 0;
+        for (const auto &[name, path] : it->second) {
+            if (!isStale(path, now)) {
+                features |= path.features;
+            }
+        }
+        return features;
+    }
+
+    std::optional<QString> Presence::deviceAt(const QHostAddress &address) const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        qint64 now = QDateTime::currentMSecsSinceEpoch();
+        for (const auto &[deviceId, paths] : _peers) {
+            for (const auto &[name, path] : paths) {
+                // dual stack sockets see IPv4 peers as mapped addresses
+                if (!isStale(path, now) && path.address.isEqual(address, QHostAddress::TolerantConversion)) {
+                    return deviceId;
+                }
+            }
+        }
+        return std::nullopt;
+    }
+
+    void Presence::setPreferredInterface(const QString &name) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _preferredInterface = name;
+    }
+
+    void Presence::setDiscovering(bool discovering) {
+        QMetaObject::invokeMethod(this, [this, discovering]() {
+            if (discovering == _discovering) {
+                return;
+            }
+            _discovering = discovering;
+            if (!discovering) {
+                // back off from the start again
+                _idleSchedule.emplace(idleOptions());
+                return;
+            }
+            _socket->writeDatagram(encode({kQuery, _deviceId, 0}), kGroup, kPort);
+            tick();
+        }, Qt::QueuedConnection);
+    }
+
+    void Presence::recordThroughput(const QString &deviceId, const QString &interfaceName, qint64 bytesPerSecond) {
+        if (bytesPerSecond <= 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        _throughput[deviceId][interfaceName] = bytesPerSecond;
+    }
+
+    void Presence::addPath(const QString &deviceId, PeerAddress peer) {
+        if (peer.via.name.isEmpty()) {
+            if (auto via = interfaceFor(peer.address, 0, localInterfaces())) {
+                peer.via = *via;
+            }
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto &path = _peers[deviceId][peer.via.name];
+        // a ping doesn't say what the device can do, its beacon did
+        peer.features |= path.features;
+        path = peer;
+    }
+
+    void Presence::expire() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        qint64 now = QDateTime::currentMSecsSinceEpoch();
+        for (auto device = _peers.begin(); device != _peers.end();) {
+            auto &paths = device->second;
+            for (auto it = paths.begin(); it != paths.end();) {
+                it = isStale(it->second, now) ? paths.erase(it) : std::next(it);
+            }
+            if (!paths.empty()) {
+                ++device;
+                continue;
+            }
+            _throughput.erase(device->first);
+            device = _peers.erase(device);
+        }
+    }
+
+    void Presence::joinInterfaces() {
+        _interfaces = localInterfaces();
+        // membership goes away with the interface, join again when it's back
+        for (auto it = _joined.begin(); it != _joined.end();) {
+            bool present = std::any_of(_interfaces.begin(), _interfaces.end(), [&](const LocalInterface &iface) {
+                return iface.name == *it;
+            });
+            it = present ? std::next(it) : _joined.erase(it);
+        }
+        for (const auto &iface : _interfaces) {
+            if (_joined.count(iface.name) > 0) {
+                continue;
+            }
+            if (_socket->joinMulticastGroup(kGroup, QNetworkInterface::interfaceFromName(iface.name))) {
+                _joined.insert(iface.name);
+            } else {
+                qWarning() << "Presence cannot join" << kGroup << "on" << iface.name << ":" << _socket->errorString();
+            }
+        }
+    }
+
+    void Presence::tick() {
+        // the schedule opens with a burst, a beacon is never due sooner
+        // than the usual interval
+        int nextMs = _discovering ? kBeaconIntervalMs : std::max(_idleSchedule->next().pauseMs, kBeaconIntervalMs);
+        _timer->start(nextMs);
+        beacon(nextMs);
+    }
+
+    void Presence::beacon(int nextMs) {
+        QByteArray packet = encode({kBeacon, _deviceId, _probePort, _features, quint32(nextMs)});
+        if (_joined.empty()) {
+            _socket->writeDatagram(packet, kGroup, kPort);
+            return;
+        }
+        for (const auto &iface : _interfaces) {
+            if (_joined.count(iface.name) == 0) {
+                continue;
+            }
+            _socket->setMulticastInterface(QNetworkInterface::interfaceFromName(iface.name));
+            _socket->writeDatagram(packet, kGroup, kPort);
+        }
+    }
+
+    void Presence::readBeacons() {
+        while (_socket->hasPendingDatagrams()) {
+            QNetworkDatagram datagram = _socket->receiveDatagram();
+            Message message;
+            if (!decode(datagram.data(), message) || message.deviceId == _deviceId) {
+                continue;
+            }
+            if (message.type == kQuery) {
+                // one answer covers everyone asking at about the same time
+                qint64 now = QDateTime::currentMSecsSinceEpoch();
+                if (now - _lastAnswer >= kQueryIntervalMs) {
+                    _lastAnswer = now;
+                    beacon(std::max(_timer->remainingTime(), 0));
+                }
+                continue;
+            }
+            PeerAddress peer{datagram.senderAddress(), message.probePort, QDateTime::currentMSecsSinceEpoch()};
+            if (auto via = interfaceFor(peer.address, datagram.interfaceIndex(), _interfaces)) {
+                peer.via = *via;
+            }
+            peer.features = message.features;
+            peer.beaconIntervalMs = int(std::min<quint32>(message.intervalMs, kIdleBeaconIntervalMs));
+            std::lock_guard<std::mutex> lock(_mutex);
+            _peers[message.deviceId][peer.via.name] = peer;
+        }
+    }
+
+    std::optional<PeerAddress> Presence::lookup(const QString &deviceId, int timeoutMs) {
+        QUdpSocket socket;
+        if (!joinGroup(socket)) {
+            return std::nullopt;
+        }
+        QElapsedTimer timer;
+        timer.start();
+        while (timer.elapsed() < timeoutMs) {
+            // any instance that hears it beacons right away
+            socket.writeDatagram(encode({kQuery, {}, 0}), kGroup, kPort);
+            QElapsedTimer waited;
+            waited.start();
+            while (waited.elapsed() < kQueryIntervalMs && socket.waitForReadyRead(int(kQueryIntervalMs - waited.elapsed()))) {
+                while (socket.hasPendingDatagrams()) {
+                    QNetworkDatagram datagram = socket.receiveDatagram();
+                    Message message;
+                    if (decode(datagram.data(), message) && message.type == kBeacon && message.deviceId == deviceId) {
+                        PeerAddress peer{datagram.senderAddress(), message.probePort, QDateTime::currentMSecsSinceEpoch()};
+                        if (auto via = interfaceFor(peer.address, datagram.interfaceIndex(), localInterfaces())) {
+                            peer.via = *via;
+                        }
+                        peer.features = message.features;
+                        peer.beaconIntervalMs = int(std::min<quint32>(message.intervalMs, kIdleBeaconIntervalMs));
+                        return peer;
+                    }
+                }
+            }
+        }
+        return std::nullopt;
+    }
+
+} // namespace Transfer
@@ -0,0 +1,132 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include "transfer/discovery_schedule.h"
+#include "transfer/interfaces.h"
+#include "transfer/probe.h"
+
+#include <QHostAddress>
+#include <QObject>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <vector>
+
+class QTimer;
+class QUdpSocket;
+
+namespace Transfer {
+
+    // What an instance can unpack beyond plain flowdrop files, beaconed so
+    // senders only use it with devices that run this client.
+    constexpr quint32 kFeatureSparse = 0x01;
+    constexpr quint32 kFeatureDelta = 0x02;
+    // large files over several connections, see MultipathServer
+    constexpr quint32 kFeatureParallel = 0x04;
+    // one ask for all the chunks of a send, see SessionAsks
+    constexpr quint32 kFeatureSessions = 0x08;
+    // streams sent in chunks, see ChunkAssembler
+    constexpr quint32 kFeatureChunks = 0x10;
+    constexpr quint32 kLocalFeatures = kFeatureSparse | kFeatureDelta | kFeatureParallel | kFeatureSessions | kFeatureChunks;
+
+    struct PeerAddress {
+        QHostAddress address;
+        quint16 probePort = kProbePort;
+        // ms since epoch
+        qint64 lastSeen = 0;
+        // the one the beacon came in on, no name when we couldn't tell
+        LocalInterface via;
+        // kFeature* flags from the beacon, none for a path found otherwise
+        quint32 features = 0;
+        // bytes per second a probe measured over this path, 0 until then
+        qint64 throughput = 0;
+        // until the next beacon, as the device announced it, 0 for the
+        // usual interval
+        int beaconIntervalMs = 0;
+    };
+
+    // flowdrop's discovery doesn't tell where a device is, so every
+    // instance beacons its device id on a multicast group and keeps the
+    // addresses the others beacon from. Beacons go out on every interface,
+    // so a device reachable over several of them is known by an address
+    // per interface. While nothing is being discovered the beacons back
+    // off along a DiscoverySchedule, each one announcing when the next is
+    // due. Runs on the event loop of the thread it lives in, the other
+    // calls can be made from any thread.
+    class Presence : public QObject {
+    public:
+        Presence(QString deviceId, quint16 probePort, quint32 features = kLocalFeatures);
+        ~Presence() override;
+
+        bool start();
+
+        // The path to use: over the preferred interface when the device
+        // is seen there, else the first of paths().
+        [[nodiscard]] std::optional<PeerAddress> find(const QString &deviceId) const;
+
+        // Every path the device was recently seen on, best first: the
+        // preferred interface, then by measured throughput, by the type
+        // of the interface where nothing was measured yet.
+        [[nodiscard]] std::vector<PeerAddress> paths(const QString &deviceId) const;
+
+        // kFeature* flags the device beaconed, none when it never did.
+        [[nodiscard]] quint32 features(const QString &deviceId) const;
+
+        // The device known at address, none for an address no beacon or
+        // ping came from lately. Only says who is there, not who to trust.
+        [[nodiscard]] std::optional<QString> deviceAt(const QHostAddress &address) const;
+
+        // Empty to go by throughput only.
+        void setPreferredInterface(const QString &name);
+
+        // Beacons at the usual interval while a device list is open, and
+        // asks the others to beacon right away when it opens.
+        void setDiscovering(bool discovering);
+
+        // Upload rate a probe measured to the device over interfaceName.
+        void recordThroughput(const QString &deviceId, const QString &interfaceName, qint64 bytesPerSecond);
+
+        // A path found without a beacon, e.g. by pinging a cached address
+        // where multicast doesn't get through.
+        void addPath(const QString &deviceId, PeerAddress peer);
+
+        // Asks the group for deviceId and waits for its beacon, for
+        // callers without a running Presence.
+        [[nodiscard]] static std::optional<PeerAddress> lookup(const QString &deviceId, int timeoutMs);
+
+    private:
+        void joinInterfaces();
+        // Schedules the next beacon and sends this one.
+        void tick();
+        // nextMs is when the one after is due.
+        void beacon(int nextMs);
+        void readBeacons();
+        // Forgets the paths of devices that stopped beaconing.
+        void expire();
+
+        const QString _deviceId;
+        const quint16 _probePort;
+        const quint32 _features;
+        QUdpSocket *_socket;
+        QTimer *_timer;
+        // both on the thread Presence lives in
+        bool _discovering = false;
+        std::optional<DiscoverySchedule> _idleSchedule;
+        qint64 _lastAnswer = 0;
+        std::vector<LocalInterface> _interfaces;
+        std::set<QString> _joined;
+        mutable std::mutex _mutex;
+        QString _preferredInterface;
+        // by device id, then by interface name
+        std::map<QString, std::map<QString, PeerAddress>> _peers;
+        // kept apart from _peers, beacons replace their entries
+        std::map<QString, std::map<QString, qint64>> _throughput;
+    }; // Presence
+
+} // namespace Transfer
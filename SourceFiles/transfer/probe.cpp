@@ -0,0 +1,480 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/probe.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QLocale>
+#include <QNetworkDatagram>
+#include <QRandomGenerator>
+#include <QTcpServer>
+#include <QTimer>
+#include <QTcpSocket>
+#include <QUdpSocket>
+#include <QtEndian>
+#include <cmath>
+#include <map>
+#include <vector>
+
+namespace Transfer {
+
+    namespace {
+
+        constexpr quint32 kMagic = 0x46445052; // FDPR
+        constexpr quint8 kPing = 1;
+        constexpr quint8 kPong = 2;
+        constexpr char kUpload = 'U';
+        constexpr char kDownload = 'D';
+        constexpr int kFrameSize = 64 * 1024;
+        constexpr int kHeaderSize = 4;
+        // keeps the socket busy without queueing seconds of data
+        constexpr qint64 kMaxPending = 4 * kFrameSize;
+        constexpr int kIoTimeoutMs = 5000;
+        constexpr int kMaxDurationMs = 60 * 1000;
+        constexpr int kMaxTests = 2;
+
+        // random, so nothing on the path can compress it
+        const QByteArray &framePayload() {
+            static const QByteArray payload = []() {
+                QByteArray data(kFrameSize, Qt::Uninitialized);
+                QRandomGenerator random(0x46445052);
+                random.fillRange(reinterpret_cast<quint32 *>(data.data()), kFrameSize / int(sizeof(quint32)));
+                return data;
+            }();
+            return payload;
+        }
+
+        QByteArray frameHeader(quint32 length) {
+            QByteArray header(kHeaderSize, Qt::Uninitialized);
+            qToBigEndian(length, header.data());
+            return header;
+        }
+
+        // Reads the frames of one direction and skips their payload.
+        class FrameReader {
+        public:
+            // Returns true once the end frame has been read.
+            bool read(QTcpSocket &socket) {
+                while (true) {
+                    if (_remaining > 0) {
+                        qint64 skipped = socket.skip(std::min<qint64>(_remaining, socket.bytesAvailable()));
+                        if (skipped <= 0) {
+                            return false;
+                        }
+                        _remaining -= skipped;
+                        _bytes += skipped;
+                        continue;
+                    }
+                    if (socket.bytesAvailable() < kHeaderSize) {
+                        return false;
+                    }
+                    if (!_timer.isValid()) {
+                        _timer.start();
+                    }
+                    char header[kHeaderSize];
+                    socket.read(header, kHeaderSize);
+                    _remaining = qFromBigEndian<quint32>(header);
+                    if (_remaining == 0) {
+                        return true;
+                    }
+                }
+            }
+
+            [[nodiscard]] qint64 bytes() const {
+                return _bytes;
+            }
+
+            [[nodiscard]] qint64 elapsedMs() const {
+                return _timer.isValid() ? _timer.elapsed() : 0;
+            }
+
+        private:
+            qint64 _remaining = 0;
+            qint64 _bytes = 0;
+            QElapsedTimer _timer;
+        };
+
+        // One TCP connection of the server, driven by its signals.
+        class Connection : public QObject {
+        public:
+            using Throttle = Fn<qint64(const QHostAddress &, bool, qint64)>;
+
+            Connection(QTcpSocket *socket, Throttle throttle, QObject *parent)
+                    : QObject(parent),
+                      _socket(socket),
+                      _peer(socket->peerAddress()),
+                      _throttle(std::move(throttle)) {
+                _socket->setParent(this);
+                // while paused, what the peer sends waits in its own buffers
+                _socket->setReadBufferSize(kMaxPending);
+                connect(_socket, &QTcpSocket::readyRead, this, [this]() { onReadyRead(); });
+                connect(_socket, &QTcpSocket::bytesWritten, this, [this]() { fill(); });
+                connect(_socket, &QTcpSocket::disconnected, this, &QObject::deleteLater);
+                // a peer that never asks or never goes away holds a slot
+                QTimer::singleShot(kIoTimeoutMs, this, [this]() {
+                    if (_command == 0) {
+                        _socket->abort();
+                    }
+                });
+                QTimer::singleShot(kMaxDurationMs + 2 * kIoTimeoutMs, this, [this]() {
+                    _socket->abort();
+                });
+            }
+
+        private:
+            // Returns true when the test has to wait, it goes on by itself.
+            bool pace(bool upload, qint64 bytes) {
+                qint64 waitMs = _throttle && bytes > 0 ? _throttle(_peer, upload, bytes) : 0;
+                if (waitMs <= 0) {
+                    return false;
+                }
+                _paused = true;
+                QTimer::singleShot(int(waitMs), this, [this]() {
+                    _paused = false;
+                    onReadyRead();
+                    fill();
+                });
+                return true;
+            }
+
+            void onReadyRead() {
+                if (_paused) {
+                    return;
+                }
+                if (_command == 0) {
+                    if (_socket->bytesAvailable() < 5) {
+                        return;
+                    }
+                    char header[5];
+                    _socket->read(header, 5);
+                    _command = header[0];
+                    _durationMs = std::min<int>(int(qFromBigEndian<quint32>(header + 1)), kMaxDurationMs);
+                    if (_command == kDownload) {
+                        _timer.start();
+                        fill();
+                        return;
+                    }
+                }
+                if (_command == kUpload && !_reported) {
+                    qint64 before = _reader.bytes();
+                    bool end = _reader.read(*_socket);
+                    if (end) {
+                        QByteArray report;
+                        QDataStream stream(&report, QIODevice::WriteOnly);
+                        stream << _reader.bytes() << _reader.elapsedMs();
+                        _socket->write(report);
+                        _reported = true;
+                    }
+                    pace(false, _reader.bytes() - before);
+                } else if (_command != kUpload) {
+                    _socket->readAll();
+                }
+            }
+
+            void fill() {
+                if (_command != kDownload || _finished || _paused) {
+                    return;
+                }
+                while (_socket->bytesToWrite() < kMaxPending) {
+                    if (_timer.elapsed() >= _durationMs) {
+                        _socket->write(frameHeader(0));
+                        _finished = true;
+                        return;
+                    }
+                    _socket->write(frameHeader(kFrameSize));
+                    _socket->write(framePayload());
+                    if (pace(true, kHeaderSize + kFrameSize)) {
+                        return;
+                    }
+                }
+            }
+
+            QTcpSocket *_socket;
+            const QHostAddress _peer;
+            const Throttle _throttle;
+            bool _paused = false;
+            char _command = 0;
+            int _durationMs = 0;
+            QElapsedTimer _timer;
+            FrameReader _reader;
+            bool _reported = false;
+            bool _finished = false;
+        };
+
+        QByteArray encodePing(quint8 type, quint32 sequence, qint64 stamp) {
+            QByteArray packet;
+            QDataStream stream(&packet, QIODevice::WriteOnly);
+            stream << kMagic << type << sequence << stamp;
+            return packet;
+        }
+
+        bool bindLocal(QAbstractSocket &socket, const QHostAddress &localAddress) {
+            return localAddress.isNull() ? socket.bind() : socket.bind(localAddress);
+        }
+
+        bool measurePings(const QHostAddress &address, quint16 port, const ProbeOptions &options, ProbeResult &result) {
+            QUdpSocket socket;
+            if (!bindLocal(socket, options.localAddress)) {
+                result.error = socket.errorString();
+                return false;
+            }
+            QElapsedTimer clock;
+            clock.start();
+            std::map<quint32, double> rtts;
+            auto receive = [&](int waitMs) {
+                QElapsedTimer waited;
+                waited.start();
+                while (socket.waitForReadyRead(int(std::max<qint64>(waitMs - waited.elapsed(), 0)))) {
+                    while (socket.hasPendingDatagrams()) {
+                        QDataStream stream(socket.receiveDatagram().data());
+                        quint32 magic, sequence;
+                        quint8 type;
+                        qint64 stamp;
+                        stream >> magic >> type >> sequence >> stamp;
+                        if (stream.status() == QDataStream::Ok && magic == kMagic && type == kPong) {
+                            rtts.try_emplace(sequence, double(clock.nsecsElapsed() - stamp) / 1e6);
+                        }
+                    }
+                    if (waited.elapsed() >= waitMs) {
+                        break;
+                    }
+                }
+            };
+            for (int i = 0; i < options.pings; ++i) {
+                socket.writeDatagram(encodePing(kPing, quint32(i), clock.nsecsElapsed()), address, port);
+                receive(options.pingIntervalMs);
+            }
+            // stragglers
+            receive(500);
+
+            if (rtts.empty()) {
+                result.error = "No answer from the peer";
+                return false;
+            }
+            double sum = 0;
+            double jitter = 0;
+            double previous = -1;
+            for (const auto &[sequence, rtt] : rtts) {
+                sum += rtt;
+                if (previous >= 0) {
+                    jitter += std::abs(rtt - previous);
+                }
+                previous = rtt;
+            }
+            result.rttMs = sum / double(rtts.size());
+            result.jitterMs = rtts.size() > 1 ? jitter / double(rtts.size() - 1) : 0;
+            result.loss = 1 - double(rtts.size()) / options.pings;
+            return true;
+        }
+
+        bool connectProbe(QTcpSocket &socket, const QHostAddress &address, quint16 port, char command, const ProbeOptions &options, ProbeResult &result) {
+            if (!options.localAddress.isNull() && !socket.bind(options.localAddress)) {
+                result.error = socket.errorString();
+                return false;
+            }
+            socket.connectToHost(address, port);
+            if (!socket.waitForConnected(kIoTimeoutMs)) {
+                result.error = socket.errorString();
+                return false;
+            }
+            char header[5];
+            header[0] = command;
+            qToBigEndian(quint32(options.durationMs), header + 1);
+            socket.write(header, 5);
+            return true;
+        }
+
+        bool measureUpload(const QHostAddress &address, quint16 port, const ProbeOptions &options, ProbeResult &result) {
+            QTcpSocket socket;
+            if (!connectProbe(socket, address, port, kUpload, options, result)) {
+                return false;
+            }
+            QElapsedTimer timer;
+            timer.start();
+            while (timer.elapsed() < options.durationMs) {
+                if (socket.bytesToWrite() < kMaxPending) {
+                    socket.write(frameHeader(kFrameSize));
+                    socket.write(framePayload());
+                } else if (!socket.waitForBytesWritten(kIoTimeoutMs)) {
+                    result.error = socket.errorString();
+                    return false;
+                }
+            }
+            socket.write(frameHeader(0));
+            while (socket.bytesToWrite() > 0) {
+                if (!socket.waitForBytesWritten(kIoTimeoutMs)) {
+                    result.error = socket.errorString();
+                    return false;
+                }
+            }
+            // the receiver's count, what sits in our socket buffer doesn't
+            // count as sent
+            while (socket.bytesAvailable() < 16) {
+                if (!socket.waitForReadyRead(kIoTimeoutMs)) {
+                    result.error = "No upload report from the peer";
+                    return false;
+                }
+            }
+            QDataStream stream(&socket);
+            qint64 bytes, elapsedMs;
+            stream >> bytes >> elapsedMs;
+            result.upload = elapsedMs > 0 ? bytes * 1000 / elapsedMs : 0;
+            return true;
+        }
+
+        bool measureDownload(const QHostAddress &address, quint16 port, const ProbeOptions &options, ProbeResult &result) {
+            QTcpSocket socket;
+            if (!connectProbe(socket, address, port, kDownload, options, result)) {
+                return false;
+            }
+            FrameReader reader;
+            while (!reader.read(socket)) {
+                if (!socket.waitForReadyRead(kIoTimeoutMs)) {
+                    result.error = socket.errorString();
+                    return false;
+                }
+            }
+            result.download = reader.elapsedMs() > 0 ? reader.bytes() * 1000 / reader.elapsedMs() : 0;
+            return true;
+        }
+
+    } // namespace
+
+    ProbeResult probePeer(const QHostAddress &address, quint16 port, const ProbeOptions &options) {
+        ProbeResult result;
+        result.ok = measurePings(address, port, options, result)
+                && measureUpload(address, port, options, result)
+                && measureDownload(address, port, options, result);
+        if (!result.ok) {
+            qWarning() << "Probe of" << address << "failed:" << result.error;
+        }
+        return result;
+    }
+
+    void pingPeers(
+            const std::vector<PingTarget> &targets,
+            int timeoutMs,
+            const Fn<void(std::size_t)> &answered,
+            const QHostAddress &localAddress) {
+        constexpr int kResendMs = 200;
+
+        QUdpSocket socket;
+        if (targets.empty() || !bindLocal(socket, localAddress)) {
+            return;
+        }
+        std::vector<bool> done(targets.size());
+        std::size_t remaining = targets.size();
+        QElapsedTimer clock;
+        clock.start();
+        QElapsedTimer sinceSent;
+        while (remaining > 0 && clock.elapsed() < timeoutMs) {
+            if (!sinceSent.isValid() || sinceSent.elapsed() >= kResendMs) {
+                // the sequence tells which target answered
+                for (std::size_t i = 0; i < targets.size(); ++i) {
+                    if (!done[i]) {
+                        socket.writeDatagram(encodePing(kPing, quint32(i), clock.nsecsElapsed()), targets[i].address, targets[i].port);
+                    }
+                }
+                sinceSent.start();
+            }
+            auto waitMs = int(std::min<qint64>(kResendMs - sinceSent.elapsed(), timeoutMs - clock.elapsed()));
+            if (waitMs <= 0 || !socket.waitForReadyRead(waitMs)) {
+                continue;
+            }
+            while (socket.hasPendingDatagrams()) {
+                QNetworkDatagram datagram = socket.receiveDatagram();
+                QDataStream stream(datagram.data());
+                quint32 magic, sequence;
+                quint8 type;
+                qint64 stamp;
+                stream >> magic >> type >> sequence >> stamp;
+                if (stream.status() != QDataStream::Ok || magic != kMagic || type != kPong
+                    || sequence >= targets.size() || done[sequence]) {
+                    continue;
+                }
+                // only the target itself answers for it, the sequence is
+                // easy to guess
+                const PingTarget &target = targets[sequence];
+                if (datagram.senderAddress().isEqual(target.address, QHostAddress::TolerantConversion)
+                    && datagram.senderPort() == target.port) {
+                    done[sequence] = true;
+                    --remaining;
+                    answered(sequence);
+                }
+            }
+        }
+    }
+
+    bool pingPeer(const QHostAddress &address, quint16 port, int timeoutMs, const QHostAddress &localAddress) {
+        bool reachable = false;
+        pingPeers({{address, port}}, timeoutMs, [&](std::size_t) {
+            reachable = true;
+        }, localAddress);
+        return reachable;
+    }
+
+    QString formatProbeResult(const ProbeResult &result) {
+        if (!result.ok) {
+            return result.error;
+        }
+        QLocale locale;
+        return QString("RTT %1 ms ± %2, ↑ %3/s, ↓ %4/s")
+                .arg(result.rttMs, 0, 'f', 1)
+                .arg(result.jitterMs, 0, 'f', 1)
+                .arg(locale.formattedDataSize(result.upload), locale.formattedDataSize(result.download));
+    }
+
+    ProbeServer::ProbeServer()
+            : _udp(new QUdpSocket(this)),
+              _tcp(new QTcpServer(this)) {
+        connect(_udp, &QUdpSocket::readyRead, this, [this]() { readPings(); });
+        connect(_tcp, &QTcpServer::newConnection, this, [this]() { acceptTests(); });
+    }
+
+    void ProbeServer::acceptTests() {
+        while (QTcpSocket *socket = _tcp->nextPendingConnection()) {
+            if (_tests >= kMaxTests || (_authorize && !_authorize(socket->peerAddress()))) {
+                qInfo() << "Probe server: refused a test from" << socket->peerAddress();
+                socket->abort();
+                socket->deleteLater();
+                continue;
+            }
+            ++_tests;
+            auto *connection = new Connection(socket, _throttle, this);
+            connect(connection, &QObject::destroyed, this, [this]() {
+                --_tests;
+            });
+        }
+    }
+
+    ProbeServer::~ProbeServer() = default;
+
+    bool ProbeServer::listen(quint16 port) {
+        if (!_udp->bind(QHostAddress::Any, port) || !_tcp->listen(QHostAddress::Any, port)) {
+            qWarning() << "Probe server cannot listen on" << port << ":" << _udp->errorString() << _tcp->errorString();
+            return false;
+        }
+        return true;
+    }
+
+    void ProbeServer::readPings() {
+        while (_udp->hasPendingDatagrams()) {
+            QNetworkDatagram datagram = _udp->receiveDatagram();
+            QDataStream stream(datagram.data());
+            quint32 magic, sequence;
+            quint8 type;
+            qint64 stamp;
+            stream >> magic >> type >> sequence >> stamp;
+            if (stream.status() == QDataStream::Ok && magic == kMagic && type == kPing) {
+                _udp->writeDatagram(encodePing(kPong, sequence, stamp), datagram.senderAddress(), quint16(datagram.senderPort()));
+            }
+        }
+    }
+
+} // namespace Transfer
@@ -0,0 +1,104 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include "base_util.h"
+
+#include <QHostAddress>
+#include <QObject>
+#include <QString>
+#include <vector>
+
+class QTcpServer;
+class QUdpSocket;
+
+namespace Transfer {
+
+    constexpr quint16 kProbePort = 45471;
+
+    struct ProbeOptions {
+        int pings = 20;
+        int pingIntervalMs = 50;
+        // per direction
+        int durationMs = 3000;
+        // binds our side to the address of one interface, null lets the
+        // system pick
+        QHostAddress localAddress;
+    };
+
+    struct ProbeResult {
+        bool ok = false;
+        QString error;
+        double rttMs = 0;
+        // mean difference between consecutive round trips
+        double jitterMs = 0;
+        double loss = 0;
+        // bytes per second
+        qint64 upload = 0;
+        qint64 download = 0;
+    };
+
+    // Measures the link to a peer's ProbeServer: RTT, jitter and loss from
+    // UDP echoes, then sustained TCP throughput each way. The data is
+    // generated in memory on both sides, so disks don't take part.
+    // Blocks for about twice the duration.
+    [[nodiscard]] ProbeResult probePeer(const QHostAddress &address, quint16 port, const ProbeOptions &options = {});
+
+    struct PingTarget {
+        QHostAddress address;
+        quint16 port = kProbePort;
+    };
+
+    // Only checks that the peers' ProbeServers answer. Pings all targets
+    // at once and resends to the quiet ones until they answer or
+    // timeoutMs runs out; answered gets a target's index as soon as its
+    // first answer comes in.
+    void pingPeers(
+            const std::vector<PingTarget> &targets,
+            int timeoutMs,
+            const Fn<void(std::size_t)> &answered,
+            const QHostAddress &localAddress = {});
+
+    [[nodiscard]] bool pingPeer(const QHostAddress &address, quint16 port, int timeoutMs, const QHostAddress &localAddress = {});
+
+    [[nodiscard]] QString formatProbeResult(const ProbeResult &result);
+
+    // Answers probePeer() on UDP and TCP of the same port. Runs on the
+    // event loop of the thread it lives in. Only a couple of throughput
+    // tests run at a time, the others are refused.
+    class ProbeServer : public QObject {
+    public:
+        ProbeServer();
+        ~ProbeServer() override;
+
+        // Decides which peers get a throughput test, pings are answered
+        // for everyone. Everyone is served when not set.
+        void setAuthorize(Fn<bool(const QHostAddress &)> authorize) {
+            _authorize = std::move(authorize);
+        }
+
+        // Called with the size of every frame sent (upload) or read
+        // (download), returns how many milliseconds the test has to pause.
+        // Runs on the event loop, it must not block.
+        void setThrottle(Fn<qint64(const QHostAddress &, bool upload, qint64 bytes)> throttle) {
+            _throttle = std::move(throttle);
+        }
+
+        bool listen(quint16 port = kProbePort);
+
+    private:
+        void readPings();
+        void acceptTests();
+
+        QUdpSocket *_udp;
+        QTcpServer *_tcp;
+        Fn<bool(const QHostAddress &)> _authorize;
+        Fn<qint64(const QHostAddress &, bool, qint64)> _throttle;
+        int _tests = 0;
+    }; // ProbeServer
+
+} // namespace Transfer
@@ -0,0 +1,120 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/receive_admission.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QStorageInfo>
+#include <algorithm>
+#include <utility>
+
+namespace Transfer {
+
+    namespace {
+
+        // left free for the containers unpacked next to received files
+        constexpr qint64 kSpaceMargin = 64 * 1024 * 1024;
+
+        qint64 availableSpace(const QString &destDir) {
+            QDir dir(destDir);
+            // QStorageInfo wants an existing path, the destination is
+            // created by the server on the first transfer
+            while (!dir.exists() && dir.cdUp()) {}
+            QStorageInfo storage(dir.path());
+            return storage.isValid() ? storage.bytesAvailable() : -1;
+        }
+
+    } // namespace
+
+    void ReceiveAdmission::setLimits(const AdmissionLimits &limits) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _limits = limits;
+        _changed.notify_all();
+    }
+
+    bool ReceiveAdmission::fits(qint64 size) const {
+        // a session bigger than the byte limit can still run alone
+        if (_active.empty()) {
+            return true;
+        }
+        if (_limits.sessions > 0 && int(_active.size()) >= _limits.sessions) {
+            return false;
+        }
+        return _limits.bytes <= 0 || _activeBytes + size <= _limits.bytes;
+    }
+
+    ReceiveAdmission::Ticket::Ticket(Ticket &&other) noexcept
+            : _admission(std::exchange(other._admission, nullptr)), _id(other._id) {
+    }
+
+    ReceiveAdmission::Ticket &ReceiveAdmission::Ticket::operator=(Ticket &&other) noexcept {
+        if (this != &other) {
+            reset();
+            _admission = std::exchange(other._admission, nullptr);
+            _id = other._id;
+        }
+        return *this;
+    }
+
+    ReceiveAdmission::Ticket::~Ticket() {
+        reset();
+    }
+
+    void ReceiveAdmission::Ticket::reset() {
+        if (_admission) {
+            std::exchange(_admission, nullptr)->release(_id);
+        }
+    }
+
+    bool ReceiveAdmission::fitsOnDisk(qint64 size, const QString &destDir) {
+        qint64 available = availableSpace(destDir);
+        return available < 0 || size + kSpaceMargin <= available;
+    }
+
+    ReceiveAdmission::Ticket ReceiveAdmission::admit(qint64 announcedSize, const QString &destDir) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        const quint64 arrival = _nextArrival++;
+        for (;;) {
+            _changed.wait(lock, [&]() { return arrival == _serving && fits(announcedSize); });
+
+            // running sessions have not written everything they announced
+            // yet, wait for them before deciding the disk is too small
+            qint64 available = availableSpace(destDir);
+            if (available < 0 || announcedSize + _activeBytes + kSpaceMargin <= available) {
+                break;
+            }
+            if (_active.empty() || announcedSize + kSpaceMargin > available) {
+                qWarning() << "Not enough space to receive" << announcedSize << "bytes, available:" << available;
+                ++_serving;
+                _changed.notify_all();
+                return {};
+            }
+            _changed.wait(lock, [&]() { return _active.empty(); });
+        }
+
+        _active.push_back({arrival, announcedSize});
+        _activeBytes += announcedSize;
+        ++_serving;
+        _changed.notify_all();
+        return {this, arrival};
+    }
+
+    void ReceiveAdmission::release(quint64 id) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = std::find_if(_active.begin(), _active.end(), [&](const Session &session) {
+            return session.id == id;
+        });
+        if (it == _active.end()) {
+            return;
+        }
+        _activeBytes -= it->size;
+        _active.erase(it);
+        _changed.notify_all();
+    }
+
+} // namespace Transfer
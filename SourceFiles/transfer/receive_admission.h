@@ -0,0 +1,83 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include <QString>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+namespace Transfer {
+
+    // 0 means unlimited
+    struct AdmissionLimits {
+        int sessions = 0;
+        qint64 bytes = 0;
+    };
+
+    // Decides when an accepted incoming transfer may start writing. Sessions
+    // over the limits wait in arrival order instead of interleaving their
+    // writes, and transfers that can't fit on the disk are refused.
+    class ReceiveAdmission {
+    public:
+        // Holds the place of an admitted session, the session is released
+        // when the ticket goes away. Empty when it wasn't admitted.
+        class Ticket {
+        public:
+            Ticket() = default;
+            Ticket(Ticket &&other) noexcept;
+            Ticket &operator=(Ticket &&other) noexcept;
+            Ticket(const Ticket &) = delete;
+            Ticket &operator=(const Ticket &) = delete;
+            ~Ticket();
+
+            explicit operator bool() const {
+                return _admission != nullptr;
+            }
+
+        private:
+            friend class ReceiveAdmission;
+
+            Ticket(ReceiveAdmission *admission, quint64 id) : _admission(admission), _id(id) {
+            }
+
+            void reset();
+
+            ReceiveAdmission *_admission = nullptr;
+            quint64 _id = 0;
+        };
+
+        void setLimits(const AdmissionLimits &limits);
+
+        // Blocks until the session fits, the ticket is empty when it can't
+        // fit on the disk.
+        [[nodiscard]] Ticket admit(qint64 announcedSize, const QString &destDir);
+
+        // Whether size could fit on the disk of destDir at all, for sends
+        // admitted in parts.
+        [[nodiscard]] static bool fitsOnDisk(qint64 size, const QString &destDir);
+
+    private:
+        struct Session {
+            quint64 id = 0;
+            qint64 size = 0;
+        };
+
+        [[nodiscard]] bool fits(qint64 size) const;
+
+        void release(quint64 id);
+
+        std::mutex _mutex;
+        std::condition_variable _changed;
+        AdmissionLimits _limits;
+        std::vector<Session> _active;
+        qint64 _activeBytes = 0;
+        quint64 _nextArrival = 0;
+        quint64 _serving = 0;
+    }; // ReceiveAdmission
+
+} // namespace Transfer
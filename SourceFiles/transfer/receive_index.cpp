@@ -0,0 +1,177 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/receive_index.h"
+
+#include "platform/platform_files.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+
+namespace Transfer {
+
+    namespace {
+
+        QByteArray contentHash(const QString &filePath) {
+            QFile file(filePath);
+            if (!file.open(QIODevice::ReadOnly)) {
+                return {};
+            }
+            QCryptographicHash hash(QCryptographicHash::Sha256);
+            if (!hash.addData(&file)) {
+                return {};
+            }
+            return hash.result();
+        }
+
+        bool replaceWithCopyOf(const QString &original, const QString &filePath, DedupMode mode) {
+            QString tmpPath = filePath + ".fddedup";
+            QFile::remove(tmpPath);
+            bool linked = Platform::Files::cloneFile(original, tmpPath);
+            if (!linked && mode == DedupMode::HardLink) {
+                linked = Platform::Files::hardLink(original, tmpPath);
+            }
+            if (!linked) {
+                return false;
+            }
+            QFile::remove(filePath);
+            return QFile::rename(tmpPath, filePath);
+        }
+
+    } // namespace
+
+    ReceiveIndex::ReceiveIndex(const QString &indexPath) : _indexPath(indexPath) {
+        _worker = std::thread([this]() {
+            work();
+        });
+    }
+
+    ReceiveIndex::~ReceiveIndex() {
+        {
+            std::lock_guard<std::mutex> lock(_queueMutex);
+            _stopping = true;
+            _pending.clear();
+        }
+        _queued.notify_all();
+        _worker.join();
+    }
+
+    bool ReceiveIndex::isCurrent(const Entry &entry) {
+        QFileInfo info(entry.path);
+        return info.isFile()
+               && info.size() == entry.size
+               && info.lastModified().toMSecsSinceEpoch() == entry.modified;
+    }
+
+    void ReceiveIndex::load() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        QFile file(_indexPath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return;
+        }
+        QDataStream stream(&file);
+        while (!stream.atEnd()) {
+            QByteArray hash;
+            Entry entry;
+            stream >> hash >> entry.path >> entry.size >> entry.modified;
+            if (stream.status() != QDataStream::Ok) {
+                break;
+            }
+            _entries.insert(hash, entry);
+            ++_records;
+        }
+        file.close();
+
+        _entries.removeIf([](const QHash<QByteArray, Entry>::iterator it) {
+            return !isCurrent(it.value());
+        });
+        if (_records > _entries.size()) {
+            rewrite();
+        }
+    }
+
+    void ReceiveIndex::add(const QString &filePath, DedupMode mode) {
+        if (mode == DedupMode::Off) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(_queueMutex);
+            _pending.push_back({filePath, mode});
+        }
+        _queued.notify_one();
+    }
+
+    void ReceiveIndex::work() {
+        while (true) {
+            Pending pending;
+            {
+                std::unique_lock<std::mutex> lock(_queueMutex);
+                _queued.wait(lock, [this]() {
+                    return _stopping || !_pending.empty();
+                });
+                if (_stopping) {
+                    return;
+                }
+                pending = std::move(_pending.front());
+                _pending.pop_front();
+            }
+            process(pending);
+        }
+    }
+
+    void ReceiveIndex::process(const Pending &pending) {
+        const QString &filePath = pending.filePath;
+        QFileInfo info(filePath);
+        Entry entry{filePath, info.size(), info.lastModified().toMSecsSinceEpoch()};
+        QByteArray hash = contentHash(filePath);
+        // it may have changed while it waited or was hashed, the hash
+        // would then be of something else
+        if (hash.isEmpty() || !isCurrent(entry)) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _entries.find(hash);
+        if (it != _entries.end() && it->path != filePath && isCurrent(*it)) {
+            if (replaceWithCopyOf(it->path, filePath, pending.mode)) {
+                qInfo() << "Deduplicated" << filePath << "with" << it->path;
+            }
+            return;
+        }
+
+        _entries.insert(hash, entry);
+        append(hash, entry);
+    }
+
+    bool ReceiveIndex::append(const QByteArray &hash, const Entry &entry) {
+        QFile file(_indexPath);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            return false;
+        }
+        QDataStream stream(&file);
+        stream << hash << entry.path << entry.size << entry.modified;
+        ++_records;
+        return stream.status() == QDataStream::Ok;
+    }
+
+    void ReceiveIndex::rewrite() {
+        QFile file(_indexPath);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            return;
+        }
+        QDataStream stream(&file);
+        for (auto it = _entries.constBegin(); it != _entries.constEnd(); ++it) {
+            stream << it.key() << it->path << it->size << it->modified;
+        }
+        _records = _entries.size();
+    }
+
+} // namespace Transfer
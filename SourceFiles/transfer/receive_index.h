@@ -0,0 +1,79 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace Transfer {
+
+    enum class DedupMode {
+        Off,
+        Reflink,
+        // Reflink first, hard link when the filesystem can't clone. Hard
+        // linked copies share one inode: editing one in place changes all
+        // of them, and so do permission changes.
+        HardLink
+    };
+
+    // Content hash index of everything received so far. A file whose content
+    // is already present somewhere in the index is turned into a clone of
+    // that copy, so repeated transfers of the same data don't take disk space.
+    // The index is an append-only log that is compacted on load.
+    //
+    // Hashing runs on a thread of its own, receiving doesn't wait for it.
+    class ReceiveIndex {
+    public:
+        explicit ReceiveIndex(const QString &indexPath);
+        // Drops what wasn't hashed yet.
+        ~ReceiveIndex();
+
+        void load();
+
+        // Queues the file, it is hashed and deduplicated later.
+        void add(const QString &filePath, DedupMode mode);
+
+    private:
+        struct Entry {
+            QString path;
+            qint64 size = 0;
+            qint64 modified = 0;
+        };
+
+        struct Pending {
+            QString filePath;
+            DedupMode mode = DedupMode::Off;
+        };
+
+        [[nodiscard]] static bool isCurrent(const Entry &entry);
+
+        void work();
+
+        void process(const Pending &pending);
+
+        bool append(const QByteArray &hash, const Entry &entry);
+
+        void rewrite();
+
+        std::mutex _mutex;
+        QString _indexPath;
+        QHash<QByteArray, Entry> _entries;
+        qint64 _records = 0;
+
+        std::mutex _queueMutex;
+        std::condition_variable _queued;
+        std::deque<Pending> _pending;
+        bool _stopping = false;
+        std::thread _worker;
+    }; // ReceiveIndex
+
+} // namespace Transfer
@@ -0,0 +1,78 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/receive_sessions.h"
+
+#include <QDebug>
+#include <algorithm>
+
+namespace Transfer {
+
+    void ReceiveSessions::open(const flowdrop::SendAsk &sendAsk, ReceiveAdmission::Ticket ticket) {
+        Session session;
+        session.senderId = sendAsk.sender.id;
+        for (const auto &file : sendAsk.files) {
+            session.fileNames.insert(file.name);
+        }
+        session.ticket = std::move(ticket);
+        std::lock_guard<std::mutex> lock(_mutex);
+        _sessions.push_back(std::move(session));
+    }
+
+    std::list<ReceiveSessions::Session>::iterator ReceiveSessions::find(const std::string &senderId, const std::string &fileName) {
+        // the oldest first, a sender may send the same names again once
+        // the first receive is over
+        auto it = std::find_if(_sessions.begin(), _sessions.end(), [&](const Session &session) {
+            return session.senderId == senderId && session.fileNames.count(fileName) > 0;
+        });
+        if (it != _sessions.end()) {
+            return it;
+        }
+        return std::find_if(_sessions.begin(), _sessions.end(), [&](const Session &session) {
+            return session.senderId == senderId;
+        });
+    }
+
+    void ReceiveSessions::touch(const std::string &senderId, const std::string &fileName) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = find(senderId, fileName);
+        if (it != _sessions.end()) {
+            it->lastActive = std::chrono::steady_clock::now();
+        }
+    }
+
+    void ReceiveSessions::close(const std::string &senderId, const std::vector<flowdrop::FileInfo> &files) {
+        Session ended;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto it = find(senderId, files.empty() ? std::string() : files.front().name);
+            if (it == _sessions.end()) {
+                return;
+            }
+            ended = std::move(*it);
+            _sessions.erase(it);
+        }
+        // the ticket is released here, outside the lock
+    }
+
+    std::vector<ReceiveSessions::Session> ReceiveSessions::expire(qint64 maxIdleMs) {
+        std::vector<Session> expired;
+        auto deadline = std::chrono::steady_clock::now() - std::chrono::milliseconds(maxIdleMs);
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto it = _sessions.begin(); it != _sessions.end();) {
+            if (it->lastActive < deadline) {
+                qInfo() << "Receive from" << QString::fromStdString(it->senderId) << "went idle, releasing it";
+                expired.push_back(std::move(*it));
+                it = _sessions.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        return expired;
+    }
+
+} // namespace Transfer
@@ -0,0 +1,54 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include "flowdrop/flowdrop.hpp"
+#include "transfer/receive_admission.h"
+
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace Transfer {
+
+    // Ties the receives of the flowdrop server to the asks they were
+    // accepted with. flowdrop reports neither which ask a receive belongs
+    // to nor that the sender broke it off, so receives are matched by
+    // sender and file names, and a session without progress for a while
+    // is taken as broken off.
+    class ReceiveSessions {
+    public:
+        struct Session {
+            std::string senderId;
+            std::unordered_set<std::string> fileNames;
+            ReceiveAdmission::Ticket ticket;
+            std::chrono::steady_clock::time_point lastActive = std::chrono::steady_clock::now();
+        };
+
+        // Holds the ticket until the receive of sendAsk ends.
+        void open(const flowdrop::SendAsk &sendAsk, ReceiveAdmission::Ticket ticket);
+
+        void touch(const std::string &senderId, const std::string &fileName);
+
+        // Ends the receive from senderId that carried files.
+        void close(const std::string &senderId, const std::vector<flowdrop::FileInfo> &files);
+
+        // Ends the sessions idle for longer than maxIdleMs and returns them
+        // for cleanup, their tickets go with them.
+        std::vector<Session> expire(qint64 maxIdleMs);
+
+    private:
+        std::list<Session>::iterator find(const std::string &senderId, const std::string &fileName);
+
+        std::mutex _mutex;
+        std::list<Session> _sessions;
+    }; // ReceiveSessions
+
+} // namespace Transfer
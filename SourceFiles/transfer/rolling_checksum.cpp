@@ -0,0 +1,65 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/rolling_checksum.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FLOWDROP_ROLLING_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Transfer {
+
+    namespace {
+
+        // b = sum((length - i) * x[i]) is split per 16-byte lane as
+        // (length - offset) * sum(x) - sum(j * x[offset + j]), so both sums
+        // can be taken with SAD and multiply-add.
+        void sumBlock(const std::uint8_t *data, std::size_t length, std::uint32_t &a, std::uint32_t &b) {
+            a = 0;
+            b = 0;
+            std::size_t i = 0;
+#ifdef FLOWDROP_ROLLING_SSE2
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i weightsLo = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+            const __m128i weightsHi = _mm_setr_epi16(8, 9, 10, 11, 12, 13, 14, 15);
+            for (; i + 16 <= length; i += 16) {
+                const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+                const __m128i sad = _mm_sad_epu8(bytes, zero);
+                const auto sum = static_cast<std::uint32_t>(_mm_cvtsi128_si32(sad) + _mm_extract_epi16(sad, 4));
+
+                const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+                const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+                __m128i weighted = _mm_add_epi32(_mm_madd_epi16(lo, weightsLo), _mm_madd_epi16(hi, weightsHi));
+                weighted = _mm_add_epi32(weighted, _mm_shuffle_epi32(weighted, _MM_SHUFFLE(1, 0, 3, 2)));
+                weighted = _mm_add_epi32(weighted, _mm_shuffle_epi32(weighted, _MM_SHUFFLE(2, 3, 0, 1)));
+                const auto weightedSum = static_cast<std::uint32_t>(_mm_cvtsi128_si32(weighted));
+
+                a += sum;
+                b += static_cast<std::uint32_t>(length - i) * sum - weightedSum;
+            }
+#endif
+            for (; i < length; ++i) {
+                a += data[i];
+                b += static_cast<std::uint32_t>(length - i) * data[i];
+            }
+        }
+
+    } // namespace
+
+    void RollingChecksum::reset(const std::uint8_t *data, std::size_t length) {
+        _length = length;
+        sumBlock(data, length, _a, _b);
+    }
+
+    std::uint32_t weakChecksum(const std::uint8_t *data, std::size_t length) {
+        RollingChecksum checksum;
+        checksum.reset(data, length);
+        return checksum.value();
+    }
+
+} // namespace Transfer
@@ -0,0 +1,39 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Transfer {
+
+    // rsync-style weak checksum of a block: low 16 bits hold the plain byte
+    // sum, high 16 bits hold the position-weighted sum.
+    class RollingChecksum {
+    public:
+        // Computes the checksum of data[0, length) from scratch.
+        void reset(const std::uint8_t *data, std::size_t length);
+
+        // Slides the window one byte forward.
+        void roll(std::uint8_t out, std::uint8_t in) {
+            _a += in - out;
+            _b += _a - static_cast<std::uint32_t>(_length) * out;
+        }
+
+        [[nodiscard]] std::uint32_t value() const {
+            return (_a & 0xffff) | (_b << 16);
+        }
+
+    private:
+        std::uint32_t _a = 0;
+        std::uint32_t _b = 0;
+        std::size_t _length = 0;
+    }; // RollingChecksum
+
+    [[nodiscard]] std::uint32_t weakChecksum(const std::uint8_t *data, std::size_t length);
+
+} // namespace Transfer
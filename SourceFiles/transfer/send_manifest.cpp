@@ -0,0 +1,197 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/send_manifest.h"
+
+#include <QFileInfo>
+#include <sstream>
+
+namespace Transfer {
+
+    QString SendSession::token() const {
+        return id + "." + QString::number(files) + "." + QString::number(bytes);
+    }
+
+    std::optional<SendSession> SendSession::parse(const QString &token) {
+        QStringList parts = token.split('.');
+        if (parts.size() != 3 || parts[0].isEmpty()) {
+            return std::nullopt;
+        }
+        SendSession session;
+        bool filesOk, bytesOk;
+        session.id = parts[0];
+        session.files = parts[1].toULongLong(&filesOk);
+        session.bytes = parts[2].toULongLong(&bytesOk);
+        if (!filesOk || !bytesOk) {
+            return std::nullopt;
+        }
+        return session;
+    }
+
+    SessionMarker::SessionMarker(const QString &token)
+            : _relativePath(("." + token + kSessionSuffix).toStdString()) {
+    }
+
+    std::string SessionMarker::getRelativePath() const {
+        return _relativePath;
+    }
+
+    std::uint64_t SessionMarker::getSize() const {
+        return 0;
+    }
+
+    // removed once received, the times don't matter
+    std::uint64_t SessionMarker::getCreatedTime() const {
+        return 0;
+    }
+
+    std::uint64_t SessionMarker::getModifiedTime() const {
+        return 0;
+    }
+
+    std::uint32_t SessionMarker::getPermissions() const {
+        return 0644;
+    }
+
+    std::istream *SessionMarker::createStream() {
+        return new std::istringstream(std::string());
+    }
+
+    SendManifest::SendManifest(const QStringList &paths, std::size_t chunkSize)
+            : _paths(paths),
+              _arena(chunkSize) {
+    }
+
+    void SendManifest::setSessionToken(const QString &token) {
+        _sessionMarker = token.isEmpty() ? nullptr : std::make_unique<SessionMarker>(token);
+    }
+
+    bool SendManifest::nextChunk(std::vector<flowdrop::File *> &chunk) {
+        chunk.clear();
+        _arena.reset();
+
+        QString filePath;
+        QString relativePath;
+        while (!_arena.full() && nextEntry(filePath, relativePath)) {
+            if (_entryFilter && !_entryFilter(filePath, relativePath)) {
+                continue;
+            }
+            SourceFile *file = _arena.create(filePath, relativePath, _sparse);
+            file->setThrottle(_throttle);
+            chunk.push_back(file);
+        }
+        _totalFiles += chunk.size();
+        if (chunk.empty()) {
+            return false;
+        }
+        if (_sessionMarker) {
+            chunk.push_back(_sessionMarker.get());
+        }
+        return true;
+    }
+
+    bool SendManifest::nextEntry(QString &filePath, QString &relativePath) {
+        while (true) {
+            if (_dirIterator) {
+                if (_dirIterator->hasNext()) {
+                    filePath = _dirIterator->next();
+                    relativePath = _dirBase.relativeFilePath(filePath);
+                    return true;
+                }
+                _dirIterator.reset();
+            }
+
+            if (_pathIndex >= _paths.size()) {
+                return false;
+            }
+
+            QFileInfo info(_paths[_pathIndex++]);
+            if (info.isDir()) {
+                // keep the selected folder name as the first path component
+                QDir dir(info.absoluteFilePath());
+                _dirBase = dir;
+                if (_baseDir.isEmpty()) {
+                    _dirBase.cdUp();
+                } else {
+                    _dirBase.setPath(_baseDir);
+                }
+                _dirIterator = std::make_unique<QDirIterator>(
+                        dir.absolutePath(),
+                        QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot,
+                        QDirIterator::Subdirectories);
+                continue;
+            }
+            if (info.isFile()) {
+                filePath = info.absoluteFilePath();
+                relativePath = _baseDir.isEmpty() ? info.fileName() : QDir(_baseDir).relativeFilePath(filePath);
+                return true;
+            }
+        }
+    }
+
+    QString SessionAsks::sessionOf(const flowdrop::SendAsk &sendAsk) {
+        // the marker goes last
+        QString token;
+        for (auto it = sendAsk.files.rbegin(); it != sendAsk.files.rend(); ++it) {
+            if (isMarker(QString::fromStdString(it->name), token)) {
+                return token;
+            }
+        }
+        return {};
+    }
+
+    bool SessionAsks::isMarker(const QString &relativePath, QString &token) {
+        if (!relativePath.startsWith('.') || !relativePath.endsWith(kSessionSuffix) || relativePath.contains('/')) {
+            return false;
+        }
+        token = relativePath.mid(1, relativePath.size() - 1 - kSessionSuffix.size());
+        return SendSession::parse(token).has_value();
+    }
+
+    bool SessionAsks::ask(const std::string &senderId, const QString &token, const Fn<bool()> &prompt) {
+        if (token.isEmpty()) {
+            return prompt();
+        }
+        // keyed by sender too, an id seen on the network lets nobody else in
+        std::string key = senderId + "/" + token.toStdString();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto it = _sessions.find(key);
+            if (it != _sessions.end()) {
+                it->second.lastActive = Clock::now();
+                return it->second.accepted;
+            }
+        }
+        bool accepted = prompt();
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto &session = _sessions[key];
+        session.accepted = accepted;
+        session.lastActive = Clock::now();
+        return accepted;
+    }
+
+    void SessionAsks::touch(const std::string &senderId, const QString &token) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _sessions.find(senderId + "/" + token.toStdString());
+        if (it != _sessions.end()) {
+            it->second.lastActive = Clock::now();
+        }
+    }
+
+    void SessionAsks::expire(qint64 maxIdleMs) {
+        auto deadline = Clock::now() - std::chrono::milliseconds(maxIdleMs);
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto it = _sessions.begin(); it != _sessions.end();) {
+            if (it->second.lastActive > deadline) {
+                ++it;
+            } else {
+                it = _sessions.erase(it);
+            }
+        }
+    }
+
+} // namespace Transfer
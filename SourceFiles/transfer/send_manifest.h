@@ -0,0 +1,157 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include "base_util.h"
+#include "transfer/object_arena.h"
+#include "transfer/source_file.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QStringList>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "flowdrop/flowdrop.hpp"
+
+namespace Transfer {
+
+    // An empty file named .<session id>.fdsession at the end of every
+    // chunk of a send, so the receiver can ask once for all of them.
+    inline const QString kSessionSuffix = QStringLiteral(".fdsession");
+
+    // What the receiver learns about a whole send before its first chunk.
+    struct SendSession {
+        QString id;
+        // of the whole send, 0 when the sender didn't count
+        quint64 files = 0;
+        quint64 bytes = 0;
+
+        // "<id>.<files>.<bytes>", as markers and multipath headers carry it
+        [[nodiscard]] QString token() const;
+
+        // none when token isn't one
+        [[nodiscard]] static std::optional<SendSession> parse(const QString &token);
+    };
+
+    class SessionMarker final : public flowdrop::File {
+    public:
+        // token as made by SendSession::token()
+        explicit SessionMarker(const QString &token);
+
+        [[nodiscard]] std::string getRelativePath() const override;
+
+        [[nodiscard]] std::uint64_t getSize() const override;
+
+        [[nodiscard]] std::uint64_t getCreatedTime() const override;
+
+        [[nodiscard]] std::uint64_t getModifiedTime() const override;
+
+        [[nodiscard]] std::uint32_t getPermissions() const override;
+
+        [[nodiscard]] std::istream *createStream() override;
+
+    private:
+        std::string _relativePath;
+    }; // SessionMarker
+
+    // Walks the selected paths lazily (directories are expanded while
+    // iterating) and hands them out as bounded chunks of flowdrop::File.
+    // Files of a chunk live in an arena and stay valid until the next call
+    // to nextChunk(), so memory does not grow with the number of files.
+    class SendManifest {
+    public:
+        static constexpr std::size_t kDefaultChunkSize = 4096;
+
+        explicit SendManifest(const QStringList &paths, std::size_t chunkSize = kDefaultChunkSize);
+
+        // Lets the caller substitute what is actually sent for an entry or
+        // take the entry over by returning false.
+        void setEntryFilter(Fn<bool(QString &filePath, QString &relativePath)> filter) {
+            _entryFilter = std::move(filter);
+        }
+
+        // Paths are sent relative to baseDir instead of their parent folder.
+        void setBaseDir(const QString &baseDir) {
+            _baseDir = baseDir;
+        }
+
+        void setThrottle(Fn<void(qint64)> throttle) {
+            _throttle = std::move(throttle);
+        }
+
+        // Files with holes go as sparse containers, off by default since
+        // only this client unpacks them.
+        void setSparse(bool sparse) {
+            _sparse = sparse;
+        }
+
+        // Every chunk ends with a SessionMarker for the session token, none
+        // when empty.
+        void setSessionToken(const QString &token);
+
+        [[nodiscard]] bool nextChunk(std::vector<flowdrop::File *> &chunk);
+
+        [[nodiscard]] std::size_t totalFiles() const {
+            return _totalFiles;
+        }
+
+    private:
+        bool nextEntry(QString &filePath, QString &relativePath);
+
+        QStringList _paths;
+        qsizetype _pathIndex = 0;
+        std::unique_ptr<QDirIterator> _dirIterator;
+        QDir _dirBase;
+        QString _baseDir;
+        ObjectArena<SourceFile> _arena;
+        Fn<bool(QString &, QString &)> _entryFilter;
+        Fn<void(qint64)> _throttle;
+        bool _sparse = false;
+        std::unique_ptr<SessionMarker> _sessionMarker;
+        std::size_t _totalFiles = 0;
+    }; // SendManifest
+
+    // Receiving side: keeps one accept/decline answer per session of a
+    // sender, the chunks after the first one of an accepted send go
+    // through without asking.
+    class SessionAsks {
+    public:
+        // The session token of the files of sendAsk, empty without a
+        // marker.
+        [[nodiscard]] static QString sessionOf(const flowdrop::SendAsk &sendAsk);
+
+        // Whether relativePath is a marker, token is set to its session's.
+        [[nodiscard]] static bool isMarker(const QString &relativePath, QString &token);
+
+        // Prompts on the first ask of a session and answers the rest from
+        // that, prompts every time without a session.
+        bool ask(const std::string &senderId, const QString &token, const Fn<bool()> &prompt);
+
+        // A chunk of the session came in.
+        void touch(const std::string &senderId, const QString &token);
+
+        // Forgets sessions without an ask or a chunk for maxIdleMs.
+        void expire(qint64 maxIdleMs);
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Session {
+            bool accepted = false;
+            Clock::time_point lastActive = Clock::now();
+        };
+
+        std::mutex _mutex;
+        std::unordered_map<std::string, Session> _sessions;
+    }; // SessionAsks
+
+} // namespace Transfer
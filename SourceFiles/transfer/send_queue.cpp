@@ -0,0 +1,186 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/send_queue.h"
+
+#include <QDirIterator>
+#include <QFileInfo>
+#include <algorithm>
+#include <utility>
+
+namespace Transfer {
+
+    namespace {
+
+        // a waiting send counts as this much smaller for every second it
+        // waits, so a 4 GiB send gets its turn after about four minutes
+        constexpr double kAgingBytesPerSecond = 16 * 1024 * 1024;
+
+    } // namespace
+
+    SendQueue::SendQueue(int maxActive, int maxActivePerPeer)
+            : _maxActive(std::max(maxActive, 1)),
+              _maxActivePerPeer(std::max(maxActivePerPeer, 1)) {
+    }
+
+    SendQueue::~SendQueue() {
+        stop();
+    }
+
+    void SendQueue::setRunner(Runner runner) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _runner = std::move(runner);
+    }
+
+    void SendQueue::enqueue(const QString &receiverId, const QStringList &files, Priority priority, Fn<void(bool)> done) {
+        enqueue(SendJob{receiverId, files, priority, 0, 0, std::move(done)});
+    }
+
+    void SendQueue::enqueue(SendJob job) {
+        if (job.size <= 0) {
+            job.size = estimateSize(job.files, &job.fileCount);
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_stopped) {
+                return;
+            }
+            _queued.push_back({std::move(job), Clock::now()});
+        }
+        dispatch();
+    }
+
+    int SendQueue::pending() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return int(_queued.size());
+    }
+
+    void SendQueue::stop() {
+        std::map<std::thread::id, std::thread> workers;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopped = true;
+            _queued.clear();
+            workers.swap(_workers);
+            _exited.clear();
+        }
+        for (auto &[id, worker] : workers) {
+            // a send stopping the queue from its own done can't wait for
+            // itself
+            if (id == std::this_thread::get_id()) {
+                worker.detach();
+            } else {
+                worker.join();
+            }
+        }
+    }
+
+    bool SendQueue::stopped() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _stopped;
+    }
+
+    qint64 SendQueue::estimateSize(const QStringList &files, std::size_t *fileCount) {
+        qint64 size = 0;
+        std::size_t count = 0;
+        for (const QString &path : files) {
+            QFileInfo info(path);
+            if (!info.isDir()) {
+                size += info.size();
+                ++count;
+                continue;
+            }
+            QDirIterator it(path, QDir::Files | QDir::Hidden | QDir::NoSymLinks, QDirIterator::Subdirectories);
+            while (it.hasNext()) {
+                it.next();
+                size += it.fileInfo().size();
+                ++count;
+            }
+        }
+        if (fileCount) {
+            *fileCount = count;
+        }
+        return size;
+    }
+
+    std::vector<SendQueue::Entry>::iterator SendQueue::pick() {
+        auto now = Clock::now();
+        auto best = _queued.end();
+        double bestCost = 0;
+        for (auto it = _queued.begin(); it != _queued.end(); ++it) {
+            auto active = _activePerPeer.find(it->job.receiverId);
+            if (active != _activePerPeer.end() && active->second >= _maxActivePerPeer) {
+                continue;
+            }
+            double waited = std::chrono::duration<double>(now - it->queuedAt).count();
+            double cost = double(it->job.size) - waited * kAgingBytesPerSecond;
+            if (best == _queued.end()
+                || it->job.priority < best->job.priority
+                || (it->job.priority == best->job.priority && cost < bestCost)) {
+                best = it;
+                bestCost = cost;
+            }
+        }
+        return best;
+    }
+
+    void SendQueue::dispatch() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        reap();
+        while (!_stopped && _active < _maxActive && _runner) {
+            auto it = pick();
+            if (it == _queued.end()) {
+                break;
+            }
+            SendJob job = std::move(it->job);
+            _queued.erase(it);
+            ++_active;
+            ++_activePerPeer[job.receiverId];
+
+            std::thread worker([this, job = std::move(job)]() mutable {
+                work(std::move(job));
+            });
+            auto id = worker.get_id();
+            _workers.emplace(id, std::move(worker));
+        }
+    }
+
+    void SendQueue::work(SendJob job) {
+        while (true) {
+            bool sent = _runner(job);
+            if (job.done) {
+                job.done(sent);
+            }
+            std::lock_guard<std::mutex> lock(_mutex);
+            --_active;
+            if (--_activePerPeer[job.receiverId] == 0) {
+                _activePerPeer.erase(job.receiverId);
+            }
+            auto it = _stopped ? _queued.end() : pick();
+            if (it == _queued.end()) {
+                // joined by the next dispatch() or stop()
+                _exited.push_back(std::this_thread::get_id());
+                return;
+            }
+            job = std::move(it->job);
+            _queued.erase(it);
+            ++_active;
+            ++_activePerPeer[job.receiverId];
+        }
+    }
+
+    void SendQueue::reap() {
+        for (auto id : std::exchange(_exited, {})) {
+            auto it = _workers.find(id);
+            if (it != _workers.end()) {
+                it->second.join();
+                _workers.erase(it);
+            }
+        }
+    }
+
+} // namespace Transfer
@@ -0,0 +1,98 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include "base_util.h"
+#include "transfer/shaper.h"
+
+#include <QString>
+#include <QStringList>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Transfer {
+
+    struct SendJob {
+        QString receiverId;
+        QStringList files;
+        Priority priority = Priority::Interactive;
+        qint64 size = 0;
+        // counted along with size, 0 when the caller gave the size
+        std::size_t fileCount = 0;
+        Fn<void(bool)> done; // called with the result on the worker thread
+        QString baseDir; // see SendManifest::setBaseDir()
+    };
+
+    // Schedules queued outgoing sends. Interactive sends go before
+    // background ones, and within a priority the smallest send goes first,
+    // so a few screenshots don't wait behind an ISO. Waiting sends age, a
+    // big one is not starved by a steady stream of small ones.
+    //
+    // Sends run on worker threads owned by the queue, a worker takes the
+    // next send when its own is over and exits when none can start.
+    class SendQueue {
+    public:
+        using Runner = Fn<bool(const SendJob &)>;
+
+        SendQueue(int maxActive, int maxActivePerPeer);
+        ~SendQueue();
+
+        void setRunner(Runner runner);
+
+        // Sizes the files on the calling thread, don't call it from the UI
+        // thread for big folders.
+        void enqueue(const QString &receiverId, const QStringList &files, Priority priority, Fn<void(bool)> done = nullptr);
+
+        // Sized here unless job.size is set.
+        void enqueue(SendJob job);
+
+        [[nodiscard]] int pending();
+
+        // Drops the queued sends without calling their done and waits for
+        // the running ones, the runner should check stopped() to end them
+        // early. Nothing is started afterwards.
+        void stop();
+
+        [[nodiscard]] bool stopped();
+
+        [[nodiscard]] static qint64 estimateSize(const QStringList &files, std::size_t *fileCount = nullptr);
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Entry {
+            SendJob job;
+            Clock::time_point queuedAt;
+        };
+
+        // Starts workers for the sends that can run now.
+        void dispatch();
+
+        void work(SendJob job);
+
+        // joins the workers that are exiting, _mutex is held
+        void reap();
+
+        std::vector<Entry>::iterator pick();
+
+        const int _maxActive;
+        const int _maxActivePerPeer;
+        std::mutex _mutex;
+        Runner _runner;
+        std::vector<Entry> _queued;
+        std::map<QString, int> _activePerPeer;
+        int _active = 0;
+        bool _stopped = false;
+        std::map<std::thread::id, std::thread> _workers;
+        std::vector<std::thread::id> _exited;
+    }; // SendQueue
+
+} // namespace Transfer
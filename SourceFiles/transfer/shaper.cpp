@@ -0,0 +1,133 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/shaper.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace Transfer {
+
+    namespace {
+
+        // how much a bucket may hold when idle, in seconds of its rate
+        constexpr double kBurstSeconds = 0.25;
+        // a peer bucket unused this long is full anyway, it can go
+        constexpr auto kPeerIdle = std::chrono::minutes(1);
+
+    } // namespace
+
+    void TokenBucket::setRate(qint64 bytesPerSecond) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        refill();
+        _rate = double(std::max<qint64>(bytesPerSecond, 0));
+        _tokens = std::min(_tokens, _rate * kBurstSeconds);
+    }
+
+    void TokenBucket::refill() {
+        auto now = Clock::now();
+        double elapsed = std::chrono::duration<double>(now - _last).count();
+        _last = now;
+        _tokens = std::min(_tokens + elapsed * _rate, _rate * kBurstSeconds);
+    }
+
+    std::chrono::nanoseconds TokenBucket::take(qint64 bytes) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_rate <= 0) {
+            return {};
+        }
+        refill();
+        _tokens -= double(bytes);
+        if (_tokens >= 0) {
+            return {};
+        }
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(-_tokens / _rate));
+    }
+
+    Shaper::Activity::Activity(Shaper &shaper, Priority priority) : _shaper(shaper), _priority(priority) {
+        if (_priority == Priority::Interactive) {
+            ++_shaper._interactive;
+        }
+    }
+
+    Shaper::Activity::~Activity() {
+        if (_priority == Priority::Interactive) {
+            --_shaper._interactive;
+        }
+    }
+
+    void Shaper::configure(const ShaperLimits &limits) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _limits = limits;
+        _global.setRate(limits.global);
+        _upload.setRate(limits.upload);
+        _download.setRate(limits.download);
+        for (auto &[id, peer] : _peers) {
+            peer.bucket->setRate(limits.peer);
+        }
+    }
+
+    std::shared_ptr<TokenBucket> Shaper::peerBucket(const std::string &peerId) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto now = Clock::now();
+        if (now - _lastSweep > kPeerIdle) {
+            _lastSweep = now;
+            for (auto it = _peers.begin(); it != _peers.end();) {
+                // still in use when a throttle() holds it
+                if (now - it->second.lastUsed > kPeerIdle && it->second.bucket.use_count() == 1) {
+                    it = _peers.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        auto &peer = _peers[peerId];
+        if (!peer.bucket) {
+            peer.bucket = std::make_shared<TokenBucket>();
+            peer.bucket->setRate(_limits.peer);
+        }
+        peer.lastUsed = now;
+        return peer.bucket;
+    }
+
+    void Shaper::throttle(Direction direction, const std::string &peerId, Priority priority, qint64 bytes) {
+        auto wait = take(direction, peerId, priority, bytes);
+        if (wait.count() > 0) {
+            std::this_thread::sleep_for(wait);
+        }
+    }
+
+    std::chrono::nanoseconds Shaper::take(Direction direction, const std::string &peerId, Priority priority, qint64 bytes) {
+        auto wait = std::max({
+                _global.take(bytes),
+                (direction == Direction::Upload ? _upload : _download).take(bytes),
+                peerBucket(peerId)->take(bytes)});
+
+        if (priority == Priority::Interactive) {
+            _interactiveBytes += bytes;
+        } else if (_interactive > 0) {
+            // background traffic gets a small share of what interactive
+            // transfers currently achieve
+            auto now = std::chrono::steady_clock::now();
+            qint64 share;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                double window = std::chrono::duration<double>(now - _rateWindowStart).count();
+                double interactiveRate = window > 0 ? double(_interactiveBytes) / window : 0;
+                if (window > 1) {
+                    _rateWindowStart = now;
+                    _interactiveBytes = 0;
+                }
+                share = std::max(qint64(interactiveRate * kBackgroundShare), kBackgroundFloor);
+            }
+            _background.setRate(share);
+            wait = std::max(wait, _background.take(bytes));
+        }
+        return wait;
+    }
+
+} // namespace Transfer
@@ -0,0 +1,109 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include <QtGlobal>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace Transfer {
+
+    enum class Priority {
+        Interactive,
+        Background // yields to interactive transfers
+    };
+
+    enum class Direction {
+        Upload,
+        Download
+    };
+
+    class TokenBucket {
+    public:
+        // 0 means unlimited
+        void setRate(qint64 bytesPerSecond);
+
+        // Takes bytes out of the bucket, going into debt if needed, and
+        // returns how long the caller has to wait to pay the debt off.
+        [[nodiscard]] std::chrono::nanoseconds take(qint64 bytes);
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        void refill();
+
+        std::mutex _mutex;
+        double _rate = 0;
+        double _tokens = 0;
+        Clock::time_point _last = Clock::now();
+    }; // TokenBucket
+
+    // Limits are in bytes per second, 0 means unlimited.
+    struct ShaperLimits {
+        qint64 global = 0;
+        qint64 upload = 0;
+        qint64 download = 0;
+        qint64 peer = 0;
+    };
+
+    // Token bucket scheduler shared by all transfers. Limits can be changed
+    // at any time, running transfers pick them up on their next chunk.
+    class Shaper {
+    public:
+        class Activity {
+        public:
+            Activity(Shaper &shaper, Priority priority);
+            ~Activity();
+
+        private:
+            Shaper &_shaper;
+            Priority _priority;
+        };
+
+        void configure(const ShaperLimits &limits);
+
+        // Blocks the calling transfer until bytes fit into every bucket it
+        // goes through.
+        void throttle(Direction direction, const std::string &peerId, Priority priority, qint64 bytes);
+
+        // Like throttle(), but returns how long to wait instead of
+        // sleeping, for transfers driven by an event loop.
+        [[nodiscard]] std::chrono::nanoseconds take(Direction direction, const std::string &peerId, Priority priority, qint64 bytes);
+
+    private:
+        static constexpr double kBackgroundShare = 0.1;
+        static constexpr qint64 kBackgroundFloor = 64 * 1024;
+
+        using Clock = std::chrono::steady_clock;
+
+        struct Peer {
+            std::shared_ptr<TokenBucket> bucket;
+            Clock::time_point lastUsed;
+        };
+
+        // Drops the buckets of peers idle for a while, now and then.
+        std::shared_ptr<TokenBucket> peerBucket(const std::string &peerId);
+
+        std::mutex _mutex;
+        ShaperLimits _limits;
+        TokenBucket _global;
+        TokenBucket _upload;
+        TokenBucket _download;
+        TokenBucket _background;
+        std::map<std::string, Peer> _peers;
+        Clock::time_point _lastSweep = Clock::now();
+
+        std::atomic<int> _interactive = 0;
+        std::atomic<qint64> _interactiveBytes = 0;
+        std::chrono::steady_clock::time_point _rateWindowStart = std::chrono::steady_clock::now();
+    }; // Shaper
+
+} // namespace Transfer
@@ -0,0 +1,164 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/source_file.h"
+
+#include "platform/platform_files.h"
+#include "transfer/sparse.h"
+
+#include <QDebug>
+#include <QFileInfo>
+#include <algorithm>
+#include <cstring>
+
+namespace Transfer {
+
+    namespace {
+
+        constexpr auto kReadSize = qint64(BufferPool::kBufferSize);
+        constexpr qint64 kMinSparseSize = 1024 * 1024;
+
+        std::filesystem::path nativePath(const QString &filePath) {
+            return {filePath.toStdU16String()};
+        }
+
+    } // namespace
+
+    SegmentStreamBuf::SegmentStreamBuf(const QString &filePath, std::vector<Segment> segments, Fn<void(qint64)> throttle)
+            : _file(filePath),
+              _segments(std::move(segments)),
+              _throttle(std::move(throttle)) {
+    }
+
+    SegmentStreamBuf::int_type SegmentStreamBuf::underflow() {
+        if (gptr() < egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+        if (_index >= _segments.size()) {
+            return finish();
+        }
+        // taken on the first read, the library creates streams up front
+        if (!_buffer.data()) {
+            _buffer = BufferPool::instance().acquire();
+        }
+        while (_index < _segments.size()) {
+            const Segment &segment = _segments[_index];
+            if (!segment.inlineData.isEmpty()) {
+                if (_position < segment.inlineData.size()) {
+                    auto length = std::min<qint64>(segment.inlineData.size() - _position, kReadSize);
+                    std::memcpy(_buffer.data(), segment.inlineData.constData() + _position, length);
+                    if (_throttle) {
+                        _throttle(length);
+                    }
+                    _position += length;
+                    setg(_buffer.data(), _buffer.data(), _buffer.data() + length);
+                    return traits_type::to_int_type(*gptr());
+                }
+            } else if (_position < segment.length) {
+                if (!_file.isOpen() && !_file.open(QIODevice::ReadOnly)) {
+                    return finish();
+                }
+                if (!_file.seek(segment.offset + _position)) {
+                    return finish();
+                }
+                qint64 read = _file.read(_buffer.data(), std::min(segment.length - _position, kReadSize));
+                if (read <= 0) {
+                    return finish();
+                }
+                if (_throttle) {
+                    _throttle(read);
+                }
+                _position += read;
+                setg(_buffer.data(), _buffer.data(), _buffer.data() + read);
+                return traits_type::to_int_type(*gptr());
+            }
+            ++_index;
+            _position = 0;
+        }
+        return finish();
+    }
+
+    SegmentStreamBuf::int_type SegmentStreamBuf::finish() {
+        // the library keeps finished streams around until the whole
+        // request is over, their buffers must not wait for that
+        setg(nullptr, nullptr, nullptr);
+        _buffer = Buffer();
+        _file.close();
+        _index = _segments.size();
+        return traits_type::eof();
+    }
+
+    SegmentStream::SegmentStream(const QString &filePath, std::vector<Segment> segments, Fn<void(qint64)> throttle)
+            : std::istream(nullptr),
+              _buf(filePath, std::move(segments), std::move(throttle)) {
+        rdbuf(&_buf);
+    }
+
+    SourceFile::SourceFile(const QString &filePath, const QString &relativePath, bool sparse)
+            : _native(nativePath(filePath), relativePath.toStdString()),
+              _filePath(filePath),
+              _relativePath(relativePath.toStdString()) {
+        qint64 size = QFileInfo(filePath).size();
+
+        std::vector<Platform::Files::Extent> extents;
+        if (sparse && size >= kMinSparseSize && Platform::Files::dataExtents(filePath, extents)) {
+            qint64 dataSize = 0;
+            for (const auto &extent : extents) {
+                dataSize += extent.length;
+            }
+            if (dataSize < size / 10 * 9) {
+                QByteArray header = sparseHeader(size, extents);
+                _size = header.size() + dataSize;
+                _segments.push_back({header});
+                for (const auto &extent : extents) {
+                    _segments.push_back({{}, extent.offset, extent.length});
+                }
+                _relativePath += kSparseSuffix.toStdString();
+                qInfo() << "Sending" << relativePath << "as sparse," << dataSize << "of" << size << "bytes";
+                return;
+            }
+        }
+
+        _size = size;
+        _segments.push_back({{}, 0, size});
+    }
+
+    SourceFile::SourceFile(const QString &filePath, const QString &relativePath, std::vector<Segment> segments)
+            : _native(nativePath(filePath), relativePath.toStdString()),
+              _filePath(filePath),
+              _relativePath(relativePath.toStdString()),
+              _segments(std::move(segments)) {
+        for (const auto &segment : _segments) {
+            _size += segment.inlineData.isEmpty() ? segment.length : segment.inlineData.size();
+        }
+    }
+
+    std::string SourceFile::getRelativePath() const {
+        return _relativePath;
+    }
+
+    std::uint64_t SourceFile::getSize() const {
+        return _size;
+    }
+
+    std::uint64_t SourceFile::getCreatedTime() const {
+        return _native.getCreatedTime();
+    }
+
+    std::uint64_t SourceFile::getModifiedTime() const {
+        return _native.getModifiedTime();
+    }
+
+    std::uint32_t SourceFile::getPermissions() const {
+        return _native.getPermissions();
+    }
+
+    std::istream *SourceFile::createStream() {
+        return new SegmentStream(_filePath, _segments, _throttle);
+    }
+
+} // namespace Transfer
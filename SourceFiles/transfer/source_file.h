@@ -0,0 +1,92 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include "base_util.h"
+#include "transfer/buffer_pool.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <istream>
+#include <streambuf>
+#include <vector>
+#include "flowdrop/flowdrop.hpp"
+
+namespace Transfer {
+
+    // A piece of what is sent for a file: either bytes prepared in memory
+    // (container headers) or a range of the source file.
+    struct Segment {
+        QByteArray inlineData;
+        qint64 offset = 0;
+        qint64 length = 0;
+    };
+
+    class SegmentStreamBuf : public std::streambuf {
+    public:
+        SegmentStreamBuf(const QString &filePath, std::vector<Segment> segments, Fn<void(qint64)> throttle);
+
+    protected:
+        int_type underflow() override;
+
+    private:
+        // gives the buffer back, reads fail from then on
+        int_type finish();
+
+        QFile _file;
+        std::vector<Segment> _segments;
+        std::size_t _index = 0;
+        qint64 _position = 0;
+        Buffer _buffer;
+        Fn<void(qint64)> _throttle;
+    }; // SegmentStreamBuf
+
+    class SegmentStream : public std::istream {
+    public:
+        SegmentStream(const QString &filePath, std::vector<Segment> segments, Fn<void(qint64)> throttle);
+
+    private:
+        SegmentStreamBuf _buf;
+    }; // SegmentStream
+
+    // flowdrop::File for a file on disk. With sparse set, files with holes
+    // are sent as a sparse container holding only their data extents.
+    class SourceFile final : public flowdrop::File {
+    public:
+        SourceFile(const QString &filePath, const QString &relativePath, bool sparse);
+
+        // Sends exactly the given segments of filePath under relativePath.
+        SourceFile(const QString &filePath, const QString &relativePath, std::vector<Segment> segments);
+
+        // Called with the size of every piece before it is handed out.
+        void setThrottle(Fn<void(qint64)> throttle) {
+            _throttle = std::move(throttle);
+        }
+
+        [[nodiscard]] std::string getRelativePath() const override;
+
+        [[nodiscard]] std::uint64_t getSize() const override;
+
+        [[nodiscard]] std::uint64_t getCreatedTime() const override;
+
+        [[nodiscard]] std::uint64_t getModifiedTime() const override;
+
+        [[nodiscard]] std::uint32_t getPermissions() const override;
+
+        [[nodiscard]] std::istream *createStream() override;
+
+    private:
+        flowdrop::NativeFile _native;
+        QString _filePath;
+        std::string _relativePath;
+        std::uint64_t _size = 0;
+        std::vector<Segment> _segments;
+        Fn<void(qint64)> _throttle;
+    }; // SourceFile
+
+} // namespace Transfer
@@ -0,0 +1,122 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/sparse.h"
+
+#include "transfer/buffer_pool.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <cstring>
+#include <filesystem>
+#include <gsl/gsl>
+
+namespace Transfer {
+
+    namespace {
+
+        constexpr char kSparseMagic[] = "FDSPARS1";
+        constexpr int kMagicLength = 8;
+        constexpr qint64 kExtentSize = 2 * sizeof(qint64);
+        constexpr auto kCopySize = qint64(BufferPool::kBufferSize);
+
+        bool expand(QFile &container, QFile &output) {
+            QDataStream stream(&container);
+            char magic[kMagicLength];
+            if (stream.readRawData(magic, kMagicLength) != kMagicLength || std::memcmp(magic, kSparseMagic, kMagicLength) != 0) {
+                return false;
+            }
+            qint64 logicalSize;
+            quint32 count;
+            stream >> logicalSize >> count;
+            // the count comes from the sender, the list has to fit in what
+            // was actually received
+            if (stream.status() != QDataStream::Ok || logicalSize < 0
+                    || qint64(count) > (container.size() - container.pos()) / kExtentSize) {
+                return false;
+            }
+            std::vector<Platform::Files::Extent> extents(count);
+            for (auto &extent : extents) {
+                stream >> extent.offset >> extent.length;
+                if (extent.offset < 0 || extent.length < 0 || extent.offset > logicalSize
+                        || extent.length > logicalSize - extent.offset) {
+                    return false;
+                }
+            }
+            if (stream.status() != QDataStream::Ok) {
+                return false;
+            }
+
+            // resizing leaves everything that is not written below as a hole
+            if (!output.resize(logicalSize)) {
+                return false;
+            }
+            Buffer buffer = BufferPool::instance().acquire();
+            for (const auto &extent : extents) {
+                if (!output.seek(extent.offset)) {
+                    return false;
+                }
+                qint64 left = extent.length;
+                while (left > 0) {
+                    qint64 read = stream.readRawData(buffer.data(), static_cast<int>(std::min(left, kCopySize)));
+                    if (read <= 0 || output.write(buffer.data(), read) != read) {
+                        return false;
+                    }
+                    left -= read;
+                }
+            }
+            return true;
+        }
+
+    } // namespace
+
+    QByteArray sparseHeader(qint64 logicalSize, const std::vector<Platform::Files::Extent> &extents) {
+        QByteArray header;
+        QDataStream stream(&header, QIODevice::WriteOnly);
+        stream.writeRawData(kSparseMagic, kMagicLength);
+        stream << logicalSize << quint32(extents.size());
+        for (const auto &extent : extents) {
+            stream << extent.offset << extent.length;
+        }
+        return header;
+    }
+
+    bool applyReceivedSparse(const QString &destDir, const QString &relativePath) {
+        Expects(relativePath.endsWith(kSparseSuffix));
+
+        QString containerPath = QDir(destDir).filePath(relativePath);
+        QString targetPath = containerPath.chopped(kSparseSuffix.size());
+        QString outputPath = targetPath + ".fdexpand";
+
+        QFile container(containerPath);
+        QFile output(outputPath);
+        bool expanded = container.open(QIODevice::ReadOnly)
+                        && output.open(QIODevice::WriteOnly | QIODevice::Truncate)
+                        && expand(container, output);
+        container.close();
+        output.close();
+        if (expanded) {
+            std::error_code error;
+            std::filesystem::rename(
+                    std::filesystem::path(outputPath.toStdU16String()),
+                    std::filesystem::path(targetPath.toStdU16String()),
+                    error);
+            expanded = !error;
+        }
+        if (!expanded) {
+            // the container stays, it is all we have of the file
+            qWarning() << "Failed to expand sparse file:" << containerPath;
+            QFile::remove(outputPath);
+            return false;
+        }
+        QFile::remove(containerPath);
+        return true;
+    }
+
+} // namespace Transfer
@@ -0,0 +1,27 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include "platform/platform_files.h"
+
+#include <QByteArray>
+#include <QString>
+#include <vector>
+
+namespace Transfer {
+
+    // Sparse files are sent as a header listing the data extents followed by
+    // the extent bytes, under the original name plus this suffix.
+    inline const QString kSparseSuffix = QStringLiteral(".fdsparse");
+
+    [[nodiscard]] QByteArray sparseHeader(qint64 logicalSize, const std::vector<Platform::Files::Extent> &extents);
+
+    // Expands destDir/relativePath into a sparse file next to it and removes
+    // the container. A container that doesn't parse is left as it is.
+    bool applyReceivedSparse(const QString &destDir, const QString &relativePath);
+
+} // namespace Transfer
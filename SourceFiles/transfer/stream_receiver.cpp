@@ -0,0 +1,154 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/stream_receiver.h"
+
+#include "platform/platform_files.h"
+#include "transfer/delta.h"
+#include "transfer/mirror.h"
+#include "transfer/send_manifest.h"
+#include "transfer/sparse.h"
+#include "transfer/stream_source.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QProcess>
+
+namespace Transfer {
+
+    namespace {
+
+        const QString kSenderPrefix = "sender:";
+
+        bool isContainer(const QString &relativePath) {
+            return relativePath.endsWith(kDeltaSuffix)
+                || relativePath.endsWith(kSparseSuffix)
+                || relativePath.endsWith(kChunkSuffix)
+                || relativePath.endsWith(kRemovalSuffix)
+                || relativePath.endsWith(kSessionSuffix);
+        }
+
+        // The path comes from the sender, empty when it leads out of root.
+        QString confinedPath(const QString &root, const QString &relativePath) {
+            QDir dir(root);
+            QString base = QDir::cleanPath(dir.absolutePath());
+            QString target = QDir::cleanPath(dir.absoluteFilePath(relativePath));
+            return !relativePath.isEmpty() && target.startsWith(base + '/') ? target : QString();
+        }
+
+    } // namespace
+
+    void StreamReceiver::setRules(const QString &rules) {
+        std::vector<Rule> parsed;
+        for (const QString &line : rules.split('\n', Qt::SkipEmptyParts)) {
+            qsizetype separator = line.indexOf('|');
+            Rule rule;
+            QString pattern = (separator < 0 ? line : line.left(separator)).trimmed();
+            rule.command = separator < 0 ? QString() : line.mid(separator + 1).trimmed();
+            if (pattern.startsWith(kSenderPrefix)) {
+                rule.sender = pattern.mid(kSenderPrefix.size()).trimmed();
+            } else if (!pattern.isEmpty()) {
+                rule.fileName = QRegularExpression(QRegularExpression::wildcardToRegularExpression(pattern));
+            } else {
+                continue;
+            }
+            parsed.push_back(std::move(rule));
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        _rules = std::move(parsed);
+    }
+
+    const StreamReceiver::Rule *StreamReceiver::match(const flowdrop::DeviceInfo &sender, const QString &relativePath) const {
+        QString fileName = QFileInfo(relativePath).fileName();
+        for (const auto &rule : _rules) {
+            bool matched = rule.sender.isEmpty()
+                    ? rule.fileName.match(fileName).hasMatch()
+                    : rule.sender == QString::fromStdString(sender.id);
+            if (matched) {
+                return &rule;
+            }
+        }
+        return nullptr;
+    }
+
+    void StreamReceiver::prepare(const flowdrop::SendAsk &sendAsk, const QString &destDir) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_rules.empty()) {
+            return;
+        }
+        QDir dir(destDir);
+        for (const auto &file : sendAsk.files) {
+            QString relativePath = QString::fromStdString(file.name);
+            const Rule *rule = isContainer(relativePath) ? nullptr : match(sendAsk.sender, relativePath);
+            if (!rule) {
+                continue;
+            }
+            QString fifoPath = confinedPath(destDir, relativePath);
+            if (fifoPath.isEmpty()) {
+                qWarning() << "Not streaming a file outside the destination:" << relativePath;
+                continue;
+            }
+            if (_active.count(fifoPath) > 0) {
+                continue;
+            }
+            QFileInfo info(fifoPath);
+            if (info.exists() || info.isSymLink()) {
+                qInfo() << "Not streaming over an existing file:" << fifoPath;
+                continue;
+            }
+            dir.mkpath(info.path());
+            if (!Platform::Files::makeFifo(fifoPath)) {
+                qWarning() << "Could not create a FIFO, receiving to disk:" << fifoPath;
+                continue;
+            }
+            _active[fifoPath] = sendAsk.sender.id;
+            if (rule->command.isEmpty()) {
+                qInfo() << "Streaming" << relativePath << "to FIFO" << fifoPath;
+                continue;
+            }
+            // the shell opens the FIFO, opening it here would block until
+            // the server starts writing
+            QStringList arguments{"-c", "exec <\"$1\"\n" + rule->command, "flowdrop-stream", fifoPath};
+            if (!QProcess::startDetached("/bin/sh", arguments, dir.path())) {
+                qWarning() << "Failed to start" << rule->command;
+                QFile::remove(fifoPath);
+                _active.erase(fifoPath);
+                continue;
+            }
+            qInfo() << "Streaming" << relativePath << "to" << rule->command;
+        }
+    }
+
+    bool StreamReceiver::finish(const QString &destDir, const QString &relativePath) {
+        QString fifoPath = confinedPath(destDir, relativePath);
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (fifoPath.isEmpty() || _active.erase(fifoPath) == 0) {
+            return false;
+        }
+        // the reader keeps its end open until it has drained the pipe
+        QFile::remove(fifoPath);
+        return true;
+    }
+
+    void StreamReceiver::abort(const std::string &senderId, const std::vector<std::string> &fileNames, const QString &destDir) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (const auto &name : fileNames) {
+            QString fifoPath = confinedPath(destDir, QString::fromStdString(name));
+            auto it = _active.find(fifoPath);
+            if (it == _active.end() || it->second != senderId) {
+                continue;
+            }
+            _active.erase(it);
+            // the command is still waiting for a writer to show up
+            Platform::Files::closeFifo(fifoPath);
+            QFile::remove(fifoPath);
+            qInfo() << "Stopped streaming" << fifoPath;
+        }
+    }
+
+} // namespace Transfer
@@ -0,0 +1,59 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include <QRegularExpression>
+#include <QString>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "flowdrop/flowdrop.hpp"
+
+namespace Transfer {
+
+    // Streams matching incoming files into a command or a named pipe
+    // instead of the disk. A FIFO is put at the destination path before
+    // the server opens it, so its writes block while the consumer is busy
+    // and the sender is slowed down through TCP.
+    //
+    // Rules are one per line, "<pattern> | <command>". The pattern is a
+    // file name wildcard or "sender:<device id>", names are set by the
+    // sender and can't be trusted. The command gets the file on stdin,
+    // without a command the FIFO is left for an external reader. Files
+    // already on disk are never replaced by a FIFO.
+    class StreamReceiver {
+    public:
+        void setRules(const QString &rules);
+
+        // Sets up the FIFOs for the files of an accepted ask. Containers
+        // need to be unpacked on disk and are never streamed.
+        void prepare(const flowdrop::SendAsk &sendAsk, const QString &destDir);
+
+        // Returns true if relativePath was streamed, the FIFO is removed.
+        bool finish(const QString &destDir, const QString &relativePath);
+
+        // Removes the FIFOs of a receive the sender broke off, their
+        // readers see the end of the data.
+        void abort(const std::string &senderId, const std::vector<std::string> &fileNames, const QString &destDir);
+
+    private:
+        struct Rule {
+            QString sender;
+            QRegularExpression fileName;
+            QString command;
+        };
+
+        [[nodiscard]] const Rule *match(const flowdrop::DeviceInfo &sender, const QString &relativePath) const;
+
+        std::mutex _mutex;
+        std::vector<Rule> _rules;
+        // FIFO path to the id of the sender it was made for
+        std::map<QString, std::string> _active;
+    }; // StreamReceiver
+
+} // namespace Transfer
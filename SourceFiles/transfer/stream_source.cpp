@@ -0,0 +1,255 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/stream_source.h"
+
+#include "transfer/buffer_pool.h"
+#include "transfer/source_file.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QRandomGenerator>
+#include <cstring>
+#include <filesystem>
+
+namespace Transfer {
+
+    namespace {
+
+        constexpr char kChunkMagic[] = "FDCHUNK1";
+        constexpr int kMagicLength = 8;
+        // held in memory while it is sent
+        constexpr qint64 kChunkSize = 32 * 1024 * 1024;
+
+        struct ChunkName {
+            QString relativePath;
+            QString streamId;
+            quint32 index = 0;
+        };
+
+        bool parseChunkName(const QString &name, ChunkName &result) {
+            if (!name.endsWith(kChunkSuffix)) {
+                return false;
+            }
+            QString base = name.chopped(kChunkSuffix.size());
+            qsizetype indexDot = base.lastIndexOf('.');
+            qsizetype idDot = indexDot > 0 ? base.lastIndexOf('.', indexDot - 1) : -1;
+            if (idDot <= 0) {
+                return false;
+            }
+            bool ok;
+            result.index = base.mid(indexDot + 1).toUInt(&ok);
+            result.streamId = base.mid(idDot + 1, indexDot - idDot - 1);
+            result.relativePath = base.left(idDot);
+            return ok && !result.streamId.isEmpty();
+        }
+
+        QByteArray chunkHeader(quint32 index, bool last) {
+            QByteArray header;
+            QDataStream stream(&header, QIODevice::WriteOnly);
+            stream.writeRawData(kChunkMagic, kMagicLength);
+            stream << index << quint8(last ? 1 : 0);
+            return header;
+        }
+
+        // reads until size bytes are in or the input ends
+        bool readChunk(QIODevice &input, QByteArray &data, bool &end) {
+            data.resize(kChunkSize);
+            qint64 filled = 0;
+            end = false;
+            while (filled < kChunkSize) {
+                qint64 read = input.read(data.data() + filled, kChunkSize - filled);
+                if (read < 0) {
+                    return false;
+                }
+                if (read == 0 && !input.waitForReadyRead(-1)) {
+                    end = true;
+                    break;
+                }
+                filled += read;
+            }
+            data.resize(filled);
+            return true;
+        }
+
+        class ChunkFile final : public flowdrop::File {
+        public:
+            ChunkFile(std::string relativePath, std::vector<Segment> segments, Fn<void(qint64)> throttle)
+                    : _relativePath(std::move(relativePath)),
+                      _segments(std::move(segments)),
+                      _throttle(std::move(throttle)) {
+                for (const auto &segment : _segments) {
+                    _size += segment.inlineData.size();
+                }
+            }
+
+            [[nodiscard]] std::string getRelativePath() const override {
+                return _relativePath;
+            }
+
+            [[nodiscard]] std::uint64_t getSize() const override {
+                return _size;
+            }
+
+            // chunks are removed once appended, their times don't matter
+            [[nodiscard]] std::uint64_t getCreatedTime() const override {
+                return 0;
+            }
+
+            [[nodiscard]] std::uint64_t getModifiedTime() const override {
+                return 0;
+            }
+
+            [[nodiscard]] std::uint32_t getPermissions() const override {
+                return 0644;
+            }
+
+            [[nodiscard]] std::istream *createStream() override {
+                return new SegmentStream({}, _segments, _throttle);
+            }
+
+        private:
+            std::string _relativePath;
+            std::vector<Segment> _segments;
+            Fn<void(qint64)> _throttle;
+            std::uint64_t _size = 0;
+        };
+
+    } // namespace
+
+    bool sendStream(
+            QIODevice &input,
+            const QString &relativePath,
+            const Fn<void(qint64)> &throttle,
+            const Fn<bool(const std::vector<flowdrop::File *> &)> &sendFiles) {
+        const QString streamId = QString::number(QRandomGenerator::global()->generate64(), 16);
+        QByteArray data;
+        bool end = false;
+        for (quint32 index = 0; !end; ++index) {
+            if (!readChunk(input, data, end)) {
+                qWarning() << "Failed to read stream:" << input.errorString();
+                return false;
+            }
+            QString chunkName = relativePath + "." + streamId + "." + QString::number(index) + kChunkSuffix;
+            ChunkFile chunk(chunkName.toStdString(), {{chunkHeader(index, end)}, {data}}, throttle);
+            if (!sendFiles({&chunk})) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool ChunkAssembler::ask(const flowdrop::SendAsk &sendAsk, const Fn<bool(const flowdrop::SendAsk &)> &prompt) {
+        ChunkName name;
+        if (sendAsk.files.size() != 1 || !parseChunkName(QString::fromStdString(sendAsk.files.front().name), name)) {
+            return prompt(sendAsk);
+        }
+        // keyed by sender too, another one may pick the same stream id
+        std::string key = sendAsk.sender.id + "/" + name.streamId.toStdString();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto it = _streams.find(key);
+            if (it != _streams.end() && it->second.accepted) {
+                it->second.lastActive = Clock::now();
+                return *it->second.accepted;
+            }
+        }
+        bool accepted = prompt(sendAsk);
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto &stream = _streams[key];
+        stream.accepted = accepted;
+        stream.lastActive = Clock::now();
+        return accepted;
+    }
+
+    ChunkAssembler::Result ChunkAssembler::add(const std::string &senderId, const QString &destDir, const QString &relativePath, QString &targetPath) {
+        QDir dir(destDir);
+        QString chunkPath = dir.filePath(relativePath);
+        targetPath = chunkPath;
+        ChunkName name;
+        if (!parseChunkName(relativePath, name)) {
+            return Result::NotChunk;
+        }
+        QFile chunk(chunkPath);
+        if (!chunk.open(QIODevice::ReadOnly)) {
+            return Result::Failed;
+        }
+        QDataStream stream(&chunk);
+        char magic[kMagicLength];
+        quint32 index;
+        quint8 flags;
+        if (stream.readRawData(magic, kMagicLength) != kMagicLength || std::memcmp(magic, kChunkMagic, kMagicLength) != 0) {
+            return Result::NotChunk;
+        }
+        stream >> index >> flags;
+        targetPath = dir.filePath(name.relativePath);
+        QString streamPath = targetPath + "." + name.streamId + ".fdstream";
+        std::string key = senderId + "/" + name.streamId.toStdString();
+
+        bool last = false;
+        bool appended = false;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            Stream &state = _streams[key];
+            state.path = streamPath;
+            state.lastActive = Clock::now();
+            QFile output(streamPath);
+            if (output.open(QIODevice::WriteOnly | QIODevice::Append)) {
+                // chunks arrive one after another, anything else means the
+                // stream was broken off and restarted
+                appended = stream.status() == QDataStream::Ok && index == state.nextIndex;
+                last = flags & 1;
+                Buffer buffer = BufferPool::instance().acquire();
+                qint64 read;
+                while (appended && (read = chunk.read(buffer.data(), qint64(buffer.size()))) > 0) {
+                    appended = output.write(buffer.data(), read) == read;
+                }
+            }
+            chunk.close();
+            QFile::remove(chunkPath);
+            if (!appended || last) {
+                _streams.erase(key);
+            } else {
+                ++state.nextIndex;
+            }
+        }
+        if (!appended) {
+            qWarning() << "Failed to append chunk:" << chunkPath;
+            QFile::remove(streamPath);
+            return Result::Failed;
+        }
+        if (!last) {
+            return Result::Pending;
+        }
+
+        std::error_code error;
+        std::filesystem::rename(
+                std::filesystem::path(streamPath.toStdU16String()),
+                std::filesystem::path(targetPath.toStdU16String()),
+                error);
+        return error ? Result::Failed : Result::Completed;
+    }
+
+    void ChunkAssembler::expire(qint64 maxIdleMs) {
+        auto deadline = Clock::now() - std::chrono::milliseconds(maxIdleMs);
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto it = _streams.begin(); it != _streams.end();) {
+            if (it->second.lastActive > deadline) {
+                ++it;
+                continue;
+            }
+            if (!it->second.path.isEmpty()) {
+                qWarning() << "Stream broken off:" << it->second.path;
+                QFile::remove(it->second.path);
+            }
+            it = _streams.erase(it);
+        }
+    }
+
+} // namespace Transfer
@@ -0,0 +1,75 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include "base_util.h"
+
+#include <QIODevice>
+#include <QString>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include "flowdrop/flowdrop.hpp"
+
+namespace Transfer {
+
+    // A piece of a stream of unknown length, named
+    // <relative path>.<stream id>.<index>.fdchunk. The last chunk carries
+    // the end marker.
+    inline const QString kChunkSuffix = QStringLiteral(".fdchunk");
+
+    // Sends everything read from input (stdin, a pipe, generated data) as
+    // relativePath, one chunk per sendFiles call, without staging it on
+    // disk. throttle, when set, is called with the size of every piece
+    // before it goes out. Returns false when a chunk failed.
+    bool sendStream(
+            QIODevice &input,
+            const QString &relativePath,
+            const Fn<void(qint64)> &throttle,
+            const Fn<bool(const std::vector<flowdrop::File *> &)> &sendFiles);
+
+    // Receiving side: appends chunks in order and keeps one accept/decline
+    // answer per stream.
+    class ChunkAssembler {
+    public:
+        enum class Result {
+            Failed,
+            Pending,
+            Completed,
+            // named like a chunk but isn't one, left as received
+            NotChunk
+        };
+
+        // Asks on the first chunk of a stream; asks regularly for anything else.
+        bool ask(const flowdrop::SendAsk &sendAsk, const Fn<bool(const flowdrop::SendAsk &)> &prompt);
+
+        // Appends destDir/relativePath to its stream, targetPath is set to
+        // the final path. Streams are kept apart by sender.
+        Result add(const std::string &senderId, const QString &destDir, const QString &relativePath, QString &targetPath);
+
+        // Forgets streams without a chunk for maxIdleMs and removes what
+        // they left on disk, the sender went away without the last one.
+        void expire(qint64 maxIdleMs);
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Stream {
+            std::optional<bool> accepted;
+            quint32 nextIndex = 0;
+            // appended to, empty before the first chunk
+            QString path;
+            Clock::time_point lastActive = Clock::now();
+        };
+
+        std::mutex _mutex;
+        std::unordered_map<std::string, Stream> _streams;
+    }; // ChunkAssembler
+
+} // namespace Transfer
@@ -0,0 +1,90 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+
+#include "transfer/transport_tuner.h"
+
+#include <QDebug>
+#include <algorithm>
+
+namespace Transfer {
+
+    namespace {
+
+        constexpr qint64 kMinWindow = 256 * 1024;
+        constexpr int kMinBuffer = 256 * 1024;
+        constexpr int kMaxBuffer = 8 * 1024 * 1024;
+        constexpr double kLossShrink = 0.02;
+        constexpr double kLossGrow = 0.005;
+        // clean samples in a row before a chunk size is trusted
+        constexpr int kGrowAfter = 4;
+        // queueing delay over the minimum RTT that counts as bloat
+        constexpr double kBloatFactor = 2;
+        constexpr double kBloatSlackMs = 5;
+
+        int clampBuffer(qint64 bytes) {
+            return int(std::clamp<qint64>(bytes, kMinBuffer, kMaxBuffer));
+        }
+
+    } // namespace
+
+    TransportTuner::TransportTuner(QString label, int unitSize, int feedbackMs)
+            : _label(std::move(label)),
+              _unitSize(unitSize),
+              _feedbackMs(feedbackMs),
+              _window(kMinWindow),
+              _sendBuffer(kMinBuffer) {
+    }
+
+    bool TransportTuner::update(const TuningSample &sample) {
+        if (sample.rttMs >= 0) {
+            _srtt = _srtt < 0 ? sample.rttMs : _srtt * 7 / 8 + sample.rttMs / 8;
+            _minRtt = _minRtt < 0 ? sample.rttMs : std::min(_minRtt, sample.rttMs);
+        }
+        bool bloated = _minRtt >= 0 && _srtt > _minRtt * kBloatFactor + kBloatSlackMs;
+
+        int units = _units;
+        if (sample.loss > kLossShrink || bloated) {
+            units = std::max(_units / 2, kMinUnits);
+            _cleanRounds = 0;
+        } else if (sample.loss < kLossGrow && ++_cleanRounds >= kGrowAfter) {
+            units = std::min(_units * 2, kMaxUnits);
+            _cleanRounds = 0;
+        }
+
+        double roundMs = std::max(_srtt, 0.0) + _feedbackMs;
+        qint64 window = std::max(qint64(2 * double(sample.rate) * roundMs / 1000), kMinWindow);
+        int sendBuffer = clampBuffer(std::max<qint64>(window, qint64(units) * _unitSize * 4));
+        _window = window;
+
+        // the window follows the rate on every sample, the buffer only
+        // moves in steps so the socket isn't reconfigured all the time
+        bool resize = sendBuffer > _sendBuffer * 2 || sendBuffer < _sendBuffer / 2;
+        if (units == _units && !resize) {
+            return false;
+        }
+        _units = units;
+        if (resize) {
+            _sendBuffer = sendBuffer;
+        }
+        ++_changes;
+        qInfo().nospace() << "Tuning " << _label << ": chunk " << _units * _unitSize << " bytes, window " << _window / 1024
+                          << " KiB, send buffer " << _sendBuffer / 1024 << " KiB (rtt " << _srtt << " ms, min " << _minRtt
+                          << " ms, rate " << sample.rate / 1024 << " KiB/s, loss " << sample.loss * 100 << "%)";
+        return true;
+    }
+
+    int TransportTuner::receiveBuffer(qint64 bytesPerSecond) {
+        // a quarter second of data rides out a busy disk
+        return clampBuffer(bytesPerSecond / 4);
+    }
+
+    void TransportTuner::logSummary() const {
+        qInfo().nospace() << "Tuning " << _label << " settled on chunk " << _units * _unitSize << " bytes, window "
+                          << _window / 1024 << " KiB, rtt " << _srtt << " ms after " << _changes << " changes";
+    }
+
+} // namespace Transfer
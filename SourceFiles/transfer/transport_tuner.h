@@ -0,0 +1,73 @@
+/*
+ * This file is part of FlowDrop Qt.
+ *
+ * For license and copyright information please follow this link:
+ * https://github.com/noseam-env/flowdrop-qt/blob/master/LEGAL
+ */
+#pragma once
+
+#include <QString>
+
+namespace Transfer {
+
+    struct TuningSample {
+        // round trip of the slowest peer, negative when none came in
+        double rttMs = -1;
+        // the current sending rate, bytes per second
+        qint64 rate = 0;
+        // lost share of what was sent since the last sample
+        double loss = 0;
+    };
+
+    // Picks the chunk size, the limit on unacknowledged data and the
+    // socket buffer sizes of our own transports from what a transfer
+    // measures. A chunk is a burst of units sent back to back, each in
+    // its own datagram. Chunks grow on clean links and shrink on loss or
+    // when the RTT climbs above its minimum, which means a queue is
+    // building up. The window covers twice the data in flight over one
+    // feedback round.
+    class TransportTuner {
+    public:
+        TransportTuner(QString label, int unitSize, int feedbackMs);
+
+        static constexpr int kMinUnits = 1;
+        static constexpr int kMaxUnits = 32;
+
+        // Returns true when one of the values changed.
+        bool update(const TuningSample &sample);
+
+        [[nodiscard]] int chunkUnits() const {
+            return _units;
+        }
+
+        [[nodiscard]] qint64 window() const {
+            return _window;
+        }
+
+        [[nodiscard]] int sendBuffer() const {
+            return _sendBuffer;
+        }
+
+        [[nodiscard]] double smoothedRtt() const {
+            return _srtt;
+        }
+
+        // For the receiving side, sized after the incoming rate.
+        [[nodiscard]] static int receiveBuffer(qint64 bytesPerSecond);
+
+        void logSummary() const;
+
+    private:
+        const QString _label;
+        const int _unitSize;
+        const int _feedbackMs;
+        int _units = kMinUnits;
+        int _cleanRounds = 0;
+        qint64 _window;
+        int _sendBuffer;
+        double _srtt = -1;
+        double _minRtt = -1;
+        int _changes = 0;
+    }; // TransportTuner
+
+} // namespace Transfer
@@ -8,6 +8,7 @@
 #include "receivers_window.h"
 
 #include <QThread>
+#include <QElapsedTimer>
 #include <QApplication>
 #include <QVBoxLayout>
 #include <QScrollBar>
@@ -16,12 +17,16 @@
 #include <QPainterPath>
 #include <QScrollArea>
 #include <QPushButton>
+#include <QMouseEvent>
 #include "flowdrop/flowdrop.hpp"
 #include "application.h"
 #include "style.h"
+#include "transfer/discovery_schedule.h"
 #include "ui_util.h"
 #include "qtmaterialcircularprogress.h"
 
+#include <algorithm>
+
 class DesignedScrollBar : public QScrollBar {
     Q_OBJECT
 
@@ -65,10 +70,12 @@ public:
     }
 
     bool loadSvg(const QString& filePath) {
+        delete _svgRenderer;
         _svgRenderer = new QSvgRenderer(filePath, this);
         if (_svgRenderer->isValid()) {
             QSize svgSize = _svgRenderer->defaultSize();
             setFixedSize(svgSize);
+            update();
             return true;
         } else {
             delete _svgRenderer;
@@ -116,28 +123,17 @@ class Receiver : public QWidget {
 
 public:
     explicit Receiver(const flowdrop::DeviceInfo &deviceInfo, QWidget* parent = nullptr) : QWidget(parent), _deviceInfo(deviceInfo) {
-        setFixedHeight(60);
+        // the probe line is always reserved, a row that grows would move
+        // the ones below it
+        setFixedHeight(kHeight + kProbeHeight);
 
         auto *layout = new QHBoxLayout(this);
         layout->setContentsMargins(30, 0, 24, 0);
         layout->setSpacing(20);
 
-        QString icon = Resources::icons::device_pc;
-        if (_deviceInfo.platform.has_value()) {
-            QString platform = QString(_deviceInfo.platform.value().c_str());
-            if (equalsIgnoreCase(platform, "android")) {
-                icon = Resources::icons::device_android;
-            } else if (equalsIgnoreCase(platform, "ios")) {
-                icon = Resources::icons::device_ios;
-            } else if (equalsIgnoreCase(platform, "macos")) {
-                icon = Resources::icons::device_mac;
-            }
-        }
-
-        auto *imageWidget = new SVGIcon();
-        imageWidget->loadSvg(icon);
-        imageWidget->setColor(style::text1);
-        layout->addWidget(imageWidget);
+        _icon = new SVGIcon();
+        _icon->setColor(style::text1);
+        layout->addWidget(_icon);
 
         auto *textLayout = new QVBoxLayout();
         textLayout->setContentsMargins(0, 0, 0, 0);
@@ -145,27 +141,31 @@ public:
         textLayout->addStretch(1);
         layout->addLayout(textLayout);
 
-        std::string name = _deviceInfo.name.value_or(_deviceInfo.model.value_or(_deviceInfo.id));
+        _nameText = new MyText("", 15);
+        _nameText->setColor(style::text1);
+        textLayout->addWidget(_nameText);
 
-        auto *nameText = new MyText(QString(name.c_str()), 15);
-        nameText->setColor(style::text1);
-        textLayout->addWidget(nameText);
+        _systemText = new MyText("", 11);
+        _systemText->setColor(style::text2);
+        textLayout->addWidget(_systemText);
 
-        if (_deviceInfo.platform.has_value()) {
-            std::string system = _deviceInfo.platform.value();
-            if (_deviceInfo.system_version.has_value()) {
-                system += " " + _deviceInfo.system_version.value();
-            }
+        showDeviceInfo();
 
-            auto *systemText = new MyText(QString(system.c_str()), 11);
-            systemText->setColor(style::text2);
-            textLayout->addWidget(systemText);
-        }
+        _probeText = new MyText("", 11);
+        _probeText->setColor(style::text2);
+        textLayout->addWidget(_probeText);
+        auto lastProbe = App().lastProbe(deviceId());
+        setProbeText(lastProbe ? Transfer::formatProbeResult(*lastProbe) : QString());
 
         textLayout->addStretch(1);
 
         layout->addStretch(1);
 
+        _testText = new MyText("Test speed", 11);
+        _testText->setColor(style::text2);
+        _testText->setCursor(Qt::PointingHandCursor);
+        layout->addWidget(_testText);
+
         qInfo() << "Added receiver:" << _deviceInfo.id;
 
         setWidgetBackgroundColor(this, style::bg2Hovered);
@@ -178,12 +178,35 @@ public:
         return {374, 50};
     }*/
 
+    [[nodiscard]] const flowdrop::DeviceInfo &deviceInfo() const {
+        return _deviceInfo;
+    }
+
+    // Fills in what a later report of the same device knows, e.g. the
+    // discovery result for a row added from the known-peer ping.
+    void merge(const flowdrop::DeviceInfo &deviceInfo) {
+        auto take = [](std::optional<std::string> &field, const std::optional<std::string> &update) {
+            if (update.has_value()) {
+                field = update;
+            }
+        };
+        take(_deviceInfo.name, deviceInfo.name);
+        take(_deviceInfo.model, deviceInfo.model);
+        take(_deviceInfo.platform, deviceInfo.platform);
+        take(_deviceInfo.system_version, deviceInfo.system_version);
+        showDeviceInfo();
+    }
+
 signals:
     void clicked();
 
 protected:
     void mouseReleaseEvent(QMouseEvent *event) override {
         QWidget::mouseReleaseEvent(event);
+        if (_testText->geometry().contains(event->position().toPoint())) {
+            startProbe();
+            return;
+        }
         emit clicked();
     }
 
@@ -198,7 +221,73 @@ protected:
     }
 
 private:
-    const flowdrop::DeviceInfo &_deviceInfo;
+    static constexpr int kHeight = 60;
+    static constexpr int kProbeHeight = 16;
+
+    [[nodiscard]] QString deviceId() const {
+        return QString::fromStdString(_deviceInfo.id);
+    }
+
+    void showDeviceInfo() {
+        QString icon = Resources::icons::device_pc;
+        if (_deviceInfo.platform.has_value()) {
+            QString platform = QString(_deviceInfo.platform.value().c_str());
+            if (equalsIgnoreCase(platform, "android")) {
+                icon = Resources::icons::device_android;
+            } else if (equalsIgnoreCase(platform, "ios")) {
+                icon = Resources::icons::device_ios;
+            } else if (equalsIgnoreCase(platform, "macos")) {
+                icon = Resources::icons::device_mac;
+            }
+        }
+        _icon->loadSvg(icon);
+
+        std::string name = _deviceInfo.name.value_or(_deviceInfo.model.value_or(_deviceInfo.id));
+        _nameText->setText(QString(name.c_str()));
+
+        std::string system;
+        if (_deviceInfo.platform.has_value()) {
+            system = _deviceInfo.platform.value();
+            if (_deviceInfo.system_version.has_value()) {
+                system += " " + _deviceInfo.system_version.value();
+            }
+        }
+        _systemText->setText(QString(system.c_str()));
+        _systemText->setVisible(!system.empty());
+    }
+
+    // Shows the interface the device is reached over next to the probe.
+    void setProbeText(const QString &text) {
+        QStringList parts;
+        auto path = App().peerPath(deviceId());
+        if (path && !path->via.name.isEmpty()) {
+            parts.push_back("via " + path->via.name);
+        }
+        if (!text.isEmpty()) {
+            parts.push_back(text);
+        }
+        QString line = parts.join(" · ");
+        _probeText->setText(line);
+        _probeText->setVisible(!line.isEmpty());
+    }
+
+    void startProbe() {
+        if (_probing) return;
+        _probing = true;
+        setProbeText("Testing the link...");
+        App().probePeer(deviceId(), this, [this](const Transfer::ProbeResult &result) {
+            _probing = false;
+            setProbeText(Transfer::formatProbeResult(result));
+        });
+    }
+
+    flowdrop::DeviceInfo _deviceInfo;
+    SVGIcon *_icon;
+    MyText *_nameText;
+    MyText *_systemText;
+    MyText *_probeText;
+    MyText *_testText;
+    bool _probing = false;
 };
 
 class ScrollAreaContent : public QWidget {
@@ -277,6 +366,8 @@ ReceiversWindow::ReceiversWindow(const QStringList& fileNames) : _fileNames(file
 
     auto *scrollContent = new ScrollAreaContent();
     setWidgetBackgroundColor(scrollContent, style::bg2);
+    _content = scrollContent;
+    _content->installEventFilter(this);
     _contentLayout = scrollContent->_contentLayout;
 
     auto *scrollArea = new QScrollArea();
@@ -306,35 +397,107 @@ ReceiversWindow::ReceiversWindow(const QStringList& fileNames) : _fileNames(file
 
     // logic
 
+    App().setDiscovering(true);
     _discoverThread = new QThread;
     QObject::connect(_discoverThread, &QThread::started, [this](){
-        flowdrop::setDebug(true);
-        flowdrop::discover([this](const flowdrop::DeviceInfo &deviceInfo){
-            if (deviceInfo.id == App().deviceInfo().id) return;
-            QMetaObject::invokeMethod(this, "addReceiver", Qt::QueuedConnection, Q_ARG(flowdrop::DeviceInfo, deviceInfo));
-        }, [this](){
-            return _stopDiscover.load();
-        });
+        Transfer::DiscoverySchedule schedule;
+        while (!_stopDiscover) {
+            auto round = schedule.next();
+            QElapsedTimer timer;
+            timer.start();
+            while (!_stopDiscover && timer.elapsed() < round.pauseMs) {
+                QThread::msleep(kStopPollMs);
+            }
+            if (_stopDiscover) break;
+            timer.restart();
+            flowdrop::discover([this](const flowdrop::DeviceInfo &deviceInfo){
+                if (deviceInfo.id == App().deviceInfo().id) return;
+                QMetaObject::invokeMethod(this, "addReceiver", Qt::QueuedConnection, Q_ARG(flowdrop::DeviceInfo, deviceInfo));
+            }, [this, &timer, activeMs = round.activeMs](){
+                return _stopDiscover.load() || timer.elapsed() >= activeMs;
+            });
+        }
     });
     _discoverThread->start();
 
+    // where multicast is filtered these are all the list gets
+    App().checkKnownPeers(this, [this](const PeerHistory::Peer &peer) {
+        flowdrop::DeviceInfo deviceInfo;
+        deviceInfo.id = peer.id.toStdString();
+        if (!peer.name.isEmpty()) {
+            deviceInfo.name = peer.name.toStdString();
+        }
+        addReceiver(deviceInfo);
+    });
+
     qDebug() << fileNames;
 }
 
 void ReceiversWindow::addReceiver(const flowdrop::DeviceInfo &deviceInfo) {
+    QString deviceId = QString::fromStdString(deviceInfo.id);
+    // every discovery round reports the devices again, and the known-peer
+    // ping only knows the id and name
+    auto existing = _receivers.find(deviceId);
+    if (existing != _receivers.end()) {
+        existing->second->merge(deviceInfo);
+        return;
+    }
     auto *receiver = new Receiver(deviceInfo);
-    _contentLayout->addWidget(receiver);
-    QObject::connect(receiver, &Receiver::clicked, [this, deviceInfo](){
-        auto *thread = new QThread;
-        auto *fileNames = new QStringList(_fileNames);
-        QObject::connect(thread, &QThread::started, [deviceInfo, fileNames](){
-            App().sendTo(QString(deviceInfo.id.c_str()), *fileNames);
+    _receivers.emplace(deviceId, receiver);
+    insertRow({receiver, App().peerHistory().score(deviceId)});
+    QObject::connect(receiver, &Receiver::clicked, [this, receiver](){
+        const flowdrop::DeviceInfo &deviceInfo = receiver->deviceInfo();
+        std::string name = deviceInfo.name.value_or(deviceInfo.model.value_or(deviceInfo.id));
+        App().peerHistory().remember(QString::fromStdString(deviceInfo.id), QString::fromStdString(name));
+        // sizing a big folder takes a while, keep it off the UI thread
+        auto *thread = QThread::create([receiverId = QString(deviceInfo.id.c_str()), fileNames = _fileNames](){
+            App().queueSend(receiverId, fileNames);
         });
+        QObject::connect(thread, &QThread::finished, thread, &QObject::deleteLater);
         thread->start();
         close();
     });
 }
 
+void ReceiversWindow::insertRow(const Row &row) {
+    // known devices first, the rest keep discovery order
+    auto position = std::find_if(_rows.begin(), _rows.end(), [&](const Row &other) {
+        return other.score < row.score;
+    });
+    auto index = int(position - _rows.begin());
+
+    // don't move the row the user is about to click
+    if (_content->underMouse()) {
+        auto hovered = std::find_if(_rows.begin(), _rows.end(), [](const Row &other) {
+            return other.widget->underMouse();
+        });
+        if (hovered != _rows.end() && index <= int(hovered - _rows.begin())) {
+            row.widget->setParent(_content);
+            row.widget->hide();
+            _pending.push_back(row);
+            return;
+        }
+    }
+    _rows.insert(position, row);
+    _contentLayout->insertWidget(index, row.widget);
+    row.widget->show();
+}
+
+void ReceiversWindow::insertPending() {
+    std::vector<Row> pending;
+    pending.swap(_pending);
+    for (const auto &row : pending) {
+        insertRow(row);
+    }
+}
+
+bool ReceiversWindow::eventFilter(QObject *watched, QEvent *event) {
+    if (watched == _content && event->type() == QEvent::Leave) {
+        insertPending();
+    }
+    return QMainWindow::eventFilter(watched, event);
+}
+
 void ReceiversWindow::changeEvent(QEvent *event) {
     if (event->type() == QEvent::WindowStateChange) {
         if (isHidden()) {
@@ -343,6 +506,7 @@ void ReceiversWindow::changeEvent(QEvent *event) {
             _discoverThread->wait();
             delete _discoverThread;
             _discoverThread = nullptr;
+            App().setDiscovering(false);
         }
     }
     QMainWindow::changeEvent(event);
@@ -10,8 +10,12 @@
 #include <QEvent>
 #include <QVBoxLayout>
 #include <QScrollArea>
+#include <map>
+#include <vector>
 #include "flowdrop/flowdrop.hpp"
 
+class Receiver;
+
 class ReceiversWindow : public QMainWindow {
     Q_OBJECT
 
@@ -24,11 +28,31 @@ public slots:
 protected:
     void changeEvent(QEvent *event) override;
 
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
 private:
+    struct Row {
+        QWidget *widget;
+        double score;
+    };
+
+    void insertRow(const Row &row);
+
+    void insertPending();
+
+    static constexpr int kStopPollMs = 100;
+
     std::atomic<bool> _stopDiscover = false;
     QThread *_discoverThread;
 
     QStringList _fileNames;
 
+    QWidget *_content;
     QVBoxLayout *_contentLayout;
+    // by device id
+    std::map<QString, Receiver *> _receivers;
+    // in layout order, best first
+    std::vector<Row> _rows;
+    // held back while they would push the row under the cursor
+    std::vector<Row> _pending;
 };
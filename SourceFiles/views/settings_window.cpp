@@ -18,9 +18,12 @@
 #include <QDesktopServices>
 #include <QPainterPath>
 #include <QFileDialog>
+#include <QInputDialog>
+#include <QMessageBox>
 #include <QPropertyAnimation>
 #include "style.h"
 #include "application.h"
+#include "transfer/interfaces.h"
 #include "ui_util.h"
 
 SettingsWindow *SettingsWindow::_instance = nullptr;
@@ -518,6 +521,155 @@ SettingsWindow::SettingsWindow() : QMainWindow() {
         App().setAutoAcceptMode(value);
     });
 
+    auto *element5 = new SettingElement(widget1);
+    settingsLayout->addWidget(element5);
+
+    auto *label5_1 = new MyText("Send only changes", 15);
+    label5_1->setAlignment(Qt::AlignLeft | Qt::AlignVCenter);
+    label5_1->setColor(style::text1);
+    element5->addLeftWidget(label5_1);
+
+    auto *label5_2 = new MyText("of files sent to the same device before", 11);
+    label5_2->setAlignment(Qt::AlignLeft | Qt::AlignVCenter);
+    label5_2->setColor(style::text2);
+    element5->addLeftWidget(label5_2);
+
+    auto *toggle5 = new DesignedToggle(element5);
+    toggle5->setToggled(App().isDeltaTransfer());
+    element5->addRightWidget(toggle5);
+
+    QObject::connect(toggle5, &DesignedToggle::toggled, [](bool value) {
+        App().setDeltaTransfer(value);
+    });
+
+    auto *element9 = new SettingElement(widget1);
+    settingsLayout->addWidget(element9);
+
+    auto *label9_1 = new MyText("Compact transfers", 15);
+    label9_1->setAlignment(Qt::AlignLeft | Qt::AlignVCenter);
+    label9_1->setColor(style::text1);
+    element9->addLeftWidget(label9_1);
+
+    auto *label9_2 = new MyText("sparse files and parallel streams, to devices running " + QApplication::applicationName(), 11);
+    label9_2->setAlignment(Qt::AlignLeft | Qt::AlignVCenter);
+    label9_2->setColor(style::text2);
+    element9->addLeftWidget(label9_2);
+
+    auto *toggle9 = new DesignedToggle(element9);
+    toggle9->setToggled(App().isExtendedFormats());
+    element9->addRightWidget(toggle9);
+
+    QObject::connect(toggle9, &DesignedToggle::toggled, [](bool value) {
+        App().setExtendedFormats(value);
+    });
+
+    auto *element6 = new SettingElement(widget1);
+    settingsLayout->addWidget(element6);
+
+    auto *label6_1 = new MyText("Speed limit", 15);
+    label6_1->setAlignment(Qt::AlignLeft | Qt::AlignVCenter);
+    label6_1->setColor(style::text1);
+    element6->addLeftWidget(label6_1);
+
+    auto *label6_2 = new MyText("applies to transfers already running", 11);
+    label6_2->setAlignment(Qt::AlignLeft | Qt::AlignVCenter);
+    label6_2->setColor(style::text2);
+    element6->addLeftWidget(label6_2);
+
+    const auto addRateLimitButton = [element6](const QString &title, Setting setting) {
+        auto *button = new DesignedRoundedButton(element6);
+        const auto updateText = [button, title, setting]() {
+            qint64 limit = App().rateLimit(setting);
+            button->setText(title + ": " + (limit > 0 ? QString::number(limit) + " KiB/s" : "Unlimited"));
+        };
+        updateText();
+        element6->addRightWidget(button);
+
+        QObject::connect(button, &DesignedRoundedButton::clicked, [title, setting, updateText]() {
+            bool ok;
+            int limit = QInputDialog::getInt(nullptr, title + " limit", "KiB/s, 0 for unlimited",
+                                             int(App().rateLimit(setting)), 0, 10 * 1024 * 1024, 128, &ok);
+            if (!ok) return;
+            App().setRateLimit(setting, limit);
+            updateText();
+        });
+    };
+    addRateLimitButton("Total", Setting::RateLimit);
+    addRateLimitButton("Upload", Setting::RateLimitUpload);
+    addRateLimitButton("Download", Setting::RateLimitDownload);
+    addRateLimitButton("Per device", Setting::RateLimitPeer);
+
+    auto *element7 = new SettingElement(widget1);
+    settingsLayout->addWidget(element7);
+
+    auto *label7_1 = new MyText("Network interface", 15);
+    label7_1->setAlignment(Qt::AlignLeft | Qt::AlignVCenter);
+    label7_1->setColor(style::text1);
+    element7->addLeftWidget(label7_1);
+
+    auto *label7_2 = new MyText("", 11);
+    label7_2->setAlignment(Qt::AlignLeft | Qt::AlignVCenter);
+    label7_2->setColor(style::text2);
+    element7->addLeftWidget(label7_2);
+
+    const auto updateInterfaceText = [label7_2]() {
+        QString name = App().preferredInterface();
+        if (name.isEmpty()) {
+            auto interfaces = Transfer::localInterfaces();
+            label7_2->setText(interfaces.empty()
+                    ? "Automatic"
+                    : "Automatic, now " + Transfer::formatInterface(interfaces.front()));
+            return;
+        }
+        auto iface = Transfer::findInterface(name);
+        label7_2->setText(iface ? Transfer::formatInterface(*iface) : name + ", not connected");
+    };
+    updateInterfaceText();
+
+    auto *btn7 = new DesignedRoundedButton(element7);
+    btn7->setText("Change");
+    element7->addRightWidget(btn7);
+
+    QObject::connect(btn7, &DesignedRoundedButton::clicked, [updateInterfaceText]() {
+        QStringList items = {"Automatic"};
+        QStringList names = {QString()};
+        for (const auto &iface : Transfer::localInterfaces()) {
+            items.push_back(Transfer::formatInterface(iface));
+            names.push_back(iface.name);
+        }
+        bool ok;
+        QString item = QInputDialog::getItem(nullptr, "Network interface", "Prefer transfers over",
+                                             items, int(std::max<qsizetype>(names.indexOf(App().preferredInterface()), 0)), false, &ok);
+        if (!ok) return;
+        App().setPreferredInterface(names.value(items.indexOf(item)));
+        updateInterfaceText();
+    });
+
+    auto *element8 = new SettingElement(widget1);
+    settingsLayout->addWidget(element8);
+
+    auto *label8_1 = new MyText("Device identity", 15);
+    label8_1->setAlignment(Qt::AlignLeft | Qt::AlignVCenter);
+    label8_1->setColor(style::text1);
+    element8->addLeftWidget(label8_1);
+
+    auto *label8_2 = new MyText(QString::fromStdString(App().deviceInfo().id), 11);
+    label8_2->setAlignment(Qt::AlignLeft | Qt::AlignVCenter);
+    label8_2->setColor(style::text2);
+    element8->addLeftWidget(label8_2);
+
+    auto *btn8 = new DesignedRoundedButton(element8);
+    btn8->setText("Regenerate");
+    element8->addRightWidget(btn8);
+
+    QObject::connect(btn8, &DesignedRoundedButton::clicked, [label8_2]() {
+        auto answer = QMessageBox::question(nullptr, "Regenerate identity",
+                                            "Other devices will see this one as a new device and forget what they know about it. Continue?");
+        if (answer != QMessageBox::Yes) return;
+        App().regenerateDeviceId();
+        label8_2->setText("New identity is used after a restart");
+    });
+
     /*auto *element4 = new SettingElement(widget1);
     settingsLayout->addWidget(element4);
 